@@ -358,6 +358,32 @@ SRST
     Show host USB devices.
 ERST
 
+    {
+        .name       = "p404-timers",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show Mini404 device timers and how often they fire",
+    },
+
+SRST
+  ``info p404-timers``
+    Show the Mini404 device timers, whether they are currently armed
+    and how often they have fired.
+ERST
+
+    {
+        .name       = "p404-la",
+        .args_type  = "",
+        .params     = "",
+        .help       = "show the Mini404 logic analyzer lines and capture status",
+    },
+
+SRST
+  ``info p404-la``
+    Show the lines tapped by the Mini404 logic analyzer and, while
+    capturing, how many edges were written or dropped.
+ERST
+
 #if defined(CONFIG_TCG)
     {
         .name       = "profile",
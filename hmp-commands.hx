@@ -661,6 +661,43 @@ SRST
   Compute the checksum of a memory region.
 ERST
 
+    {
+        .name       = "p404-la-tap",
+        .args_type  = "path:s,n:i,name:s?",
+        .params     = "path n [gpio-name]",
+        .help       = "tap a Mini404 device GPIO output for the logic analyzer",
+    },
+
+SRST
+``p404-la-tap`` *path* *n* [*gpio-name*]
+  Add output *n* of the named (or unnamed) GPIO of the device at QOM *path*
+  to the lines captured by the Mini404 logic analyzer.
+ERST
+
+    {
+        .name       = "p404-la-start",
+        .args_type  = "file:s",
+        .params     = "file",
+        .help       = "start capturing the tapped lines to a VCD file",
+    },
+
+SRST
+``p404-la-start`` *file*
+  Start capturing edges on the tapped lines to the VCD *file*.
+ERST
+
+    {
+        .name       = "p404-la-stop",
+        .args_type  = "",
+        .params     = "",
+        .help       = "stop the logic analyzer capture",
+    },
+
+SRST
+``p404-la-stop``
+  Stop capturing and flush the VCD file.
+ERST
+
     {
         .name       = "device_add",
         .args_type  = "device:O",
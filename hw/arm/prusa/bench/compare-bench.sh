@@ -0,0 +1,36 @@
+#!/bin/sh
+# Before/after comparison of one -append option, e.g. "hle" on boot-to-home:
+#
+# Usage: compare-bench.sh <qemu-system-buddy> <firmware> <option> [workload...]
+#
+# Runs the workloads (boot-to-home by default) with run-bench.sh once without
+# and once with the option, appending both sets of reports to
+# ${P404_BENCH_OUT:-bench.jsonl}, then prints the ratio of each and the speedup.
+HERE=$(dirname "$(realpath "$0")")
+QEMU=$1
+FW=$2
+OPT=$3
+shift 3
+WORKLOADS=${*:-boot-to-home}
+OUT=$(realpath "${P404_BENCH_OUT:-bench.jsonl}")
+BEFORE=$(mktemp)
+AFTER=$(mktemp)
+
+P404_BENCH_OUT=${BEFORE} P404_BENCH_APPEND= "${HERE}/run-bench.sh" "${QEMU}" "${FW}" ${WORKLOADS} || exit 1
+P404_BENCH_OUT=${AFTER} P404_BENCH_APPEND=${OPT} "${HERE}/run-bench.sh" "${QEMU}" "${FW}" ${WORKLOADS} || exit 1
+cat "${BEFORE}" "${AFTER}" >> "${OUT}"
+
+# The run-wide ratio of the default profile; the phases have their own.
+ratio() {
+    grep "\"workload\":\"$1\",\"profile\":\"default\"" "$2" \
+        | sed 's/,"phases".*//; s/.*"ratio":\([0-9.]*\).*/\1/'
+}
+
+printf "%-16s %10s %10s %8s\n" workload before "${OPT}" speedup
+for W in ${WORKLOADS}; do
+    B=$(ratio "${W}" "${BEFORE}")
+    A=$(ratio "${W}" "${AFTER}")
+    awk -v w="${W}" -v b="${B}" -v a="${A}" \
+        'BEGIN { printf "%-16s %10.4f %10.4f %7.2fx\n", w, b, a, b > 0 ? a / b : 0 }'
+done
+rm -f "${BEFORE}" "${AFTER}"
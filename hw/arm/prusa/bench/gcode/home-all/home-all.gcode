@@ -0,0 +1,4 @@
+; Mini404 benchmark: home all axes.
+G90
+G28
+M84
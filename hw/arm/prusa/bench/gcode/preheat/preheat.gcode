@@ -0,0 +1,7 @@
+; Mini404 benchmark: heat up and wait, then cool down.
+M104 S215
+M140 S60
+M109 S215
+M190 S60
+M104 S0
+M140 S0
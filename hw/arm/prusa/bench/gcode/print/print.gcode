@@ -0,0 +1,36 @@
+; Mini404 benchmark: a 20 mm square, three 0.2 mm layers.
+M104 S170
+M140 S50
+G90
+M83
+G28
+M190 S50
+M109 S170
+G1 Z5 F1000
+G92 E0
+;LAYER:0
+G1 X80 Y80 F6000
+G1 Z0.2 F1000
+G1 X100 Y80 E0.7484 F1200
+G1 X100 Y100 E0.7484 F1200
+G1 X80 Y100 E0.7484 F1200
+G1 X80 Y80 E0.7484 F1200
+;LAYER:1
+G1 X80 Y80 F6000
+G1 Z0.4 F1000
+G1 X100 Y80 E0.7484 F1200
+G1 X100 Y100 E0.7484 F1200
+G1 X80 Y100 E0.7484 F1200
+G1 X80 Y80 E0.7484 F1200
+;LAYER:2
+G1 X80 Y80 F6000
+G1 Z0.6 F1000
+G1 X100 Y80 E0.7484 F1200
+G1 X100 Y100 E0.7484 F1200
+G1 X80 Y100 E0.7484 F1200
+G1 X80 Y80 E0.7484 F1200
+G1 Z10 F1000
+M104 S0
+M140 S0
+M107
+M84
@@ -0,0 +1,57 @@
+#!/bin/sh
+# Headless end-to-end speed benchmark for the Mini.
+#
+# Usage: run-bench.sh <qemu-system-buddy> <firmware> [workload...]
+# Workloads are the scripts in scripts/ (boot-to-home home-all preheat print),
+# all of them by default. Each one is a fresh boot in a scratch directory, so
+# copy in a Prusa_Mini_eeprom*.bin/xflash that is past the first-run wizard
+# with P404_BENCH_STATE=<dir> to keep the runs comparable.
+#
+# The dashboards are left out ("bench" implies "headless") and -display none
+# drops the SDL window. Otherwise the machine runs in its default
+# configuration, so "insns" and "mips" are null. P404_BENCH_MIPS=1 adds a
+# second run of each workload with cycle-model for those ("profile":"mips");
+# its ratio is not comparable, since cycle-model instruments every TB (and
+# -icount would tie virtual time to the instruction count).
+#
+# Extra -append options (e.g. "hle") go in P404_BENCH_APPEND and are recorded
+# in the report; compare-bench.sh uses that for before/after runs.
+#
+# One JSON report per workload is appended to ${P404_BENCH_OUT:-bench.jsonl};
+# "ratio" (virtual seconds per host second) of the "profile":"default" run is
+# the number to track.
+QEMU=$(realpath "$1")
+FW=$(realpath "$2")
+shift 2
+HERE=$(dirname "$(realpath "$0")")
+OUT=$(realpath "${P404_BENCH_OUT:-bench.jsonl}")
+WORKLOADS=${*:-boot-to-home home-all preheat print}
+
+# run <workload> <profile> <extra -append options>
+run() {
+    SCRATCH=$(mktemp -d)
+    if [ -n "${P404_BENCH_STATE}" ]; then
+        cp "${P404_BENCH_STATE}"/Prusa_Mini_*.bin "${SCRATCH}"
+    fi
+    USB=""
+    if [ -d "${HERE}/gcode/$1" ]; then
+        mkdir "${SCRATCH}/usb" && cp "${HERE}/gcode/$1"/* "${SCRATCH}/usb"
+        USB="-drive id=usbstick,if=none,file=fat:rw:usb -device usb-storage,drive=usbstick"
+    fi
+    echo "Running $1 ($2)"
+    (cd "${SCRATCH}" && "${QEMU}" -machine prusa-mini -kernel "${FW}" -display none ${USB} \
+        -append "bench=${SCRATCH}/report.json,script=${HERE}/scripts/$1.txt$3${P404_BENCH_APPEND:+,${P404_BENCH_APPEND}}") || exit 1
+    sed "s/^{/{\"workload\":\"$1\",\"profile\":\"$2\",\"options\":\"${P404_BENCH_APPEND}\",/" "${SCRATCH}/report.json" | tee -a "${OUT}"
+    rm -rf "${SCRATCH}"
+}
+
+for W in ${WORKLOADS}; do
+    if [ ! -f "${HERE}/scripts/${W}.txt" ]; then
+        echo "Unrecognized workload ${W}."
+        exit 1
+    fi
+    run "${W}" default "" || exit 1
+    if [ -n "${P404_BENCH_MIPS}" ]; then
+        run "${W}" mips ",cycle-model" || exit 1
+    fi
+done
@@ -56,6 +56,8 @@ struct Dashboard2DState {
 
 	bool redraw;
 
+    bool headless; // No console, inputs are only stored.
+
     uint32_t framebuffer[DPY_MAX_ROWS * DPY_MAX_COLS];
 
     char* ind_labels;
@@ -296,6 +298,9 @@ static void dashboard_2d_fan_rpm_in(void *opaque, int n, int level)
 {
 	Dashboard2DState *s = DB2D_DISPLAY(opaque);
 	s->fan_rpms[n] = level;
+    if (s->con == NULL) {
+        return;
+    }
     snprintf(s->fan_printf[n], sizeof(s->fan_printf[n]), "%5d", level);
 }
 
@@ -308,6 +313,9 @@ static void dashboard_2d_therm_pwm_in(void *opaque, int n, int level)
 static void dashboard_2d_therm_temp_in(void *opaque, int n, int level)
 {
 	Dashboard2DState *s = DB2D_DISPLAY(opaque);
+    if (s->con == NULL) {
+        return;
+    }
 	float temp = ((float)level)/256.F;
 	snprintf(s->therm_printf[n],sizeof(s->therm_printf[n]), "%5.1f", temp);
 }
@@ -350,6 +358,9 @@ static void dashboard_2d_realize(DeviceState *dev, Error **errp)
     s->current_rows = LINE_HEIGHT * i;
 
     s->current_rows += (4 * LINE_HEIGHT);
+    if (s->headless) {
+        return;
+    }
     s->con = graphic_console_init(dev, 0, &dashboard_2d_ops, s);
     qemu_console_resize(s->con, DPY_MAX_COLS, s->current_rows);
 }
@@ -380,6 +391,7 @@ static Property dashboard_2d_properties[] = {
     DEFINE_PROP_UINT8("thermistors", Dashboard2DState, therm_count, 0),
     DEFINE_PROP_STRING("indicators", Dashboard2DState, ind_labels),
     DEFINE_PROP_STRING("title", Dashboard2DState, title),
+    DEFINE_PROP_BOOL("headless", Dashboard2DState, headless, false),
     DEFINE_PROP_END_OF_LIST()
 };
 
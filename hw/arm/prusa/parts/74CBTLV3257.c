@@ -27,6 +27,7 @@
 #include "hw/sysbus.h"
 #include "migration/vmstate.h"
 #include "hw/qdev-properties.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_CBTLV3257 "cbtl3257"
 
@@ -110,6 +111,7 @@ static void cbtl3257_init(Object *obj)
     qdev_init_gpio_out(DEVICE(obj), s->irq, 4); // outputs.
 
     qdev_init_gpio_in_named(DEVICE(obj),cbtl3257_nOE,"nOE",1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in_named(DEVICE(obj),cbtl3257_select,"select",1);
     qdev_init_gpio_in_named(DEVICE(obj),cbtl3257_ch1_in,"B1",4);// 1Y
     qdev_init_gpio_in_named(DEVICE(obj),cbtl3257_ch2_in,"B2",4);// 2Y
@@ -27,6 +27,7 @@
 #include "hw/sysbus.h"
 #include "migration/vmstate.h"
 #include "hw/qdev-properties.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_HC4052 "hc4052"
 
@@ -97,6 +98,7 @@ static void hc4052_init(Object *obj)
     qdev_init_gpio_out(DEVICE(obj), s->irq, 2); // 1Z, 2Z
     qdev_init_gpio_out_named(DEVICE(obj), s->mux_read[0],"1Y_read", 4);
     qdev_init_gpio_out_named(DEVICE(obj), s->mux_read[1],"2Y_read", 4);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in_named(DEVICE(obj),hc4052_select,"select",2);// S1, S2
     qdev_init_gpio_in_named(DEVICE(obj),hc4052_ch1_in,"1Y",4);// 1Y
     qdev_init_gpio_in_named(DEVICE(obj),hc4052_ch2_in,"2Y",4);// 2Y
@@ -25,6 +25,7 @@
 #include "../utility/p404scriptable.h"
 #include "../utility/ScriptHost_C.h"
 #include "migration/vmstate.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_ACS711 "acs711"
 OBJECT_DECLARE_SIMPLE_TYPE(ACS711State, ACS711)
@@ -111,6 +112,7 @@ static void acs711_init(Object *obj)
     ACS711State *s = ACS711(obj);
 
     qdev_init_gpio_out_named(DEVICE(obj), &s->irq, "adc_out", 1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in_named(DEVICE(obj),acs711_read_request,"adc_read_request",1);
     qdev_init_gpio_in_named(DEVICE(obj),acs711_bed_in,"bed_on",NUM_ITEMS);
 
@@ -25,13 +25,16 @@
 #include "qemu/module.h"
 #include "qom/object.h"
 #include "../utility/macros.h"
+#include "../utility/p404_edge_timing.h"
 #include "hw/irq.h"
 #include "hw/sysbus.h"
 #include "hw/qdev-properties.h"
 #include "hw/qdev-properties-system.h"
 #include "sysemu/block-backend.h"
-#include "sysemu/cpu-timers.h"
 #include "migration/vmstate.h"
+#include "../trace.h"
+#include "../utility/p404_stats.h"
+#include "../utility/p404_timer_stats.h"
 
 #define TYPE_AT21CSXX "at21csxx"
 
@@ -44,11 +47,17 @@
 #define AT21_OP_SSM  0xD
 #define AT21_OP_HSM  0xE
 
-#define ICOUNT_PER_US 168
-
 #define DEV_ADDR 0
 #define DEV_SIZE 128
 
+// Protocol timing as ratios, so it holds however fast the guest runs. A reset low
+// (>=48us) is far longer than the discovery request, which is as long as a logic 1
+// (1-2us). A 0 is a 6-16us low, and a start condition a high far longer than any
+// bit frame (<=25us).
+#define AT21_DISC_RATIO 8 // Discovery request vs. the reset before it
+#define AT21_RESET_RATIO 20 // Reset vs. a logic 1
+#define AT21_START_RATIO 40 // Start condition high vs. a logic 1
+
 OBJECT_DECLARE_SIMPLE_TYPE(AT21CSxxState, AT21CSXX)
 
 enum SIOState {
@@ -81,6 +90,8 @@ struct AT21CSxxState {
 	QEMUTimer *line_release;
 
 	int64_t low_start, high_start;
+	int64_t reset_low; // Last reset pulse, in edge units.
+	int64_t low1_ref; // Last discovery request, i.e. the width of a logic 1, in edge units.
 	uint8_t bit_counter;
 	uint8_t byte_in, byte_out;
 	uint8_t sio_state;
@@ -91,15 +102,31 @@ struct AT21CSxxState {
 	BlockBackend *blk;
 };
 
+static int at21csxx_post_load(void *opaque, int version_id)
+{
+    AT21CSxxState *s = AT21CSXX(opaque);
+	if (version_id < 2)
+	{
+		// Older snapshots predate the measured references. Use the high-speed
+		// nominals until the guest resets the bus again.
+		s->reset_low = 150 * p404_edge_per_us();
+		s->low1_ref = (3 * p404_edge_per_us()) / 2;
+	}
+	return 0;
+}
+
 static const VMStateDescription vmstate_at21csxx = {
     .name = TYPE_AT21CSXX,
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
+    .post_load = at21csxx_post_load,
     .fields = (VMStateField[]) {
 		VMSTATE_UINT8(cmd.raw, AT21CSxxState),
 		VMSTATE_TIMER_PTR(line_release, AT21CSxxState),
 		VMSTATE_INT64(low_start, AT21CSxxState),
 		VMSTATE_INT64(high_start, AT21CSxxState),
+		VMSTATE_INT64_V(reset_low, AT21CSxxState, 2),
+		VMSTATE_INT64_V(low1_ref, AT21CSxxState, 2),
 		VMSTATE_UINT8(bit_counter, AT21CSxxState),
 		VMSTATE_UINT8(byte_in, AT21CSxxState),
 		VMSTATE_UINT8(byte_out, AT21CSxxState),
@@ -118,7 +145,20 @@ static void at21csxx_line_release(void *opaque)
 	// printf("Line released\n");
 }
 
-#define NS_SCALE(x) (x * ns_per_inst)
+// Holds the line low for a multiple of the guest's logic 1 width.
+static void at21csxx_hold_low(AT21CSxxState *s, bool low, int64_t ones)
+{
+	qemu_set_irq(s->irq, !low);
+	timer_mod(s->line_release, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + p404_edge_to_ns(ones * s->low1_ref));
+}
+
+static void at21csxx_bus_reset(AT21CSxxState *s, int64_t tLow)
+{
+	s->bit_counter = 0;
+	s->byte_in = 0;
+	s->reset_low = tLow;
+	s->sio_state = SIO_DISC;
+}
 
 static bool at21csxx_process_byte(AT21CSxxState *s, uint8_t byte)
 {
@@ -162,9 +202,9 @@ static void at21csxx_sio(void* opaque, int n, int level) {
     AT21CSxxState *s = AT21CSXX(opaque);
 	if (!level)
 	{
-		s->low_start = icount_get_raw();
+		s->low_start = p404_edge_now();
 		int64_t tHigh = s->low_start - s->high_start;
-		if (tHigh > 500 * ICOUNT_PER_US)
+		if (s->sio_state >= SIO_IDLE && tHigh > (AT21_START_RATIO * s->low1_ref))
 		{
 			// printf("AT21 Start cond\n");
 			s->sio_state = SIO_IDLE;
@@ -172,31 +212,36 @@ static void at21csxx_sio(void* opaque, int n, int level) {
 		return;
 	}
 
-	s->high_start = icount_get_raw();
+	s->high_start = p404_edge_now();
 
 	int64_t tLow = s->high_start - s->low_start;
 
-	if (tLow > 150 * ICOUNT_PER_US)
+	if (s->sio_state <= SIO_DISC)
 	{
-		s->bit_counter = 0;
-		s->byte_in = 0;
-		s->sio_state = SIO_DISC;
+		// Until discovery, a pulse much shorter than the reset before it is the
+		// discovery request. Anything else is taken as (another) reset.
+		if (s->sio_state == SIO_DISC && (AT21_DISC_RATIO * tLow) < s->reset_low)
+		{
+			s->low1_ref = tLow;
+			at21csxx_hold_low(s, true, 4); // 2-6 us from the datasheet
+			// printf("Discovery ack\n");
+			s->sio_state = SIO_IDLE;
+		}
+		else
+		{
+			at21csxx_bus_reset(s, tLow);
+		}
+		return;
+	}
+	if (tLow > (AT21_RESET_RATIO * s->low1_ref))
+	{
+		at21csxx_bus_reset(s, tLow);
 		return;
 	}
-	bool logic_one = ICOUNT_PER_US < tLow && tLow < (2 * ICOUNT_PER_US); 			// Logic 1 in high speed mode
-	bool logic_zero = (6 * ICOUNT_PER_US) < tLow && tLow < (16 * ICOUNT_PER_US);	// Logic 0 in high speed.
-	int64_t ns_per_inst = icount_to_ns(1);
+	// A 0 is at least 3x as long as a 1.
+	bool logic_one = (2 * tLow) < (5 * s->low1_ref);
 	switch (s->sio_state)
 	{
-		case SIO_DISC:
-			if (logic_one)
-			{
-				qemu_irq_lower(s->irq);
-				timer_mod(s->line_release, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + NS_SCALE(6000)); // 2-6 us from the datasheet
-				// printf("Discovery ack\n");
-				s->sio_state = SIO_IDLE;
-			}
-			break;
 		case SIO_IDLE:
 			s->byte_count = 0; // Reset byte count for next data in.
 			s->bit_counter = 0;
@@ -206,27 +251,19 @@ static void at21csxx_sio(void* opaque, int n, int level) {
 			s->sio_state = SIO_DIN;
 			/* FALLTHRU */
 		case SIO_DIN:
-			if (logic_one || logic_zero )
+			if (s->bit_counter < 8)
 			{
-				if (s->bit_counter < 8)
-				{
-					s->byte_in <<= 1;
-					s->byte_in |= logic_one;
-					s->bit_counter++;
-					return;
-				}
-			}
-			else
-			{
-				printf("w1 Bus unhandled low duration: %"PRId64" instructions\n", tLow);
+				s->byte_in <<= 1;
+				s->byte_in |= logic_one;
+				s->bit_counter++;
+				return;
 			}
 			if (s->bit_counter == 8)
 			{
 				bool send_ack = at21csxx_process_byte(s, s->byte_in);
 				// printf("Byte in: %02x - %s\n", s->byte_in, send_ack? "ACK" : "NACK");
 				s->byte_in = 0;
-				qemu_set_irq(s->irq, !send_ack);
-				timer_mod(s->line_release, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + NS_SCALE(2000)); // 2-6 us from the datasheet
+				at21csxx_hold_low(s, send_ack, 2); // 2-6 us from the datasheet
 				s->bit_counter = 0;
 			}
 			break;
@@ -238,7 +275,7 @@ static void at21csxx_sio(void* opaque, int n, int level) {
 					{
 						case AT21_OP_EEA:
 							s->byte_out = s->data[s->address_pointer++];
-							printf("AT21CSxx: Sending byte@ %02x: %02x\n",s->address_pointer-1, s->byte_out);
+							trace_at21csxx_read(s->address_pointer-1, s->byte_out);
 							break;
 						default:
 							printf("AT21 Unhandled read opcode %x\n", s->cmd.def.opcode);
@@ -246,10 +283,9 @@ static void at21csxx_sio(void* opaque, int n, int level) {
 					}
 					/* fallthru */
 				case 1 ... 7 :
-					qemu_set_irq(s->irq, (s->byte_out & 0x80) > 0 );
+					at21csxx_hold_low(s, (s->byte_out & 0x80) == 0, 1);
 					s->bit_counter++;
 					s->byte_out <<= 1;
-					timer_mod(s->line_release, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + NS_SCALE(1000)); // 2-6 us from the datasheet
 					break;
 				case 8:
 					if (logic_one) // NACK. Read is done.
@@ -279,11 +315,6 @@ static void at21csxx_reset(DeviceState *dev)
 static void at21csxx_realize(DeviceState *dev, Error **errp)
 {
     AT21CSxxState *s = AT21CSXX(dev);
-	if (icount_enabled() == 0)
-	{
-		printf("WARNING: icount is disabled. AT21CSxx EEPROM will NOT WORK!\n");
-		printf("WARNING: use -icount [number] to enable it.\n");
-	}
     if (s->blk) {
 
         int64_t len = blk_getlength(s->blk);
@@ -325,8 +356,9 @@ static void at21csxx_init(Object *obj)
 {
     AT21CSxxState *s = AT21CSXX(obj);
     qdev_init_gpio_out(DEVICE(obj), &s->irq, 1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in(DEVICE(s),at21csxx_sio, 1);
-	s->line_release = timer_new_ns(QEMU_CLOCK_VIRTUAL, &at21csxx_line_release, s);
+	s->line_release = p404_timer_new_ns(obj, QEMU_CLOCK_VIRTUAL, "line_release", &at21csxx_line_release, s);
 	for (int i=0; i< DEV_SIZE; i++)
 	{
 		s->data[i] = 0xFF;
@@ -344,5 +376,6 @@ static void at21csxx_class_init(ObjectClass *oc, void *data)
     dc->reset = at21csxx_reset;
     dc->vmsd = &vmstate_at21csxx;
 	dc->realize = at21csxx_realize;
+	dc->user_creatable = true; // For qtest on the bare STM32 machines.
 	device_class_set_props(dc, at21csxx_eeprom_props);
 }
@@ -25,6 +25,7 @@
 #include "../utility/p404scriptable.h"
 #include "../utility/ScriptHost_C.h"
 #include "migration/vmstate.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_CS30BL "cs30bl"
 OBJECT_DECLARE_SIMPLE_TYPE(CS30BLState, CS30BL)
@@ -93,6 +94,7 @@ static void cs30bl_init(Object *obj)
     CS30BLState *s = CS30BL(obj);
 
     qdev_init_gpio_out_named(DEVICE(obj), &s->irq, "a_sense", 1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in_named(DEVICE(obj),cs30bl_read_request,"adc_read_request",1);
 
     script_handle pScript = script_instance_new(P404_SCRIPTABLE(obj), TYPE_CS30BL);
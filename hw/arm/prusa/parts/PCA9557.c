@@ -31,6 +31,7 @@
 #include "hw/qdev-properties.h"
 #include "hw/qdev-properties-system.h"
 #include "qom/object.h"
+#include "../utility/p404_stats.h"
 
 
 #define TYPE_PCA9557 "pca9557"
@@ -144,6 +145,7 @@ static void pca9557_realize(DeviceState *dev, Error **errp)
 {
 	PCA9557State *s = PCA9557(dev);
 	qdev_init_gpio_out(DEVICE(dev), s->outputs, 8);
+	p404_stats_count_gpio_out(OBJECT(dev));
 	qdev_init_gpio_in(DEVICE(dev), pca9557_input, 8);
 }
 
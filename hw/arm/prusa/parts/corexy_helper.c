@@ -27,6 +27,7 @@
 #include "qom/object.h"
 #include "../utility/p404_motor_if.h"
 #include "hw/sysbus.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_COREXY "corexy-helper"
 
@@ -122,6 +123,7 @@ static void corexy_init(Object *obj)
 	s->vis_y.status.enabled = true;
 	s->vis_y.status.changed = true;
     qdev_init_gpio_out(DEVICE(obj), s->endstop, 2);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in(DEVICE(obj),corexy_move,2);
 }
 
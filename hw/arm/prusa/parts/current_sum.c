@@ -23,6 +23,7 @@
 #include "hw/qdev-properties.h"
 #include "../utility/macros.h"
 #include "migration/vmstate.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_CURRENT_SUM "current-sum"
 OBJECT_DECLARE_SIMPLE_TYPE(CurrentSumState, CURRENT_SUM)
@@ -94,6 +95,7 @@ static void current_sum_init(Object *obj)
 {
 	CurrentSumState *s = CURRENT_SUM(obj);
     qdev_init_gpio_out_named(DEVICE(obj), &s->irq, "adc_out", 1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in_named(DEVICE(obj), current_sum_read_request,"adc_read_request",1);
 }
 
@@ -30,6 +30,7 @@
 #include "hw/irq.h"
 #include "qom/object.h"
 #include "hw/sysbus.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_DWARF_INPUT "dwarf-input"
 
@@ -91,6 +92,7 @@ static void dwarf_button_init(Object *obj)
 {
     DwarfInputState *s = DWARF_INPUT(obj);
     qdev_init_gpio_out(DEVICE(obj), s->irq, 2);
+    p404_stats_count_gpio_out(obj);
 
     p404_key_handle pKey = p404_new_keyhandler(P404_KEYCLIENT(obj));
     p404_register_keyhandler(pKey, 'w',"Pushes top button");
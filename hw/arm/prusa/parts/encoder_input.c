@@ -26,6 +26,7 @@
 #include "../utility/macros.h"
 #include "../utility/ScriptHost_C.h"
 #include "../utility/ArgHelper.h"
+#include "../utility/p404_timer_stats.h"
 #include "migration/vmstate.h"
 #include "qemu/module.h"
 #include "hw/irq.h"
@@ -36,6 +37,7 @@
 #include "sysemu/runstate.h"
 #include "qapi/qapi-commands-run-state.h"
 #include "qapi/qapi-events-run-state.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_ENCODER_INPUT "encoder-input"
 
@@ -208,12 +210,13 @@ static void encoder_input_init(Object *obj)
     qdev_init_gpio_out_named(DEVICE(obj), &s->irq_enc_b, "encoder-b", 1);
     qdev_init_gpio_out_named(DEVICE(obj), s->cursor_xy, "cursor_xy", 2);
 	qdev_init_gpio_out_named(DEVICE(obj), &s->tap, "touch", 1);
+	p404_stats_count_gpio_out(obj);
     qemu_add_mouse_event_handler(&encoder_input_mouseevent,ENCODER_INPUT(obj),false, "encoder-mouse");
     // qemu_add_kbd_event_handler(&encoder_input_keyevent,s);
 
-    s->timer = timer_new_ms(QEMU_CLOCK_VIRTUAL,
+    s->timer = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "phase",
                     (QEMUTimerCB *)encoder_input_timer_expire, s);
-    s->release = timer_new_ms(QEMU_CLOCK_VIRTUAL,
+    s->release = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "release",
             (QEMUTimerCB *)buddy_autorelease_timer_expire, s);
 
     s->handle = script_instance_new(P404_SCRIPTABLE(obj), TYPE_ENCODER_INPUT);
@@ -31,6 +31,8 @@
 #include "../utility/p404scriptable.h"
 #include "../utility/ScriptHost_C.h"
 #include "qemu/module.h"
+#include "../utility/p404_stats.h"
+#include "../utility/p404_timer_stats.h"
 
 struct  fan_state
 {
@@ -178,16 +180,17 @@ static void fan_init(Object *obj){
     s->current_rpm = 0;
     s->usec_per_pulse = 0;
 
-    s->tach =timer_new_us(QEMU_CLOCK_VIRTUAL,
+    s->tach = p404_timer_new_us(obj, QEMU_CLOCK_VIRTUAL, "tach",
             (QEMUTimerCB *)fan_tach_expire, s);
 
 
-    s->softpwm =timer_new_ms(QEMU_CLOCK_VIRTUAL,
+    s->softpwm = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "softpwm",
             (QEMUTimerCB *)fan_softpwm_timeout, s);
 
     qdev_init_gpio_out_named(DEVICE(obj), &s->tach_pulse, "tach-out",1);
     qdev_init_gpio_out_named(DEVICE(obj), &s->pwm_out, "pwm-out",1);
     qdev_init_gpio_out_named(DEVICE(obj), &s->rpm_out, "rpm-out",1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in_named(DEVICE(obj), fan_pwm_change, "pwm-in",1);
     qdev_init_gpio_in_named(DEVICE(obj), fan_pwm_change_soft, "pwm-in-soft",1);
 
@@ -28,6 +28,8 @@
 #include "hw/qdev-properties.h"
 #include "hw/qdev-properties-system.h"
 #include "qom/object.h"
+#include "../utility/p404_timer_stats.h"
+#include "../utility/p404_stats.h"
 
 
 #define TYPE_GT911 "gt911"
@@ -190,7 +192,6 @@ static void gt911_scan(void *opaque)
 {
 	GT911State *s = GT911(opaque);
 	qemu_set_irq(s->interrupt, 1);
-	timer_mod(s->touch_scan, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) + 10);
 }
 
 static void gt911_coords_in(void* opaque, int n, int level)
@@ -213,6 +214,11 @@ static void gt911_coords_in(void* opaque, int n, int level)
 		s->regs.defs.TOUCH.PTS = level;
 		break;
 	}
+	// Report the new data on the next scan cycle, nothing to do when idle.
+	if (!timer_pending(s->touch_scan))
+	{
+		timer_mod(s->touch_scan, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) + 10);
+	}
 }
 
 static void gt911_realize(DeviceState *dev, Error **errp)
@@ -220,8 +226,9 @@ static void gt911_realize(DeviceState *dev, Error **errp)
 	GT911State *s = GT911(dev);
 	QEMU_BUILD_BUG_MSG(sizeof(s->regs.raw) != sizeof(s->regs.defs), "Register union misaligned!");
 	qdev_init_gpio_out(dev, &s->interrupt, 1);
+	p404_stats_count_gpio_out(OBJECT(dev));
 	qdev_init_gpio_in_named(dev, gt911_coords_in, "x_y_touch",3);
-	s->touch_scan = timer_new_ms(QEMU_CLOCK_VIRTUAL, gt911_scan, s);
+	s->touch_scan = p404_timer_new_ms(OBJECT(dev), QEMU_CLOCK_VIRTUAL, "touch_scan", gt911_scan, s);
 	timer_mod(s->touch_scan, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) + 10);
 }
 
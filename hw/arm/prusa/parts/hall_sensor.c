@@ -32,6 +32,7 @@
 #include "qom/object.h"
 #include "hw/sysbus.h"
 #include "hw/qdev-properties.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_HALL_SENSOR "hall-sensor"
 
@@ -149,6 +150,7 @@ static void hall_sensor_init(Object *obj)
     HallState *s = HALL_SENSOR(obj);
     qdev_init_gpio_out(DEVICE(obj), &s->irq, 1);
     qdev_init_gpio_out_named(DEVICE(obj), &s->status, "status",1);
+    p404_stats_count_gpio_out(obj);
 
 
     script_handle pScript = script_instance_new(P404_SCRIPTABLE(obj), TYPE_HALL_SENSOR);
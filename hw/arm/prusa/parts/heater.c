@@ -1,7 +1,8 @@
 /*
 	heater.c - a heater object for MINI404. There's not much to it,
-    it just ticks the temperature "up" at a determined rate when active on PWM and down in
-    in an exponential curve when off.
+    it heats at a rate set by the PWM and loses heat exponentially towards ambient
+    while it's off. The temperature is solved in closed form between PWM changes, the
+    250 ms tick only publishes it.
 
 	Original (C) 2020 VintagePC <https://github.com/vintagepc/>
     Adapted to QEMU/C in 2021
@@ -32,13 +33,10 @@
 #include "../utility/p404scriptable.h"
 #include "../utility/macros.h"
 #include "../utility/ScriptHost_C.h"
-
-
-//#define DBG if(s->chrLabel=='B')
-
-#ifndef DBG
-#define DBG if(false)
-#endif
+#include "../utility/p404_timer_stats.h"
+#include "../utility/p404_thermal.h"
+#include "../trace.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_HEATER "heater"
 OBJECT_DECLARE_SIMPLE_TYPE(heater_state, HEATER)
@@ -54,20 +52,23 @@ struct heater_state {
     uint8_t mass10x;
 
 	uint16_t resistancex100, voltagex100;
+	uint16_t tau_s; // Time constant for the cooldown to ambient.
 
     uint16_t pwm, lastpwm, timeout_level;
     uint16_t custom_pwm;
     int32_t current_x100, ambient_x100;
 
-    int16_t tick_overrun;
+    uint64_t last_off, last_on;
 
-    uint64_t last_tick, last_off, last_on;
-
-    bool is_ticking, use_custom_pwm;
+    bool use_custom_pwm;
 
     qemu_irq temp_out, pwm_out;
     QEMUTimer *temp_tick, *softpwm_timeout;
 
+    p404_thermal_t local; // Used unless the heater is a zone of a heater-grid.
+    p404_thermal_t *thermal;
+    int zone;
+
 	script_handle handle;
 };
 
@@ -77,79 +78,98 @@ enum {
     ActOpen,
     ActSet,
 };
+
 extern float heater_calculate_current(heater_state *s);
+extern void heater_set_thermal_zone(heater_state *s, p404_thermal_t *thermal, int zone);
 
-// Calculate current consumption based on given voltage/resistance, and scale by PWM.
-extern float heater_calculate_current(heater_state *s)
+static void heater_update_temp(heater_state *s)
 {
-	float currentmA = 0.f;
-	if (s->resistancex100)
-	{
-		float resistance = (float)s->resistancex100*( 1 + (0.0042f * (s->currentTemp - 20.f)) );
-		currentmA = ((float)s->voltagex100/resistance)*((float)s->pwm/255.f)*1000.f; // 100x cancelled by division.
-		//printf("Current: %u %c %f\n",s->pwm, s->chrLabel, currentmA);
-	}
-	return currentmA;
+    s->currentTemp = p404_thermal_get_temp(s->thermal, s->zone, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
 }
 
-static void heater_softpwm_timeout(void* opaque)
+// Feeds the effective PWM to the model, this is the only time the slope changes.
+static void heater_update_input(heater_state *s)
 {
-    heater_state *s = opaque;
-    s->pwm = s->timeout_level;
-    // Tickle timer if turned off.
-    if (!s->is_ticking) // Start the heater.
+    uint16_t usedpwmval = s->use_custom_pwm ? s->custom_pwm : s->pwm;
+    if (usedpwmval != s->lastpwm)
     {
-        timer_mod(s->temp_tick,qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) + 1);
-        s->is_ticking = true;
+        qemu_set_irq(s->pwm_out, usedpwmval);
+        s->lastpwm = usedpwmval;
+    }
+    p404_thermal_set_rate(s->thermal, s->zone, s->thermalMass*(usedpwmval/255.0),
+        qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+    trace_heater_pwm(s->chrLabel, usedpwmval);
+    if (!timer_pending(s->temp_tick)) // Start publishing again.
+    {
+        timer_mod(s->temp_tick, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) + 1);
     }
 }
 
-
+// Pushes the temperature out while it's changing, and settles on ambient once it's
+// close enough, like the old integrating tick did.
 static void heater_temp_tick_expire(void *opaque)
 {
     heater_state *s = opaque;
-    static const float updaterate = 0.25;
-    uint16_t usedpwmval = s->use_custom_pwm ? s->custom_pwm : s->pwm;
-
-    qemu_set_irq(s->pwm_out, usedpwmval);
-    uint64_t tNow = qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL);
-    if (usedpwmval || s->lastpwm>0)
+    heater_update_temp(s);
+    if (s->lastpwm || s->currentTemp>s->ambientTemp+0.3)
     {
-        float pwmval = (usedpwmval>s->lastpwm)? usedpwmval : s->lastpwm;
-        float fDelta = (s->thermalMass*(pwmval/255.0f))*updaterate;
-        s->currentTemp += fDelta;
-        DBG printf("Temp: %f %f\n", s->currentTemp, fDelta);
-        s->tick_overrun = 4;
-        s->lastpwm = usedpwmval;
-        s->last_tick = tNow;
-     } else {// Cooling - do a little exponential decay
-        float dT = (s->currentTemp - s->ambientTemp)*pow(2.7183,-0.005*updaterate);
-        s->currentTemp -= s->currentTemp - (s->ambientTemp + dT);
+        timer_mod(s->temp_tick, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL) + 250);
     }
-
-    if (usedpwmval || s->currentTemp>s->ambientTemp+0.3)
-	{
-        timer_mod(s->temp_tick, tNow+250);
-	}
     else
     {
-        s->is_ticking = false;
         s->currentTemp = s->ambientTemp;
+        p404_thermal_set_temp(s->thermal, s->zone, s->currentTemp, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
     }
     qemu_set_irq(s->temp_out, s->currentTemp*256.f);
 }
 
+// Called by the thermistor right before it converts, so the reading is current.
+static void heater_sample(void* opaque, int n, int level)
+{
+    heater_state *s = opaque;
+    heater_update_temp(s);
+    trace_heater_temp(s->chrLabel, s->currentTemp*1000.f);
+    qemu_set_irq(s->temp_out, s->currentTemp*256.f);
+}
+
+// Moves the heater's model into a shared (coupled) one, e.g. a modular bed.
+extern void heater_set_thermal_zone(heater_state *s, p404_thermal_t *thermal, int zone)
+{
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    heater_update_temp(s);
+    s->thermal = thermal;
+    s->zone = zone;
+    p404_thermal_set_temp(s->thermal, s->zone, s->currentTemp, now);
+    heater_update_input(s);
+}
+
+// Calculate current consumption based on given voltage/resistance, and scale by PWM.
+extern float heater_calculate_current(heater_state *s)
+{
+	float currentmA = 0.f;
+	if (s->resistancex100)
+	{
+		heater_update_temp(s);
+		float resistance = (float)s->resistancex100*( 1 + (0.0042f * (s->currentTemp - 20.f)) );
+		currentmA = ((float)s->voltagex100/resistance)*((float)s->pwm/255.f)*1000.f; // 100x cancelled by division.
+		//printf("Current: %u %c %f\n",s->pwm, s->chrLabel, currentmA);
+	}
+	return currentmA;
+}
+
+static void heater_softpwm_timeout(void* opaque)
+{
+    heater_state *s = opaque;
+    s->pwm = s->timeout_level;
+    heater_update_input(s);
+}
+
+
 static void heater_pwm_change(void* opaque, int n, int level)
 {
     heater_state *s = opaque;
 	s->pwm = level;
-	// Tickle timer if turned off.
-	uint64_t tNow = qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL);
-    if (!s->is_ticking) // Start the heater.
-    {
-        timer_mod(s->temp_tick,tNow + 1);
-        s->is_ticking = true;
-    }
+    heater_update_input(s);
 }
 
 static void heater_soft_pwm_change(void* opaque, int n, int level)
@@ -166,16 +186,11 @@ static void heater_soft_pwm_change(void* opaque, int n, int level)
         s->last_off = tNow;
         tOn = tNow - s->last_on;
         s->timeout_level = 0;
-        DBG printf("Ontime: %u\n",tOn);
+        trace_heater_soft_pwm_on_time(s->chrLabel, tOn);
         timer_mod(s->softpwm_timeout, tNow+3000);
         s->pwm = tOn & 0xFF;
     }
-    // Tickle timer if turned off.
-    if (!s->is_ticking) // Start the heater.
-    {
-        timer_mod(s->temp_tick,tNow + 1);
-        s->is_ticking = true;
-    }
+    heater_update_input(s);
 }
 
 static void heater_reset(DeviceState *dev)
@@ -185,6 +200,8 @@ static void heater_reset(DeviceState *dev)
     s->thermalMass = ((float)s->mass10x)/10.f;
     s->ambientTemp = 18.f;
     s->currentTemp = s->ambientTemp;
+    p404_thermal_set_temp(s->thermal, s->zone, s->currentTemp, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+    heater_update_input(s);
 }
 
 static int heater_process_action(P404ScriptIF *obj, unsigned int action, script_args args) {
@@ -193,20 +210,21 @@ static int heater_process_action(P404ScriptIF *obj, unsigned int action, script_
         case ActNormal:
             s->custom_pwm = 0;
             s->use_custom_pwm = false;
+            heater_update_input(s);
             break;
         case ActRunaway:
             s->custom_pwm = 255;
             s->use_custom_pwm = true;
-            if (!s->is_ticking){
-                timer_mod(s->softpwm_timeout, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+500);
-            }
+            heater_update_input(s);
             break;
         case ActOpen:
             s->custom_pwm = 0;
             s->use_custom_pwm = true;
+            heater_update_input(s);
             break;
         case ActSet:
             s->currentTemp = scripthost_get_float(args, 0);
+            p404_thermal_set_temp(s->thermal, s->zone, s->currentTemp, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
             qemu_set_irq(s->temp_out, s->currentTemp*256.f);
             break;
         default:
@@ -228,15 +246,17 @@ static void heater_init(Object *obj)
 
     qdev_init_gpio_out_named(DEVICE(obj), &s->temp_out, "temp_out", 1);
     qdev_init_gpio_out_named(DEVICE(obj), &s->pwm_out, "pwm-out", 1);
+    p404_stats_count_gpio_out(obj);
 
 
 	// TODO - fix these names so soft is explicit and raw is default.
     qdev_init_gpio_in_named(DEVICE(obj),heater_soft_pwm_change, "pwm_in", 1);
     qdev_init_gpio_in_named(DEVICE(obj),heater_pwm_change, "raw-pwm-in", 1);
+    qdev_init_gpio_in_named(DEVICE(obj),heater_sample, "temp_sample", 1);
 
-    s->temp_tick = timer_new_ms(QEMU_CLOCK_VIRTUAL,
+    s->temp_tick = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "temp_tick",
             (QEMUTimerCB *)heater_temp_tick_expire, s);
-    s->softpwm_timeout = timer_new_ms(QEMU_CLOCK_VIRTUAL,
+    s->softpwm_timeout = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "softpwm_timeout",
             (QEMUTimerCB *)heater_softpwm_timeout, s);
 
     s->handle = script_instance_new(P404_SCRIPTABLE(obj), TYPE_HEATER);
@@ -250,16 +270,28 @@ static void heater_init(Object *obj)
 
 }
 
+static void heater_realize(DeviceState *dev, Error **errp)
+{
+    heater_state *s = HEATER(dev);
+    double tau = s->tau_s;
+    p404_thermal_init(&s->local, 1, NULL, 0, &tau, 18.0, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+    s->thermal = &s->local;
+    s->zone = 0;
+}
+
 static Property heater_properties[] = {
     DEFINE_PROP_UINT8("thermal_mass_x10",heater_state, mass10x, 25),
     DEFINE_PROP_UINT8("label",heater_state, chrLabel, (uint8_t)' '),
 	DEFINE_PROP_UINT16("voltage_x100", heater_state, voltagex100, 2400),
 	DEFINE_PROP_UINT16("resistance_x100", heater_state, resistancex100, 0),
+	// 200s matches the old exp(-0.005*t) cooldown.
+	DEFINE_PROP_UINT16("tau_s", heater_state, tau_s, 200),
     DEFINE_PROP_END_OF_LIST(),
 };
 
 static int heater_pre_save(void *opaque) {
     heater_state *s = HEATER(opaque);
+    heater_update_temp(s);
     s->ambient_x100 = 100.f * s->ambientTemp;
     s->current_x100 = 100.f * s->currentTemp;
     return 0;
@@ -270,6 +302,13 @@ static int heater_post_load(void *opaque, int version) {
     s->ambientTemp = (float)s->ambient_x100/100.f;
     s->currentTemp = (float)s->current_x100/100.f;
     s->thermalMass = ((float)s->mass10x)/10.f;
+    // The snapshot may be from earlier (or later) in virtual time, so restart
+    // the model from now rather than advancing from the pre-load timestamp.
+    int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    p404_thermal_rebase(s->thermal, now);
+    p404_thermal_set_temp(s->thermal, s->zone, s->currentTemp, now);
+    s->lastpwm = ~s->lastpwm; // Forces pwm-out to be re-sent.
+    heater_update_input(s);
     return 0;
 }
 
@@ -288,11 +327,11 @@ static const VMStateDescription vmstate_heater = {
         VMSTATE_UINT16(custom_pwm,heater_state),
         VMSTATE_INT32(current_x100,heater_state),
         VMSTATE_INT32(ambient_x100,heater_state),
-        VMSTATE_INT16(tick_overrun,heater_state),
-        VMSTATE_UINT64(last_tick,heater_state),
+        VMSTATE_UNUSED(sizeof(int16_t)), // Was tick_overrun
+        VMSTATE_UNUSED(sizeof(uint64_t)), // Was last_tick
         VMSTATE_UINT64(last_off,heater_state),
         VMSTATE_UINT64(last_on,heater_state),
-        VMSTATE_BOOL(is_ticking,heater_state),
+        VMSTATE_UNUSED(sizeof(bool)), // Was is_ticking
         VMSTATE_BOOL(use_custom_pwm,heater_state),
         VMSTATE_TIMER_PTR(temp_tick,heater_state),
         VMSTATE_TIMER_PTR(softpwm_timeout,heater_state),
@@ -304,6 +343,7 @@ static const VMStateDescription vmstate_heater = {
 static void heater_class_init(ObjectClass *klass, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(klass);
+    dc->realize = heater_realize;
     dc->reset = heater_reset;
     dc->vmsd = &vmstate_heater;
     device_class_set_props(dc, heater_properties);
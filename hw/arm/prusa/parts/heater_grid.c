@@ -0,0 +1,173 @@
+/*
+	heater_grid.c - couples a rows x cols grid of heaters (e.g. the XL
+	modular bed) into one thermal model with conduction between neighbours.
+
+    Written for Mini404 in 2023 by VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qapi/error.h"
+#include "qom/object.h"
+#include "hw/sysbus.h"
+#include "hw/qdev-properties.h"
+#include "migration/vmstate.h"
+#include "qemu/timer.h"
+#include "../utility/macros.h"
+#include "../utility/p404_thermal.h"
+
+#define TYPE_HEATER_GRID "heater-grid"
+OBJECT_DECLARE_SIMPLE_TYPE(HeaterGridState, HEATER_GRID)
+
+typedef struct heater_state heater_state;
+
+struct HeaterGridState {
+    SysBusDevice parent;
+
+	heater_state *heaters[P404_THERMAL_MAX_ZONES]; // Row-major, unlinked zones are passive.
+	uint8_t rows, cols;
+	uint16_t coupling_x1000; // Conduction to each neighbour, 1/s x1000
+	uint16_t tau_s; // Cooldown of the passive zones, heaters bring their own.
+
+	p404_thermal_t thermal;
+	int32_t temp_x100[P404_THERMAL_MAX_ZONES];
+};
+
+extern void heater_set_thermal_zone(heater_state *s, p404_thermal_t *thermal, int zone);
+
+OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(HeaterGridState, heater_grid, HEATER_GRID, SYS_BUS_DEVICE, {NULL});
+
+static void heater_grid_finalize(Object *obj)
+{
+
+}
+
+static void heater_grid_init(Object *obj)
+{
+
+}
+
+static void heater_grid_realize(DeviceState *dev, Error **errp)
+{
+	HeaterGridState *s = HEATER_GRID(dev);
+	int n = s->rows * s->cols;
+	if (n == 0 || n > P404_THERMAL_MAX_ZONES)
+	{
+		error_setg(errp, "%s: %dx%d grid is not supported (max %d zones)", __func__, s->rows, s->cols, P404_THERMAL_MAX_ZONES);
+		return;
+	}
+	uint8_t neighbours[P404_THERMAL_MAX_ZONES * P404_THERMAL_MAX_ZONES] = {0};
+	for (int r=0; r<s->rows; r++)
+	{
+		for (int c=0; c<s->cols; c++)
+		{
+			int i = (r * s->cols) + c;
+			if (c+1 < s->cols)
+			{
+				neighbours[(i*n) + i + 1] = neighbours[((i+1)*n) + i] = 1;
+			}
+			if (r+1 < s->rows)
+			{
+				int j = i + s->cols;
+				neighbours[(i*n) + j] = neighbours[(j*n) + i] = 1;
+			}
+		}
+	}
+	double tau[P404_THERMAL_MAX_ZONES];
+	for (int i=0; i<n; i++)
+	{
+		tau[i] = s->heaters[i] ? object_property_get_uint(OBJECT(s->heaters[i]), "tau_s", &error_abort) : s->tau_s;
+	}
+	p404_thermal_init(&s->thermal, n, neighbours, (double)s->coupling_x1000/1000.0, tau, 18.0,
+		qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+	for (int i=0; i<n; i++)
+	{
+		if (s->heaters[i] != NULL)
+		{
+			heater_set_thermal_zone(s->heaters[i], &s->thermal, i);
+		}
+	}
+}
+
+static Property heater_grid_properties[] = {
+    DEFINE_PROP_UINT8("rows",HeaterGridState, rows, 4),
+    DEFINE_PROP_UINT8("cols",HeaterGridState, cols, 4),
+    DEFINE_PROP_UINT16("coupling_x1000",HeaterGridState, coupling_x1000, 20),
+    DEFINE_PROP_UINT16("tau_s",HeaterGridState, tau_s, 200),
+    DEFINE_PROP_LINK("heater[0]",HeaterGridState, heaters[0], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[1]",HeaterGridState, heaters[1], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[2]",HeaterGridState, heaters[2], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[3]",HeaterGridState, heaters[3], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[4]",HeaterGridState, heaters[4], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[5]",HeaterGridState, heaters[5], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[6]",HeaterGridState, heaters[6], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[7]",HeaterGridState, heaters[7], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[8]",HeaterGridState, heaters[8], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[9]",HeaterGridState, heaters[9], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[10]",HeaterGridState, heaters[10], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[11]",HeaterGridState, heaters[11], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[12]",HeaterGridState, heaters[12], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[13]",HeaterGridState, heaters[13], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[14]",HeaterGridState, heaters[14], "heater", heater_state*),
+    DEFINE_PROP_LINK("heater[15]",HeaterGridState, heaters[15], "heater", heater_state*),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
+// Each heater restores the temperature and input of its own zone; this covers
+// the passive zones and rebases the model on the post-load virtual time.
+static int heater_grid_pre_save(void *opaque)
+{
+	HeaterGridState *s = HEATER_GRID(opaque);
+	p404_thermal_advance(&s->thermal, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+	for (int i=0; i<s->thermal.n; i++)
+	{
+		s->temp_x100[i] = 100.0 * s->thermal.temp[i];
+	}
+	return 0;
+}
+
+static int heater_grid_post_load(void *opaque, int version_id)
+{
+	HeaterGridState *s = HEATER_GRID(opaque);
+	int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+	p404_thermal_rebase(&s->thermal, now);
+	for (int i=0; i<s->thermal.n; i++)
+	{
+		if (s->heaters[i] == NULL)
+		{
+			p404_thermal_set_temp(&s->thermal, i, (double)s->temp_x100[i]/100.0, now);
+		}
+	}
+	return 0;
+}
+
+static const VMStateDescription vmstate_heater_grid = {
+    .name = TYPE_HEATER_GRID,
+    .version_id = 1,
+    .minimum_version_id = 1,
+    .pre_save = heater_grid_pre_save,
+    .post_load = heater_grid_post_load,
+    .fields = (VMStateField[]) {
+        VMSTATE_INT32_ARRAY(temp_x100, HeaterGridState, P404_THERMAL_MAX_ZONES),
+        VMSTATE_END_OF_LIST()
+    }
+};
+
+static void heater_grid_class_init(ObjectClass *klass, void *data)
+{
+    DeviceClass *dc = DEVICE_CLASS(klass);
+    dc->realize = heater_grid_realize;
+    dc->vmsd = &vmstate_heater_grid;
+    device_class_set_props(dc, heater_grid_properties);
+}
@@ -25,12 +25,14 @@
 #include "../utility/macros.h"
 #include "../utility/ScriptHost_C.h"
 #include "../utility/ArgHelper.h"
+#include "../utility/p404_timer_stats.h"
 #include "migration/vmstate.h"
 #include "qemu/module.h"
 #include "qemu/timer.h"
 #include "hw/irq.h"
 #include "qom/object.h"
 #include "hw/sysbus.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_HX717 "hx717"
 
@@ -46,7 +48,6 @@ struct HX717State {
     int value[2]; // 24bit data to be clocked out.
 	bool is_raw[2];// Whether the value is
     int64_t value_gain; // value with gain applied.
-    int64_t last_high;
 
     uint8_t rate;
 
@@ -96,24 +97,15 @@ static void hx717_channel_in_raw(void *opaque, int n, int level){
 	timer_mod(s->tick, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+s->rate);
 }
 
+// Decoded purely from the count of rising edges since data-ready. The >60us SCK-high
+// power-down isn't modelled; the firmware can get preempted mid-readout, so it can't be
+// told apart from a slow clock pulse without accurate timing.
 static void hx717_sck(void *opaque, int n, int level){
     HX717State *s = HX717(opaque);
-    int64_t time = qemu_clock_get_us(QEMU_CLOCK_VIRTUAL);
-    if (level) {
-        s->last_high = time;
-        s->sck_count++;
-    } else if (time-s->last_high > 600){ // RESET condition... FIXME, at correct 60 this gets hit mid-readount and I don't know why yet.
-        return;
-        printf("HX717: Reset (%"PRId64")\n", time-s->last_high);
-        // s->channel = false;
-        // s->gain = 128;
-        // s->sck_count = 0;
-        qemu_set_irq(s->irq,1); // DOUT high when NR
-        timer_mod(s->tick, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+s->rate);
-    }
     if (!level) {
         return;
     }
+    s->sck_count++;
     //printf("HX717: L %d SCK: %u\n",level, s->sck_count);
     if (s->sck_count<=24) {
         qemu_set_irq(s->irq, (s->value_gain>>(24-s->sck_count))&1U);
@@ -181,6 +173,7 @@ static void hx717_init(Object *obj)
     HX717State *s = HX717(obj);
     qdev_init_gpio_out(DEVICE(obj), &s->irq, 1); // DOUT
     qdev_init_gpio_in(DEVICE(obj),hx717_sck,1);
+    p404_stats_count_gpio_out(obj);
 
     qdev_init_gpio_in_named(DEVICE(obj),hx717_channel_in,"input_x1000",2);
     qdev_init_gpio_in_named(DEVICE(obj),hx717_channel_in_raw,"input",2);
@@ -190,7 +183,7 @@ static void hx717_init(Object *obj)
     script_register_action(pScript, "Set", "Sets the load cell output to the given value", ACT_SET);
     script_add_arg_int(pScript, ACT_SET);
 
-    s->tick = timer_new_ms(QEMU_CLOCK_VIRTUAL,
+    s->tick = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "data_ready",
         (QEMUTimerCB *)hx717_data_ready, s);
 
     scripthost_register_scriptable(pScript);
@@ -207,7 +200,7 @@ static const VMStateDescription vmstate_hx717 = {
         VMSTATE_UINT8(rate, HX717State),
         VMSTATE_INT32_ARRAY(value,HX717State,2), // 24bit data to be clocked out.
         VMSTATE_INT64(value_gain, HX717State),
-        VMSTATE_INT64(last_high, HX717State),
+        VMSTATE_UNUSED(sizeof(int64_t)), // was last_high
         VMSTATE_TIMER_PTR(tick, HX717State),
         VMSTATE_END_OF_LIST()
     }
@@ -31,6 +31,7 @@
 #include "hw/irq.h"
 #include "qom/object.h"
 #include "hw/sysbus.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_IRSENSOR "ir-sensor"
 
@@ -102,6 +103,7 @@ static void irsensor_init(Object *obj)
 {
     IRState *s = IRSENSOR(obj);
     qdev_init_gpio_out(DEVICE(obj), &s->irq, 1);
+    p404_stats_count_gpio_out(obj);
 
     s->handle = script_instance_new(P404_SCRIPTABLE(obj), TYPE_IRSENSOR);
 
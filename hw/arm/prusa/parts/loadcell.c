@@ -26,12 +26,16 @@
 #include "../utility/macros.h"
 #include "../utility/ScriptHost_C.h"
 #include "../utility/ArgHelper.h"
+#include "../utility/p404_motor_if.h"
 #include "migration/vmstate.h"
 #include "qemu/module.h"
 #include "qemu/timer.h"
 #include "hw/irq.h"
 #include "qom/object.h"
 #include "hw/sysbus.h"
+#include "hw/qdev-properties.h"
+#include "../utility/p404_stats.h"
+#include "../utility/p404_timer_stats.h"
 
 #define TYPE_LOADCELL "loadcell"
 
@@ -48,6 +52,9 @@ struct LoadcellState {
 	uint8_t tap;
 	p404_key_handle key;
 	QEMUTimer* timer;
+
+    P404MotorIF *motor; // Optional Z motor, watched instead of using the GPIO input.
+    int watch;
 };
 
 OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(LoadcellState, loadcell, LOADCELL, SYS_BUS_DEVICE, {TYPE_P404_SCRIPTABLE}, {TYPE_P404_KEYCLIENT}, {NULL})
@@ -91,6 +98,31 @@ static void loadcell_zpos_in(void *opaque, int n, int level){
         }
     }
     s->last_pos = level;
+    if (s->motor && s->is_zero) {
+        // Nothing to do until it comes back down to the start height.
+        p404_motor_if_set_watch_window(s->motor, s->watch, START_HEIGHT+1, INT32_MAX);
+    }
+}
+
+static void loadcell_realize(DeviceState *dev, Error **errp)
+{
+    LoadcellState *s = LOADCELL(dev);
+    s->watch = -1;
+    if (s->motor) {
+        s->watch = p404_motor_if_add_watch(s->motor, P404_MOTOR_WATCH_UM, 0, loadcell_zpos_in, s, 0);
+        if (s->watch < 0) {
+            s->motor = NULL;
+        }
+    }
+}
+
+static int loadcell_post_load(void *opaque, int version_id)
+{
+    LoadcellState *s = LOADCELL(opaque);
+    if (s->motor) {
+        p404_motor_if_reset_watch(s->motor, s->watch);
+    }
+    return 0;
 }
 
 static void loadcell_tap_timer(void *opaque)
@@ -146,6 +178,7 @@ static void loadcell_init(Object *obj)
 {
     LoadcellState *s = LOADCELL(obj);
     qdev_init_gpio_out(DEVICE(obj), &s->irq, 1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in(DEVICE(obj),loadcell_zpos_in,1);
 
     script_handle pScript = script_instance_new(P404_SCRIPTABLE(obj), TYPE_LOADCELL);
@@ -154,13 +187,14 @@ static void loadcell_init(Object *obj)
 	s->key = p404_new_keyhandler(P404_KEYCLIENT(obj));
     p404_register_keyhandler(s->key, 't',"Taps the loadcell");
 
-	s->timer = timer_new_ms(QEMU_CLOCK_VIRTUAL, loadcell_tap_timer, s);
+	s->timer = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "tap", loadcell_tap_timer, s);
 }
 
 static const VMStateDescription vmstate_loadcell = {
     .name = TYPE_LOADCELL,
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = loadcell_post_load,
     .fields = (VMStateField[]) {
         VMSTATE_BOOL(is_zero,LoadcellState),
         VMSTATE_INT32(last_pos, LoadcellState),
@@ -168,10 +202,17 @@ static const VMStateDescription vmstate_loadcell = {
     }
 };
 
+static Property loadcell_properties[] = {
+    DEFINE_PROP_LINK("motor",LoadcellState, motor, TYPE_P404_MOTOR_IF, P404MotorIF*),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
 static void loadcell_class_init(ObjectClass *oc, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(oc);
+    dc->realize = loadcell_realize;
     dc->reset = loadcell_reset;
+    device_class_set_props(dc, loadcell_properties);
     dc->vmsd = &vmstate_loadcell;
     P404ScriptIFClass *sc = P404_SCRIPTABLE_CLASS(oc);
     sc->ScriptHandler = loadcell_process_action;
@@ -25,6 +25,7 @@
 #include "qemu/module.h"
 #include "qemu/timer.h"
 #include "qom/object.h"
+#include "../utility/p404_timer_stats.h"
 
 #define MQ 0
 #define FILE 0
@@ -293,7 +294,7 @@ static void mini_visuals_realize(Object *obj)
     }
     memset(s->buffer, 0,BUFFER_SIZE);
     setbuffer(s->fd_pipe, s->buffer,BUFFER_SIZE);
-    s->timer_flush = timer_new_ms(QEMU_CLOCK_VIRTUAL, mini_visuals_flush_timer, s);
+    s->timer_flush = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "flush", mini_visuals_flush_timer, s);
 #else
     s->queue = shmemq_open(IPC_FILE);
     if (s->queue == NULL)
@@ -31,6 +31,7 @@
 #include "sysemu/sysemu.h"
 #include "hw/sysbus.h"
 #include "ui/console.h"
+#include "../utility/p404_stats.h"
 
 struct ModBedVisualsState {
     SysBusDevice parent;
@@ -47,6 +48,8 @@ struct ModBedVisualsState {
 	uint8_t on_pwm[16];
 	uint8_t* on_ptrs[16];
 	uint8_t* temp_ptrs[16];
+
+	p404_stats_t *stats;
 };
 
 
@@ -73,8 +76,10 @@ static void G_GNUC_PRINTF (2, 3) mod_bed_visuals_printf(void *opaque,
         // This is not particularly efficient, but it'll do for now.
         if (buf[i]=='\n') {
             qemu_chr_fe_write(&s->be, &cr, 1);
+            p404_stats_inc(s->stats, P404_STAT_CHR_BYTES);
         }
         qemu_chr_fe_write(&s->be, (uint8_t*)buf+i, 1);
+        p404_stats_inc(s->stats, P404_STAT_CHR_BYTES);
     }
     // qemu_chr_fe_write_all(&s->be, (uint8_t*)buf, strlen(buf));
     g_free(buf);
@@ -201,6 +206,8 @@ static void mod_bed_visuals_heat_in(void* opaque, int n, int level)
 }
 
 static void mod_bed_visuals_read(void *opaque, const uint8_t *buf, int size){
+    ModBedVisualsState *s = MOD_BED_VISUALS(opaque);
+    p404_stats_add(s->stats, P404_STAT_CHR_BYTES, size);
 }
 
 OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(ModBedVisualsState, mod_bed_visuals, MOD_BED_VISUALS, SYS_BUS_DEVICE, {NULL})
@@ -220,6 +227,8 @@ static void mod_bed_visuals_realize(DeviceState *d, Error **errp)
     ModBedVisualsState *s = MOD_BED_VISUALS(d);
 	QemuOpts *opts;
 
+	s->stats = p404_stats_get(OBJECT(d));
+
 	opts = qemu_opts_create(qemu_find_opts("chardev"), "Modular-Bed", 1, NULL);
 	qemu_opt_set(opts, "backend","vc", &error_abort);
 	qemu_opt_set(opts, "cols", "20", &error_abort);
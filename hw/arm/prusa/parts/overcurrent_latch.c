@@ -30,6 +30,7 @@
 #include "hw/irq.h"
 #include "qom/object.h"
 #include "hw/sysbus.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_OCLATCH "oc-latch"
 
@@ -93,6 +94,7 @@ static void oc_latch_init(Object *obj)
 {
     OCLatchState *s = OCLATCH(obj);
     qdev_init_gpio_out(DEVICE(obj), &s->irq, 1);
+    p404_stats_count_gpio_out(obj);
 	qdev_init_gpio_in(DEVICE(obj), oc_latch_reset_in,1);
 
     script_handle pScript = script_instance_new(P404_SCRIPTABLE(obj), TYPE_OCLATCH);
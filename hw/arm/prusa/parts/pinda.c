@@ -25,11 +25,14 @@
 #include "../utility/macros.h"
 #include "../utility/ScriptHost_C.h"
 #include "../utility/ArgHelper.h"
+#include "../utility/p404_motor_if.h"
 #include "migration/vmstate.h"
 #include "qemu/module.h"
 #include "hw/irq.h"
 #include "qom/object.h"
 #include "hw/sysbus.h"
+#include "hw/qdev-properties.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_PINDA "pinda"
 
@@ -46,6 +49,8 @@ struct PindaState {
     bool first_fired;
     qemu_irq irq;
     script_handle handle;
+    P404MotorIF *motors[3]; // Optional, position watches are used instead of position_xyz if set.
+    int watch[3];
 };
 
 enum {
@@ -55,6 +60,7 @@ enum {
 
 #define Z_MM_TO_STEPS 400.F*16.F
 #define XY_TO_STEPS 100.F*16.F
+#define XY_CELL_STEPS (46*XY_TO_STEPS)
 
 OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(PindaState, pinda, PINDA, SYS_BUS_DEVICE, {TYPE_P404_SCRIPTABLE}, {NULL})
 
@@ -63,16 +69,32 @@ static void pinda_finalize(Object *obj)
 {
 }
 
+// Z only needs to be looked at again when it crosses the trigger height of the current cell.
+static void pinda_update_zwatch(PindaState *s) {
+    if (s->motors[2] == NULL) {
+        return;
+    }
+    uint8_t x = s->current_pos[0]/(XY_CELL_STEPS);
+    uint8_t y = s->current_pos[1]/(XY_CELL_STEPS);
+    int32_t trigger = s->step_mesh[y][x];
+    if (s->state) {
+        p404_motor_if_set_watch_window(s->motors[2], s->watch[2], INT32_MIN, trigger);
+    } else {
+        p404_motor_if_set_watch_window(s->motors[2], s->watch[2], trigger + 1, INT32_MAX);
+    }
+}
+
 static void pinda_reset(DeviceState *dev)
 {
     PindaState *s = PINDA(dev);
     qemu_set_irq(s->irq,0);
     s->state = false;
+    pinda_update_zwatch(s);
 }
 
 static void pinda_update(PindaState *s) {
-    uint8_t x = s->current_pos[0]/(46*XY_TO_STEPS);
-    uint8_t y = s->current_pos[1]/(46*XY_TO_STEPS);
+    uint8_t x = s->current_pos[0]/(XY_CELL_STEPS);
+    uint8_t y = s->current_pos[1]/(XY_CELL_STEPS);
     bool newstate = s->current_pos[2] <= (s->step_mesh[y][x]);
     // if (newstate) printf("PINDA update at %u, %u, %u\n", s->current_pos[0],s->current_pos[1],s->current_pos[2]);
 
@@ -82,7 +104,7 @@ static void pinda_update(PindaState *s) {
         s->state = newstate;
         s->first_fired = true;
     }
-
+    pinda_update_zwatch(s);
 }
 
 static void pinda_move(void *opaque, int n, int level)
@@ -91,6 +113,26 @@ static void pinda_move(void *opaque, int n, int level)
     s->current_pos[n] = level;
     if (n==2){
         pinda_update(s);
+    } else {
+        pinda_update_zwatch(s); // New XY cell, new trigger height.
+    }
+}
+
+static void pinda_realize(DeviceState *dev, Error **errp)
+{
+    PindaState *s = PINDA(dev);
+    // XY only matter at cell granularity, Z is windowed around the trigger point.
+    static const int32_t granularity[3] = {XY_CELL_STEPS, XY_CELL_STEPS, 0};
+    for (int i=0; i<3; i++) {
+        s->watch[i] = -1;
+    }
+    for (int i=0; i<3; i++) {
+        if (s->motors[i]) {
+            s->watch[i] = p404_motor_if_add_watch(s->motors[i], P404_MOTOR_WATCH_STEPS, granularity[i], pinda_move, s, i);
+            if (s->watch[i] < 0) {
+                s->motors[i] = NULL;
+            }
+        }
     }
 }
 
@@ -150,6 +192,7 @@ static void pinda_init(Object *obj)
 {
     PindaState *s = PINDA(obj);
     qdev_init_gpio_out(DEVICE(obj), &s->irq, 1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in_named(DEVICE(obj),pinda_move,"position_xyz",3);
 
     for (int i=0; i<4; i++) {
@@ -172,6 +215,12 @@ static void pinda_init(Object *obj)
 static int pinda_post_load(void *opaque, int version_id)
 {
     PindaState *s = PINDA(opaque);
+    // Windows were set up for the pre-load position, re-sync on the next step.
+    for (int i=0; i<3; i++) {
+        if (s->motors[i]) {
+            p404_motor_if_reset_watch(s->motors[i], s->watch[i]);
+        }
+    }
     for (int i=0; i<4; i++) {
         for (int j=0; j<4; j++) {
             s->mesh_mm[i][j] = (float)s->step_mesh[i][j]/Z_MM_TO_STEPS;
@@ -194,10 +243,19 @@ static const VMStateDescription vmstate_pinda = {
     }
 };
 
+static Property pinda_properties[] = {
+    DEFINE_PROP_LINK("motor[0]",PindaState, motors[0], TYPE_P404_MOTOR_IF, P404MotorIF*),
+    DEFINE_PROP_LINK("motor[1]",PindaState, motors[1], TYPE_P404_MOTOR_IF, P404MotorIF*),
+    DEFINE_PROP_LINK("motor[2]",PindaState, motors[2], TYPE_P404_MOTOR_IF, P404MotorIF*),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
 static void pinda_class_init(ObjectClass *oc, void *data)
 {
     DeviceClass *dc = DEVICE_CLASS(oc);
+    dc->realize = pinda_realize;
     dc->reset = pinda_reset;
+    device_class_set_props(dc, pinda_properties);
     dc->vmsd = &vmstate_pinda;
     P404ScriptIFClass *sc = P404_SCRIPTABLE_CLASS(oc);
     sc->ScriptHandler = pinda_process_action;
@@ -26,6 +26,7 @@
 #include "../utility/p404_keyclient.h"
 #include "../utility/ScriptHost_C.h"
 #include "migration/vmstate.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_POWERSOURCE "powersource"
 OBJECT_DECLARE_SIMPLE_TYPE(PSState, POWERSOURCE)
@@ -112,6 +113,7 @@ static void powersource_init(Object *obj)
 
     qdev_init_gpio_out_named(DEVICE(obj), &s->irq, "v_sense", 1);
     qdev_init_gpio_out_named(DEVICE(obj), &s->panic, "panic", 1);
+    p404_stats_count_gpio_out(obj);
     qdev_init_gpio_in_named(DEVICE(obj),powersource_read_request,"adc_read_request",1);
 
     script_handle pScript = script_instance_new(P404_SCRIPTABLE(obj), TYPE_POWERSOURCE);
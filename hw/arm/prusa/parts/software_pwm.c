@@ -27,6 +27,8 @@
 #include "migration/vmstate.h"
 #include "hw/sysbus.h"
 #include "hw/irq.h"
+#include "../trace.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_SOFTWARE_PWM "software-pwm"
 #define LINE_COUNT 16
@@ -101,7 +103,7 @@ static void software_pwm_line(void *opaque, int n, int level)
 	if (s->last_pwm[n] == 0 && level)
 	{
 		qemu_set_irq(s->pwm[n], 255);
-		printf("SPWM: first-on\n");
+		trace_software_pwm_first_on(n);
 	}
 }
 
@@ -125,6 +127,7 @@ static void software_pwm_init(Object *obj)
 	qdev_init_gpio_in_named(dev, software_pwm_tick, "tick-in",1);
 	qdev_init_gpio_in_named(dev, software_pwm_line, "gpio-in",LINE_COUNT);
 	qdev_init_gpio_out(dev, s->pwm, LINE_COUNT);
+	p404_stats_count_gpio_out(obj);
 }
 
 static void softwar_pwm_class_init(ObjectClass *klass, void *data)
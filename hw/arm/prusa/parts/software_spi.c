@@ -29,6 +29,7 @@
 #include "hw/ssi/ssi.h"
 #include "hw/sysbus.h"
 #include "hw/irq.h"
+#include "../utility/p404_stats.h"
 
 #define TYPE_SOFTWARE_SPI "software-spi"
 
@@ -121,6 +122,7 @@ static void software_spi_init(Object *obj)
 	qdev_init_gpio_in_named(dev, software_spi_sck, "sck",1);
 	qdev_init_gpio_in_named(dev, software_spi_miso, "miso-byte",1);
 	qdev_init_gpio_out_named(dev, &s->miso, "miso", 1);
+	p404_stats_count_gpio_out(obj);
 
     s->ssi = ssi_create_bus(dev, "ssi");
 }
@@ -34,8 +34,10 @@
 #include "../utility/p404scriptable.h"
 #include "../utility/p404_keyclient.h"
 #include "../utility/ScriptHost_C.h"
+#include "../trace.h"
 
 #include "png.h"
+#include "../utility/p404_stats.h"
 
 //#define DEBUG_ILI9488 1
 
@@ -210,17 +212,17 @@ static uint32_t spi_display_transfer(SSIPeripheral *dev, uint32_t data)
             DATA(4);
             s->col = s->col_start = (s->cmd_data[0]<<8|s->cmd_data[1]) % s->dpy_info->cols;
             s->col_end = (s->cmd_data[2]<<8|s->cmd_data[3]) % s->dpy_info->cols;
-            // printf("CASET %d -> %d (%d -> %d) \n", s->col, s->col_end, s->cmd_data[0], s->cmd_data[1]);
+            trace_spi_display_caset(s->col_start, s->col_end);
             break;
         case CMD_RASET: /* Set row.  */
             DATA(4);
             s->row = s->row_start = (s->cmd_data[0]<<8|s->cmd_data[1]) % s->dpy_info->rows;
             s->row_end = (s->cmd_data[2]<<8|s->cmd_data[3]) % s->dpy_info->rows;
-            // printf("RASET %d -> %d (%d -> %d) \n", s->row, s->row_end, s->cmd_data[0], s->cmd_data[1]);
+            trace_spi_display_raset(s->row_start, s->row_end);
             break;
         case CMD_MADCTL:
             DATA(1);
-            printf("TODO: MADCTL: %02x\n",s->cmd_data[0]);
+            trace_spi_display_madctl(s->cmd_data[0]);
 			s->madctl = s->cmd_data[0];
             break;
         case CMD_COLMOD:
@@ -244,7 +246,7 @@ static uint32_t spi_display_transfer(SSIPeripheral *dev, uint32_t data)
             {
                 s->row = s->row_start;
                 s->col = s->col_start;
-                // printf("RAWR: %d %d\n", sr->row, s->col);
+                trace_spi_display_ramwr(s->row, s->col);
                 DATA(s->bpp_mode == 16 ? 2 : 3);
             } else {// One of an unknown number of 16-bit words.
                 switch (s->bpp_mode) {
@@ -495,6 +497,7 @@ static void spi_display_realize(SSIPeripheral *d, Error **errp)
     qdev_init_gpio_in_named(dev, spi_display_led, "leds", N_LEDS);
 	qdev_init_gpio_in_named(dev, spi_display_reset, "reset", 1);
 	qdev_init_gpio_out_named(dev, &s->reset, "reset-out", 1);
+	p404_stats_count_gpio_out(OBJECT(d));
 
     s->handle = script_instance_new(P404_SCRIPTABLE(s), TYPE_SPI_DISPLAY);
 
@@ -31,6 +31,7 @@
 #include "../utility/p404scriptable.h"
 #include "../utility/ScriptHost_C.h"
 #include "spi_rgb.h"
+#include "../utility/p404_stats.h"
 
 #define B1_10M5Hz 0b1111111000000
 #define B0_10M5Hz 0b111000000000
@@ -204,6 +205,7 @@ static void rgb_led_realize(SSIPeripheral *d, Error **errp)
     qdev_init_gpio_out_named(dev, &s->reset, "reset-out", 1);
     qdev_init_gpio_out_named(dev, &s->colour, "colour", 1);
     qdev_init_gpio_out_named(dev, s->rgb_out, "rgb-out", 3);
+    p404_stats_count_gpio_out(OBJECT(d));
 
 }
 
@@ -24,11 +24,13 @@
 #include "qemu/module.h"
 #include "hw/sysbus.h"
 #include "hw/qdev-properties.h"
-#include "thermistortables.h"
+#include "thermistor_table_list.h"
+#include "thermistor_lut.h"
 #include "migration/vmstate.h"
 #include "../utility/macros.h"
 #include "../utility/p404scriptable.h"
 #include "../utility/ScriptHost_C.h"
+#include "../utility/p404_stats.h"
 #include <math.h>
 
 #define TYPE_THERMISTOR "thermistor"
@@ -38,11 +40,14 @@ struct ThermistorState {
     SysBusDevice parent;
 
     qemu_irq irq_value, value_x1000, temp_out;
+    qemu_irq sample_out; // Asks the heat source to push its current temperature before we convert.
 
     uint8_t index;
     uint16_t table_index;
     const short int *table;
     int table_length;
+    thermistor_lut_t lut;
+    uint16_t lut_index; // Table the LUT was built for.
     float temperature;
     float custom_temp;
     bool use_custom;
@@ -63,8 +68,6 @@ enum {
     ActGetTemp,
 };
 
-#define KELVIN_OFFSET 273.15f
-
 static int map(long x, long in_min, long in_max, long out_min, long out_max) {
     return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 }
@@ -74,6 +77,7 @@ static void thermistor_read_request(void *opaque, int n, int level) {
         return;
     }
 	ThermistorState *s = opaque;
+    qemu_set_irq(s->sample_out, 1);
     float value = s->use_custom ? s->custom_temp : s->temperature;
     qemu_set_irq(s->temp_out, 256U*value);
     if (s->table_index==0) {
@@ -82,37 +86,33 @@ static void thermistor_read_request(void *opaque, int n, int level) {
     }
 	else if (s->table_index == 65535) // Modbed conversion map:
 	{
-		// reversal of how the temperature is calculated by the firmware...
-		value += KELVIN_OFFSET;
-		value = 1.0f/value;
-		value -= (1.0f / (25.0f + KELVIN_OFFSET));
-		value *= 4573.f;
-		value = exp(value);
-		value *= 100000; // should now have resistance.
-		value = (4095.f * value) / (value + 4700);
-		qemu_set_irq(s->irq_value, value);
+		int32_t adc;
+		if (!thermistor_lut_lookup(&s->lut, value, &adc))
+		{
+			adc = thermistor_lut_modbed(value);
+		}
+		qemu_set_irq(s->irq_value, adc);
 		return;
 	}
-	for (uint16_t i= 0; i<s->table_length; i+=2) {
-		if (s->table[i+1] <= value) {
-			uint16_t tt = s->table[i];
-			/* small linear regression between table samples */
-			if ( i !=0 && s->table[i+1] < value) {
-				int16_t d_adc = s->table[i] - s->table[i-2];
-				float d_temp = s->table[i+1] - s->table[i-1];
-				float delta = value - s->table[i+1];
-				tt = s->table[i] + (d_adc * (delta / d_temp));
-			}
-			int value = (((tt / s->oversampling)));
-			value <<=2; // Note - ADC takes full 12 bit input, but the tables are only 10-bit
-			qemu_set_irq(s->irq_value,value);
-            if (s->table_index==21) {  // Special case for PT100 on HX717 - map ADC value to direct reading.
-                value = map(value, 0,0x3FF, -980000, 2070000)*125;
-            }
-			qemu_set_irq(s->irq_value,value);
-			qemu_set_irq(s->value_x1000,value);
-            return;
+	int32_t tt;
+	if (!thermistor_lut_lookup(&s->lut, value, &tt))
+	{
+		if (s->lut.adc == NULL || value < s->lut.min_temp)
+		{
+			return; // Below the table, no reading.
 		}
+		tt = s->lut.adc[s->lut.count - 1]; // Hotter than the table, same as its first entry.
+	}
+	if (tt != INT32_MIN)
+	{
+		int value = (((tt / s->oversampling)));
+		value <<=2; // Note - ADC takes full 12 bit input, but the tables are only 10-bit
+		qemu_set_irq(s->irq_value,value);
+		if (s->table_index==21) {  // Special case for PT100 on HX717 - map ADC value to direct reading.
+			value = map(value, 0,0x3FF, -980000, 2070000)*125;
+		}
+		qemu_set_irq(s->irq_value,value);
+		qemu_set_irq(s->value_x1000,value);
 	}
 
 }
@@ -156,55 +156,29 @@ static int thermistor_process_action(P404ScriptIF *obj, unsigned int action, scr
 }
 
 static void thermistor_set_table(ThermistorState *s) {
-    switch (s->table_index)
+    const thermistor_table_def_t *def = thermistor_table_find(s->table_index);
+    if (def == NULL && s->table_index != UINT16_MAX)
     {
-        case 1:
-            s->table_length = 2*BEDTEMPTABLE_LEN;
-            s->table = &temptable_1[0][0];
-            break;
-        case 5:
-            s->table = &temptable_5[0][0];
-            s->table_length = 2*HEATER_0_TEMPTABLE_LEN;
-            break;
-        case 2000:
-            s->table_length = 2*AMBIENTTEMPTABLE_LEN;
-            s->table = &temptable_2000[0][0];
-            break;
-		case 2004:
-            s->table_length = 17*2;
-            s->table = &temptable_2004[0][0];
-			break;
-        case 2005:
-            s->table_length = 22*2;
-            s->table = &temptable_2005[0][0];
-            break;
-        case 21:
-            s->table_length = 6;
-            s->table = &temptable_21[0][0];
-            break;
-        case 22:
-            s->table_length = 4;
-            s->table = &temptable_22[0][0];
-            break;
-		case 2006:
-			s->table_length = 2U*127;
-			s->table = &temptable_2006[0][0];
-			break;
-		case 2007:
-			s->table_length = 2U*291;
-			s->table = &temptable_2007[0][0];
-			break;
-		case 2008:
-			s->table_length = 2U*205;
-			s->table = &temptable_2008[0][0];
-			break;
-        default:
-			printf("%s WARNING: Unhandled thermistor table %u!\n",__FILE__,s->table_index);
-			/* FALLTHRU */
-		case UINT16_MAX:
-            s->table = NULL;
-            s->table_length = 0;
-            break;
+        printf("%s WARNING: Unhandled thermistor table %u!\n",__FILE__,s->table_index);
+    }
+    s->table = def ? def->table : NULL;
+    s->table_length = def ? def->length : 0;
+    // Conversions are a single lookup, the table walk only happens here.
+    if (s->lut.adc == NULL || s->lut_index != s->table_index)
+    {
+        if (s->table_index == UINT16_MAX)
+        {
+            thermistor_lut_build_modbed(&s->lut);
+        }
+        else if (s->table != NULL)
+        {
+            thermistor_lut_build_table(&s->lut, s->table, s->table_length);
+        }
+        else
+        {
+            thermistor_lut_free(&s->lut);
+        }
+        s->lut_index = s->table_index;
     }
 }
 
@@ -220,6 +194,8 @@ OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(ThermistorState, thermistor, THERMISTO
 
 static void thermistor_finalize(Object *obj)
 {
+    ThermistorState *s = THERMISTOR(obj);
+    thermistor_lut_free(&s->lut);
 
 }
 
@@ -231,6 +207,8 @@ static void thermistor_init(Object *obj)
     qdev_init_gpio_out_named(DEVICE(obj), &s->value_x1000, "value_x1000", 1);
 
     qdev_init_gpio_out_named(DEVICE(obj), &s->temp_out, "temp_out_256x", 1);
+    qdev_init_gpio_out_named(DEVICE(obj), &s->sample_out, "thermistor_sample", 1);
+    p404_stats_count_gpio_out(obj);
 
     qdev_init_gpio_in_named(DEVICE(obj),thermistor_read_request, "thermistor_read_request", 1);
     qdev_init_gpio_in_named(DEVICE(obj),thermistor_temp_in, "thermistor_set_temperature", 1);
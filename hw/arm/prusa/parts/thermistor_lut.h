@@ -0,0 +1,137 @@
+/*
+	thermistor_lut.h - Temperature -> ADC conversion for thermistor tables,
+	precomputed into a direct-indexed array at 0.1 C resolution.
+
+    Written for Mini404 in 2023 by VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THERMISTOR_LUT_H
+#define THERMISTOR_LUT_H
+
+// Header-only so the unit test can check it against the tables without the device.
+
+#include "qemu/osdep.h"
+#include <math.h>
+
+#define THERMISTOR_LUT_STEPS_PER_C 10
+
+// Range used for the modular bed conversion, outside of this it's computed directly.
+#define THERMISTOR_LUT_MODBED_MIN -40.f
+#define THERMISTOR_LUT_MODBED_MAX 400.f
+
+#define THERMISTOR_LUT_KELVIN_OFFSET 273.15f
+
+typedef struct {
+	float min_temp, max_temp;
+	uint32_t count;
+	int32_t *adc; // count entries, INT32_MIN where there's no reading.
+} thermistor_lut_t;
+
+// The original conversion: walks a Marlin-style {adc, temp} table and interpolates
+// linearly between samples. Returns false if the temperature is below the table.
+static inline bool thermistor_lut_interpolate(const short *table, int table_length, float value, int32_t *adc)
+{
+	for (uint16_t i= 0; i<table_length; i+=2) {
+		if (table[i+1] <= value) {
+			uint16_t tt = table[i];
+			/* small linear regression between table samples */
+			if ( i !=0 && table[i+1] < value) {
+				int16_t d_adc = table[i] - table[i-2];
+				float d_temp = table[i+1] - table[i-1];
+				float delta = value - table[i+1];
+				tt = table[i] + (d_adc * (delta / d_temp));
+			}
+			*adc = tt;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Reversal of how the modular bed firmware calculates temperature (12-bit ADC value).
+static inline int32_t thermistor_lut_modbed(float value)
+{
+	value += THERMISTOR_LUT_KELVIN_OFFSET;
+	value = 1.0f/value;
+	value -= (1.0f / (25.0f + THERMISTOR_LUT_KELVIN_OFFSET));
+	value *= 4573.f;
+	value = exp(value);
+	value *= 100000; // should now have resistance.
+	value = (4095.f * value) / (value + 4700);
+	return value;
+}
+
+static inline void thermistor_lut_free(thermistor_lut_t *lut)
+{
+	g_free(lut->adc);
+	memset(lut, 0, sizeof(*lut));
+}
+
+static inline void thermistor_lut_alloc(thermistor_lut_t *lut, float min_temp, float max_temp)
+{
+	thermistor_lut_free(lut);
+	lut->min_temp = min_temp;
+	lut->max_temp = max_temp;
+	lut->count = lroundf((max_temp - min_temp) * THERMISTOR_LUT_STEPS_PER_C) + 1;
+	lut->adc = g_new(int32_t, lut->count);
+}
+
+static inline float thermistor_lut_temp(const thermistor_lut_t *lut, uint32_t index)
+{
+	return lut->min_temp + ((float)index / THERMISTOR_LUT_STEPS_PER_C);
+}
+
+// Covers the full temperature span of the table, everything above it clamps
+// to the hottest entry just like the table walk does.
+static inline void thermistor_lut_build_table(thermistor_lut_t *lut, const short *table, int table_length)
+{
+	short min_temp = table[1], max_temp = table[1];
+	for (int i=2; i<table_length; i+=2)
+	{
+		min_temp = MIN(min_temp, table[i+1]);
+		max_temp = MAX(max_temp, table[i+1]);
+	}
+	thermistor_lut_alloc(lut, min_temp, max_temp);
+	for (uint32_t i=0; i<lut->count; i++)
+	{
+		if (!thermistor_lut_interpolate(table, table_length, thermistor_lut_temp(lut, i), &lut->adc[i]))
+		{
+			lut->adc[i] = INT32_MIN;
+		}
+	}
+}
+
+static inline void thermistor_lut_build_modbed(thermistor_lut_t *lut)
+{
+	thermistor_lut_alloc(lut, THERMISTOR_LUT_MODBED_MIN, THERMISTOR_LUT_MODBED_MAX);
+	for (uint32_t i=0; i<lut->count; i++)
+	{
+		lut->adc[i] = thermistor_lut_modbed(thermistor_lut_temp(lut, i));
+	}
+}
+
+// Nearest 0.1C entry. Returns false if the temperature is outside the LUT,
+// the caller decides whether that clamps or needs the direct calculation.
+static inline bool thermistor_lut_lookup(const thermistor_lut_t *lut, float value, int32_t *adc)
+{
+	if (lut->adc == NULL || !(value >= lut->min_temp && value <= lut->max_temp))
+	{
+		return false;
+	}
+	*adc = lut->adc[(uint32_t)(((value - lut->min_temp) * THERMISTOR_LUT_STEPS_PER_C) + 0.5f)];
+	return true;
+}
+
+#endif // THERMISTOR_LUT_H
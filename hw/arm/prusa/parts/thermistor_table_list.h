@@ -0,0 +1,57 @@
+/*
+	thermistor_table_list.h - The thermistor tables a thermistor's "table_index"
+	property can select, shared by the device and its unit test.
+
+    Written for Mini404 in 2023 by VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THERMISTOR_TABLE_LIST_H
+#define THERMISTOR_TABLE_LIST_H
+
+#include "qemu/osdep.h"
+#include "thermistortables.h"
+
+typedef struct {
+	uint16_t index;
+	const short *table;
+	int length; // In shorts, i.e. 2x the number of {adc, temp} entries.
+} thermistor_table_def_t;
+
+static const thermistor_table_def_t thermistor_tables[] = {
+	{1, &temptable_1[0][0], 2*BEDTEMPTABLE_LEN},
+	{5, &temptable_5[0][0], 2*HEATER_0_TEMPTABLE_LEN},
+	{2000, &temptable_2000[0][0], 2*AMBIENTTEMPTABLE_LEN},
+	{2004, &temptable_2004[0][0], 17*2},
+	{2005, &temptable_2005[0][0], 22*2},
+	{21, &temptable_21[0][0], 6},
+	{22, &temptable_22[0][0], 4},
+	{2006, &temptable_2006[0][0], 2U*127},
+	{2007, &temptable_2007[0][0], 2U*291},
+	{2008, &temptable_2008[0][0], 2U*205},
+};
+
+static inline const thermistor_table_def_t *thermistor_table_find(uint16_t index)
+{
+	for (int i=0; i<ARRAY_SIZE(thermistor_tables); i++)
+	{
+		if (thermistor_tables[i].index == index)
+		{
+			return &thermistor_tables[i];
+		}
+	}
+	return NULL;
+}
+
+#endif // THERMISTOR_TABLE_LIST_H
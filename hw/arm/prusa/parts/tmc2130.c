@@ -29,23 +29,11 @@
 #include "../utility/p404_motor_if.h"
 #include "../utility/p404scriptable.h"
 #include "../utility/ScriptHost_C.h"
+#include "../trace.h"
+#include "../utility/p404_stats.h"
+#include "../utility/p404_timer_stats.h"
 #include <math.h>
 
-//#define DEBUG_TMC2130 1
-
-#ifdef DEBUG_TMC2130
-#define DPRINTF(fmt, ...) \
-do { printf("tmc2130: " fmt , ## __VA_ARGS__); } while (0)
-#define BADF(fmt, ...) \
-do { \
-    fprintf(stderr, "tmc2130: error: " fmt , ## __VA_ARGS__); abort(); \
-} while (0)
-#else
-#define DPRINTF(fmt, ...) do {} while(0)
-#define BADF(fmt, ...) \
-do { fprintf(stderr, "tmc2130: error: " fmt , ## __VA_ARGS__);} while (0)
-#endif
-
 // the internal programming registers.
 typedef union
 {
@@ -179,11 +167,17 @@ typedef struct tmc2130_state {
 	qemu_irq peek; // Needed for SWSPI to "peek" at next byte.
 
     QEMUTimer *standstill;
+    int64_t last_step_ns; // Standstill is derived from this lazily.
 
 	p404_motorif_status_t vis;
+	p404_motor_watchlist_t watches;
 
 } tmc2130_state;
 
+// 2^20 comes from the datasheet.
+// Internal clock is 12 MHz, 2^20 cycles is ~87 msec.
+#define TMC2130_STANDSTILL_NS (87 * SCALE_MS)
+
 enum {
     ActGetPosFloat,
     ActWaitUntilInsideZoneMM,
@@ -198,7 +192,7 @@ OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(tmc2130_state, tmc2130, TMC2130, SSI_P
 
 static void tmc2130_check_raise_diag(tmc2130_state *s, int32_t value){
     bool bDiag = s->regs.defs.GCONF.diag0_stall || s->regs.defs.GCONF.diag1_stall;
-    //printf("%c Diag: %01x SG %d PP %01x %01x \n",m_cAxis.load(), bDiag, s->regs.defs.DRV_STATUS.stallGuard, s->regs.defs.GCONF.diag0_int_pushpull, value );
+    trace_tmc2130_diag(s->id, bDiag, s->regs.defs.DRV_STATUS.stallGuard, s->regs.defs.GCONF.diag0_int_pushpull, value);
     if (bDiag)
 	{
 		bool output = value == s->regs.defs.GCONF.diag0_int_pushpull;
@@ -211,6 +205,42 @@ static void tmc2130_check_raise_diag(tmc2130_state *s, int32_t value){
 	}
 }
 
+// True if entering standstill would change the DIAG output, i.e. something
+// outside a register read could observe it.
+static bool tmc2130_diag_clear_pending(tmc2130_state *s)
+{
+    bool bDiag = s->regs.defs.GCONF.diag0_stall || s->regs.defs.GCONF.diag1_stall;
+    return bDiag && ((0 == s->regs.defs.GCONF.diag0_int_pushpull) ^ s->diag_state);
+}
+
+// Applies standstill (STST set, DIAG cleared, SG_RESULT reset) if the motor
+// has not stepped for long enough. Returns false if it is still moving.
+static bool tmc2130_update_standstill(tmc2130_state *s)
+{
+    if (s->regs.defs.DRV_STATUS.stst)
+    {
+        return true;
+    }
+    if (qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) - s->last_step_ns < TMC2130_STANDSTILL_NS)
+    {
+        return false;
+    }
+    s->regs.defs.DRV_STATUS.stst = 1;
+    tmc2130_check_raise_diag(s, 0);
+    s->regs.defs.DRV_STATUS.SG_RESULT = 0;
+    return true;
+}
+
+// Only arms the standstill timer if the transition is visible on DIAG,
+// everything else is evaluated when the registers are read.
+static void tmc2130_arm_standstill(tmc2130_state *s)
+{
+    if (!s->regs.defs.DRV_STATUS.stst && tmc2130_diag_clear_pending(s) && !timer_pending(s->standstill))
+    {
+        timer_mod_ns(s->standstill, s->last_step_ns + TMC2130_STANDSTILL_NS);
+    }
+}
+
 // External stall helper for corexy...
 static void tmc2130_ext_stall(void *opaque, int n, int level) {
     tmc2130_state *s = opaque;
@@ -265,11 +295,13 @@ static int tmc2130_process_action(P404ScriptIF *obj, unsigned int action, script
 				s->stalled^=true;
         		s->regs.defs.DRV_STATUS.SG_RESULT = s->stalled? 0 : 250;
 				tmc2130_check_raise_diag(s, s->stalled);
+				tmc2130_arm_standstill(s);
 			break;
 		case ActSetStall:
 				s->stalled=scripthost_get_bool(args, 0);
         		s->regs.defs.DRV_STATUS.SG_RESULT = s->stalled? 0 : 250;
 				tmc2130_check_raise_diag(s, s->stalled);
+				tmc2130_arm_standstill(s);
 			break;
         default:
             return ScriptLS_Unhandled;
@@ -278,13 +310,14 @@ static int tmc2130_process_action(P404ScriptIF *obj, unsigned int action, script
     return ScriptLS_Finished;
 }
 
-// Fired on standstill. set the STST flag and clear DIAG
+// Fired when a DIAG-visible standstill may be due. Steps since arming push it out.
 static void tmc2130_standstill_timer(void *opaque)
 {
     tmc2130_state *s = opaque;
-    s->regs.defs.DRV_STATUS.stst = 1;
-    tmc2130_check_raise_diag(s, 0);
-    s->regs.defs.DRV_STATUS.SG_RESULT = 0;
+    if (!tmc2130_update_standstill(s))
+    {
+        timer_mod_ns(s->standstill, s->last_step_ns + TMC2130_STANDSTILL_NS);
+    }
 }
 
 static void tmc2130_step(void *opaque, int n, int value) {
@@ -330,6 +363,7 @@ static void tmc2130_step(void *opaque, int n, int value) {
     s->vis.status.changed |= true;
     qemu_set_irq(s->position_out, s->current_step);
     qemu_set_irq(s->um_out, s->current_position*1000.f);
+    p404_motor_watch_update(&s->watches, s->current_step, s->current_position*1000.f);
 	// The above may call out and cascade which alters the ext_stall flag
 	bStall |= s->stalled  || s->ext_stall;
 	s->vis.status.stalled = bStall;
@@ -349,10 +383,8 @@ static void tmc2130_step(void *opaque, int n, int value) {
         s->regs.defs.DRV_STATUS.SG_RESULT  = 250;
     }
     s->regs.defs.DRV_STATUS.stst = false;
-    // 2^20 comes from the datasheet.
-
-    // Internal clock is 12 MHz, 2^20 cycles is ~87 msec.
-    timer_mod(s->standstill, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+87);
+    s->last_step_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    tmc2130_arm_standstill(s);
 }
 
 static void tmc2130_dir(void *opaque, int n, int level) {
@@ -361,6 +393,7 @@ static void tmc2130_dir(void *opaque, int n, int level) {
 }
 
 static void tmc2130_create_reply(tmc2130_state *s) {
+    tmc2130_update_standstill(s); // Bring STST/SG_RESULT up to date before they are reported.
     s->cmd_out.all = 0x00; // Copy over.
     if (s->cmd_proc.bitsIn.RW == 0) // Last in was a read.
     {
@@ -369,7 +402,7 @@ static void tmc2130_create_reply(tmc2130_state *s) {
 		{
             s->regs.raw[0x01] = 0; // GSTAT is cleared after read.
 		}
-        // TRACE(printf("Reading out %02x (%10lx)\n", s->cmd_proc.bitsIn.address, s->cmd_out.bitsOut.data));
+        trace_tmc2130_read(s->id, s->cmd_proc.bitsIn.address, s->cmd_out.bitsOut.data);
     }
     else
 	{
@@ -382,19 +415,18 @@ static void tmc2130_create_reply(tmc2130_state *s) {
     s->cmd_out.bitsOut.reset_flag = s->regs.defs.GSTAT.reset;
     s->cmd_out.bitsOut.sg2 = s->regs.defs.DRV_STATUS.stallGuard;
     s->cmd_out.bitsOut.standstill = s->regs.defs.DRV_STATUS.stst;
-    //(printf("Reply built: %10lx\n",m_cmdOut.all));
 }
 
 static void tmc2130_process_cmd(tmc2130_state *s) {
-    // TRACE(printf("tmc2130 %c cmd: w: %x a: %02x  d: %08lx\n",m_cAxis.load(), m_cmdProc.bitsIn.RW, m_cmdProc.bitsIn.address, m_cmdProc.bitsIn.data));
+    trace_tmc2130_cmd(s->id, s->cmd_proc.bitsIn.RW, s->cmd_proc.bitsIn.address, s->cmd_proc.bitsIn.data);
     if (s->cmd_proc.bitsIn.RW)
     {
         s->regs.raw[s->cmd_proc.bitsIn.address] = s->cmd_proc.bitsIn.data;
-        //printf("REG %c %02x set to: %010x\n", m_cAxis, m_cmdIn.bitsIn.address, m_cmdIn.bitsIn.data);
 		switch (s->cmd_proc.bitsIn.address)
 		{
 			case 0x00: // GCONF
 				tmc2130_check_raise_diag(s, s->regs.defs.DRV_STATUS.stallGuard); // Adjust DIAG out, it mayhave  been reconfigured.
+				tmc2130_arm_standstill(s);
 				s->stealthmode = s->regs.defs.GCONF.en_pwm_mode;
 				break;
 			case 0x6C: // Chopconf
@@ -402,10 +434,6 @@ static void tmc2130_process_cmd(tmc2130_state *s) {
 				break;
 		}
     }
-    else
-    {
-        // TRACE(printf("Read command on register: %02x\n", s->cmd_proc.bitsIn.address));
-    }
     tmc2130_create_reply(s);
 }
 
@@ -415,20 +443,19 @@ static uint32_t tmc2130_transfer(SSIPeripheral *dev, uint32_t data)
 
     s->cmd_in.all<<=8; // Shift bits up
     s->cmd_in.bytes[0] = data & 0xFFU;
-    //TRACE(printf("TMC2130 %c: byte received: %02x (%010lx)\n",m_cAxis.load(),value, m_cmdIn.all));
     // Clock out a reply byte, MSB first
     uint8_t byte = s->cmd_out.bytes[4];
     s->cmd_out.all<<=8;
 	qemu_set_irq(s->peek, s->cmd_out.bytes[4]); // notify next byte.
-    //TRACE(printf("TMC2130 %c: Clocking (%10lx) out %02x\n",m_cAxis.load(),m_cmdOut.all,byte));
+    trace_tmc2130_transfer(s->id, data, byte);
     return byte; // SPIPeripheral takes care of the reply.
 }
 
 static int tmc2130_cs_changed(SSIPeripheral *dev, bool select) {
-    // TRACE(printf("TMC2130 %c: CSEL changed to %02x\n",m_cAxis.load(),value));
+    tmc2130_state *s = TMC2130(dev);
+    trace_tmc2130_cs(s->id, select);
     if (select) // Just finished a CSEL
     {
-        tmc2130_state *s = TMC2130(dev);
         s->cmd_proc = s->cmd_in;
         tmc2130_process_cmd(s);
     }
@@ -441,6 +468,12 @@ static const p404_motorif_status_t* tmc2130_get_status(P404MotorIF* p)
     return &s->vis;
 }
 
+static p404_motor_watchlist_t* tmc2130_get_watchlist(P404MotorIF* p)
+{
+    tmc2130_state *s = TMC2130(p);
+    return &s->watches;
+}
+
 static void tmc2130_finalize(Object *obj){
 }
 
@@ -462,6 +495,8 @@ static void tmc2130_realize(SSIPeripheral *obj, Error **errp){
 	s->vis.label = s->id;
     s->vis.max_pos = (float)s->max_step/(float)s->max_steps_per_mm;
     s->vis.status.changed = true;
+    s->current_position = tmc2130_step_to_pos(s->current_step, s->max_steps_per_mm);
+    p404_motor_watch_update(&s->watches, s->current_step, s->current_position*1000.f);
 }
 
 static void tmc2130_init(Object *obj){
@@ -487,12 +522,15 @@ static void tmc2130_init(Object *obj){
     qdev_init_gpio_out_named(DEVICE(obj),&s->position_out, "step-out", 1);
     qdev_init_gpio_out_named(DEVICE(obj),&s->um_out, "um-out", 1);
     qdev_init_gpio_out_named(DEVICE(obj),&s->peek, "spi-peek", 1);
+    p404_stats_count_gpio_out(obj);
     // qemu_set_irq(s->irq_diag,0);
 	tmc2130_check_raise_diag(s, 0);
     qemu_set_irq(s->hard_out,0);
 
+    p404_motor_watch_init(&s->watches);
+
     s->standstill =
-        timer_new_ms(QEMU_CLOCK_VIRTUAL,
+        p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "standstill",
             (QEMUTimerCB *)tmc2130_standstill_timer, s);
 
 }
@@ -516,7 +554,7 @@ static int tmc2130_post_load(void *opaque, int version_id)
 
 static const VMStateDescription vmstate_tmc2130 = {
     .name = TYPE_TMC2130,
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
     .post_load = tmc2130_post_load,
     .fields      = (VMStateField []) {
@@ -537,6 +575,7 @@ static const VMStateDescription vmstate_tmc2130 = {
         VMSTATE_UINT16(ms_increment,tmc2130_state),
         VMSTATE_UINT32(max_steps_per_mm,tmc2130_state),
         VMSTATE_TIMER_PTR(standstill,tmc2130_state),
+        VMSTATE_INT64_V(last_step_ns,tmc2130_state, 2),
         VMSTATE_END_OF_LIST(),
     }
 };
@@ -558,4 +597,5 @@ static void tmc2130_class_init(ObjectClass *klass, void *data)
 
 	P404MotorIFClass *mc = P404_MOTOR_IF_CLASS(klass);
     mc->get_current_status = tmc2130_get_status;
+    mc->get_watchlist = tmc2130_get_watchlist;
 }
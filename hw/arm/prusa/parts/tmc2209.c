@@ -30,6 +30,8 @@
 #include "../utility/p404scriptable.h"
 #include "../utility/p404_motor_if.h"
 #include "../utility/ScriptHost_C.h"
+#include "../utility/p404_stats.h"
+#include "../utility/p404_timer_stats.h"
 
 //#define DEBUG_TMC2209 1
 
@@ -171,13 +173,20 @@ typedef struct tmc2209_state {
 
 
     p404_motorif_status_t vis;
+    p404_motor_watchlist_t watches;
 
     QEMUTimer *standstill;
+    int64_t last_step_ns; // Standstill is derived from this lazily.
+    bool diag_state;
 
 	script_handle handle;
 
 } tmc2209_state;
 
+// 2^20 comes from the datasheet.
+// Internal clock is 12 MHz, 2^20 cycles is ~87 msec.
+#define TMC2209_STANDSTILL_NS (87 * SCALE_MS)
+
 enum {
     ActGetPosFloat
 };
@@ -210,6 +219,7 @@ static void tmc2209_enable(void *opaque, int n, int level) {
     if (level==1)
     {
         qemu_set_irq(s->irq_diag,0); // EN H clears diag.
+        s->diag_state = false;
     }
 }
 
@@ -248,13 +258,36 @@ static int tmc2209_process_action(P404ScriptIF *obj, unsigned int action, script
     return ScriptLS_Finished;
 }
 
-// Fired on standstill. set the STST flag and clear DIAG
-static void tmc2209_standstill_timer(void *opaque)
+// Applies standstill (STST set, DIAG cleared, SG_RESULT reset) if the motor
+// has not stepped for long enough. Returns false if it is still moving.
+static bool tmc2209_update_standstill(tmc2209_state *s)
 {
-    tmc2209_state *s = opaque;
+    if (s->regs.defs.DRV_STATUS.stst)
+    {
+        return true;
+    }
+    if (qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) - s->last_step_ns < TMC2209_STANDSTILL_NS)
+    {
+        return false;
+    }
     s->regs.defs.DRV_STATUS.stst = 1;
-    qemu_set_irq(s->irq_diag,0);
+    if (s->diag_state)
+    {
+        qemu_set_irq(s->irq_diag,0);
+        s->diag_state = false;
+    }
     s->regs.defs.SG_RESULT.sg_result = 0;
+    return true;
+}
+
+// Fired when a DIAG-visible standstill may be due. Steps since arming push it out.
+static void tmc2209_standstill_timer(void *opaque)
+{
+    tmc2209_state *s = opaque;
+    if (!tmc2209_update_standstill(s))
+    {
+        timer_mod_ns(s->standstill, s->last_step_ns + TMC2209_STANDSTILL_NS);
+    }
 }
 
 static void tmc2209_step(void *opaque, int n, int value) {
@@ -300,6 +333,7 @@ static void tmc2209_step(void *opaque, int n, int value) {
     s->vis.status.changed |= true;
     qemu_set_irq(s->position_out, s->current_step);
     qemu_set_irq(s->um_out, s->current_position*1000.f);
+    p404_motor_watch_update(&s->watches, s->current_step, s->current_position*1000.f);
 	bStall |= s->stalled;
     s->vis.status.stalled = bStall;
     s->vis.status.changed |= true;
@@ -308,20 +342,24 @@ static void tmc2209_step(void *opaque, int n, int value) {
         if (s->current_step==0) qemu_set_irq(s->hard_out,1);
 		qemu_set_irq(s->stall_indicator,1);
         qemu_set_irq(s->irq_diag,1);
+        s->diag_state = true;
         s->regs.defs.SG_RESULT.sg_result = 0;
     }
     else if (!bStall)
     {
             qemu_set_irq(s->hard_out,0);
             qemu_set_irq(s->irq_diag,0);
+            s->diag_state = false;
 			qemu_set_irq(s->stall_indicator,0);
           s->regs.defs.SG_RESULT.sg_result = 250;
     }
     s->regs.defs.DRV_STATUS.stst = false;
-    // 2^20 comes from the datasheet.
-
-    // Internal clock is 12 MHz, 2^20 cycles is ~87 msec.
-    timer_mod(s->standstill, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+87);
+    s->last_step_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+    // Only DIAG is visible without a register read, so the timer is only needed while it's asserted.
+    if (s->diag_state && !timer_pending(s->standstill))
+    {
+        timer_mod_ns(s->standstill, s->last_step_ns + TMC2209_STANDSTILL_NS);
+    }
 }
 
 static void tmc2209_dir(void *opaque, int n, int level) {
@@ -346,6 +384,7 @@ static void tmc2209_write(tmc2209_state *s)
 static void tmc2209_read(tmc2209_state *s)
 {
     // TODO, actually construct reply.
+    tmc2209_update_standstill(s); // Bring STST/SG_RESULT up to date before they are reported.
     uint32_t data = s->regs.raw[s->rx_buffer[2]];
     uint8_t reply[8] = {0x05, 0xFF, s->rx_buffer[2],data>>24,data>>16,data>>8,data,0x00};
     reply[7] = tmc2209_calcCRC(reply,7);
@@ -382,6 +421,8 @@ static void tmc2209_realize(DeviceState *obj, Error **errp){
     s->vis.label = s->id;
     s->vis.max_pos = (float)s->max_step/(float)s->max_steps_per_mm;
     s->vis.status.changed = true;
+    s->current_position = tmc2209_step_to_pos(s->current_step, s->max_steps_per_mm);
+    p404_motor_watch_update(&s->watches, s->current_step, s->current_position*1000.f);
 }
 
 static void tmc2209_init(Object *obj){
@@ -417,11 +458,14 @@ static void tmc2209_init(Object *obj){
     qdev_init_gpio_out_named(DEVICE(obj),&s->position_out, "step-out", 1);
     qdev_init_gpio_out_named(DEVICE(obj),&s->um_out, "um-out", 1);
 	qdev_init_gpio_out_named(DEVICE(obj),&s->stall_indicator, "stall-indicator", 1);
+	p404_stats_count_gpio_out(obj);
     qemu_set_irq(s->irq_diag,0);
     qemu_set_irq(s->hard_out,0);
 
+    p404_motor_watch_init(&s->watches);
+
     s->standstill =
-        timer_new_ms(QEMU_CLOCK_VIRTUAL,
+        p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "standstill",
             (QEMUTimerCB *)tmc2209_standstill_timer, s);
 
 }
@@ -444,6 +488,12 @@ static const p404_motorif_status_t* tmc2209_get_status(P404MotorIF* p)
     return &s->vis;
 }
 
+static p404_motor_watchlist_t* tmc2209_get_watchlist(P404MotorIF* p)
+{
+    tmc2209_state *s = TMC2209(p);
+    return &s->watches;
+}
+
 static int tmc2209_post_load(void *opaque, int version_id)
 {
     tmc2209_state *s = TMC2209(opaque);
@@ -458,7 +508,7 @@ static int tmc2209_post_load(void *opaque, int version_id)
 
 static const VMStateDescription vmstate_tmc2209 = {
     .name = TYPE_TMC2209,
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
     .post_load = tmc2209_post_load,
     .fields      = (VMStateField []) {
@@ -477,6 +527,8 @@ static const VMStateDescription vmstate_tmc2209 = {
         VMSTATE_UINT16(ms_increment,tmc2209_state),
         VMSTATE_UINT32(max_steps_per_mm,tmc2209_state),
         VMSTATE_TIMER_PTR(standstill,tmc2209_state),
+        VMSTATE_INT64_V(last_step_ns,tmc2209_state, 2),
+        VMSTATE_BOOL_V(diag_state,tmc2209_state, 2),
         VMSTATE_END_OF_LIST(),
     }
 };
@@ -493,4 +545,5 @@ static void tmc2209_class_init(ObjectClass *klass, void *data)
     P404MotorIFClass *mc = P404_MOTOR_IF_CLASS(klass);
 
     mc->get_current_status = tmc2209_get_status;
+    mc->get_watchlist = tmc2209_get_watchlist;
 }
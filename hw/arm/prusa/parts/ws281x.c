@@ -2,7 +2,8 @@
 	ws281x.c
 
     GPIO implementation for WS281x neopixel LEDs.
-	Requires icount auto to work to get correct bit-bang timings.
+	Bits are decoded from the ratio of high time to bit period, so the
+	bit-bang timing does not need to be accurate in absolute terms.
 
     Written for Mini404 in 2022-3 by VintagePC <https://github.com/vintagepc/>
 
@@ -29,8 +30,9 @@
 #include "qemu/timer.h"
 #include "qom/object.h"
 #include "hw/sysbus.h"
-#include "sysemu/cpu-timers.h"
 #include "../utility/macros.h"
+#include "../utility/p404_edge_timing.h"
+#include "../utility/p404_stats.h"
 
 typedef union {
     uint32_t raw;
@@ -57,13 +59,15 @@ struct WS281xState {
 
     uint8_t bit_count;
 
-	int64_t last_highc, last_lowc;
+	int64_t last_rise, last_fall;
+	int64_t period_sum; // Rising-to-rising edge times of the bits in the current word.
+	int64_t period; // Average bit period of the last complete word, 0 if unknown.
+	bool bit_pending; // High phase seen, waiting on the next rising edge for the period.
 
     colour_t current_colour;
     colour_t set_colour;
 
     bool passthrough;
-	bool disabled;
     qemu_irq dout;
     qemu_irq reset;
     qemu_irq colour;
@@ -96,52 +100,80 @@ static void ws281x_reset(void* opaque, int n, int level) {
     // printf("RESET\n");
     s->passthrough = false;
     s->bit_count = 0;
+    s->period_sum = 0;
+    s->bit_pending = false;
     s->current_colour.raw = 0;
     qemu_set_irq(s->reset,0);
 }
 
-static void ws281x_gpio(void* opaque, int n, int level)
+// Shift in one bit: a 1 has a high phase of roughly 2/3 of the bit period, a 0 of 1/3.
+static void ws281x_shift_bit(WS281xState *s, int64_t high, int64_t period)
 {
-    WS281xState *s = WS281X(opaque);
-	if (s->disabled)
+	s->current_colour.raw <<= 1;
+	s->current_colour.raw |= (2 * high) > period;
+	s->bit_count++;
+	if (s->bit_count == 24)
 	{
-		return;
+		// Reached the RGB length.
+		// printf("data: %06x\n", s->current_colour.raw);
+		ws281x_din(s, 0, s->current_colour.raw);
+		s->period = s->period_sum / 23;
+		s->period_sum = 0;
+		s->bit_count = 0;
+		s->current_colour.raw = 0;
 	}
+}
+
+static void ws281x_gpio(void* opaque, int n, int level)
+{
+    WS281xState *s = WS281X(opaque);
+	int64_t now = p404_edge_now();
 	if (level)
 	{
-		s->last_highc = icount_get_raw();
-		if (s->last_highc - s->last_lowc >15000)
+		int64_t high = s->last_fall - s->last_rise;
+		int64_t period = now - s->last_rise;
+		s->last_rise = now;
+		// Latch/reset gap is >50us against a ~1.25us bit, so it is judged against the
+		// bit period and does not depend on how fast the guest runs. Until a period
+		// has been measured, the high phase before the gap stands in for it.
+		int64_t reference = s->bit_count ? s->period_sum / s->bit_count : s->period;
+		if (!reference)
+		{
+			reference = high;
+		}
+		if ((now - s->last_fall) > (16 * reference))
 		{
+			// printf("reset\n");
 			s->bit_count = 0;
+			s->period_sum = 0;
 			s->current_colour.raw = 0;
 			s->passthrough = false;
-			// printf("reset\n");
+			s->bit_pending = false;
+			return;
+		}
+		if (s->bit_pending)
+		{
+			s->bit_pending = false;
+			s->period_sum += period;
+			ws281x_shift_bit(s, high, period);
 		}
 	}
 	else
 	{
-		s->last_lowc = icount_get_raw();
-		if (s->last_lowc == 0)
+		s->last_fall = now;
+		if (s->bit_count == 23 && s->period_sum)
 		{
-			printf("ERR: WS281x detected '-icount ' is not set. LED will not function without accurate timing!\n");
-			s->disabled = true;
+			// The last bit of a word can be followed by the latch gap, so it is decided
+			// against the average period of this word rather than its own.
+			ws281x_shift_bit(s, now - s->last_rise, s->period_sum / 23);
+		}
+		else
+		{
+			s->bit_pending = true;
 		}
-		s->current_colour.raw <<= 1;
-		s->current_colour.raw |= (s->last_lowc - s->last_highc) > 22; // This value is highly dependent on the value of icount. Tested with -icount 2 gets ns values close to correct in real ns
-		// printf("last high: %d\n",(s->last_lowc - s->last_highc));
-		s->bit_count++;
-        if (s->bit_count == 24)
-        {
-            // Reached the RGB length.
-			// printf("data: %06x\n", s->current_colour.raw);
-            ws281x_din(opaque, 0,s->current_colour.raw);
-            s->bit_count = 0;
-			s->current_colour.raw = 0;
-        }
     }
 }
 
-
 static void ws281x_finalize(Object *obj)
 {
 }
@@ -159,10 +191,13 @@ static void ws281x_init(Object *obj)
     qdev_init_gpio_in_named(dev, ws281x_reset, "reset",1);
     qdev_init_gpio_out_named(dev, &s->reset, "reset-out", 1);
     qdev_init_gpio_out_named(dev, &s->colour, "colour", 1);
+    p404_stats_count_gpio_out(obj);
 
 }
 
 
 static void ws281x_class_init(ObjectClass *klass, void *data)
 {
+    DeviceClass *dc = DEVICE_CLASS(klass);
+    dc->user_creatable = true; // For qtest on the bare STM32 machines.
 }
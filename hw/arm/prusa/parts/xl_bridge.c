@@ -38,6 +38,8 @@
 #include "sysemu/runstate.h"
 #include "qapi/qapi-commands-run-state.h"
 #include "qapi/qapi-events-run-state.h"
+#include "../trace.h"
+#include "../utility/p404_stats.h"
 
 static const char* shm_names[XL_BRIDGE_COUNT] =
 {
@@ -103,10 +105,21 @@ struct XLBridgeState {
 		uint32_t u32;
 		int32_t i32;
 	} data_4b;
+
+	p404_stats_t *stats;
 };
 
 OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(XLBridgeState, xl_bridge, XLBRIDGE,SYS_BUS_DEVICE,{NULL});
 
+static void xl_bridge_chr_write(XLBridgeState *s, CharBackend *be, const uint8_t *buf, int len)
+{
+	int written = qemu_chr_fe_write_all(be, buf, len);
+	if (written > 0)
+	{
+		p404_stats_add(s->stats, P404_STAT_CHR_BYTES, written);
+	}
+}
+
 static void xl_bridge_tx_assert(void *opaque, int n, int level)
 {
 	XLBridgeState *s = XLBRIDGE(opaque);
@@ -115,11 +128,11 @@ static void xl_bridge_tx_assert(void *opaque, int n, int level)
 	{
 		s->buffer_level = 0;
 		s->de_pin_used[s->id] = true;
-		// printf("RS 485 TX high\n");
+		trace_xl_bridge_tx_start(shm_names[s->id]);
 	}
 	else // Transmit just finished. Pump it out over the socket...
 	{
-		// printf("RS 485 TX low\n");
+		trace_xl_bridge_tx_end(shm_names[s->id], s->buffer_level, s->buffer[0]);
 		// If we are the base XLBuddy, forward the data to all the downstream periphs.
 		// Due to RTO timing issues we "cheat" and inspect the traffic to see where it should go
 		// This prevents rapidfire messages from stomping on one still being received.
@@ -127,18 +140,18 @@ static void xl_bridge_tx_assert(void *opaque, int n, int level)
 		{
 			switch (s->buffer[0]) {
 				case 0x0A ... 0x10:	// Tool. Route appropriately.
-					qemu_chr_fe_write_all(&s->chr[XL_DEV_BED + (s->buffer[0] - 0x0A)],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
+					xl_bridge_chr_write(s, &s->chr[XL_DEV_BED + (s->buffer[0] - 0x0A)],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
 					break;
 				case 0x1A ... 0x20:	// Tool. Route appropriately.
-					qemu_chr_fe_write_all(&s->chr[XL_DEV_BED + (s->buffer[0] - 0x1A)],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
+					xl_bridge_chr_write(s, &s->chr[XL_DEV_BED + (s->buffer[0] - 0x1A)],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
 					break;
 				default: // catch-all.
-					printf("Unexpected message starting byte, %02x\n",s->buffer[0]);
+					trace_xl_bridge_tx_unexpected(s->buffer[0]);
 					/* FALLTHRU */
 				case 0x00: // Broadcast message (e.g. bootstrap)
 					for (int i=XL_DEV_XBUDDY+1; i<XL_BRIDGE_COUNT; i++)
 					{
-						qemu_chr_fe_write_all(&s->chr[i],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
+						xl_bridge_chr_write(s, &s->chr[i],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
 					}
 					break;
 			}
@@ -146,15 +159,9 @@ static void xl_bridge_tx_assert(void *opaque, int n, int level)
 		else
 		{
 			// Just a single transmit, from downstream to base.
-			qemu_chr_fe_write_all(&s->chr[s->id],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
+			xl_bridge_chr_write(s, &s->chr[s->id],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
 
 		}
-		//printf("%s: sent %u bytes to %d\n",shm_names[s->id], s->buffer_level, s->buffer[0]);
-		// for (int i=0; i<s->buffer_level; i++)
-		// {
-		// 	printf("%02x ",s->buffer[i]);
-		// }
-		// printf("\n");
 	}
 }
 
@@ -174,11 +181,10 @@ static void xl_bridge_byte_send(void *opaque, int n, int level)
 			uint8_t len = s->buffer[2] + 5;
 			if (s->buffer_level == len)
 			{
-				qemu_chr_fe_write_all(&s->chr[s->id],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
-				//printf("XL Puppy: sent %u bytes\n",s->buffer_level);
+				xl_bridge_chr_write(s, &s->chr[s->id],(uint8_t*)s->buffer, sizeof(s->buffer[0]) * s->buffer_level);
+				trace_xl_bridge_puppy_tx(shm_names[s->id], s->buffer_level);
 				s->buffer_level = 0;
 			}
-			//printf("p sz: %u l: %u\n", s->buffer[2], s->buffer_level);
 		}
 	}
 }
@@ -187,9 +193,10 @@ static void xl_bridge_byte_send(void *opaque, int n, int level)
 static int xl_bridge_can_receive(void *opaque)
 {
    	XLBridgeState *s = XLBRIDGE(opaque);
-	// if (s->de_pin_asserted[s->id]){
-	// 	printf("recieve blocked by DE assert\n");
-	// }
+	if (s->de_pin_asserted[s->id])
+	{
+		trace_xl_bridge_rx_blocked(shm_names[s->id]);
+	}
     return s->de_pin_asserted[s->id]? 0 : 64;
 }
 
@@ -201,16 +208,13 @@ static int xl_bridge_gpio_can_receive(void *opaque)
 static void xl_bridge_receive(void *opaque, const uint8_t *buf, int size)
 {
    	XLBridgeState *s = XLBRIDGE(opaque);
-	//#define FILTER size < 20 && s->id == XL_DEV_XBUDDY
-	#define FILTER false
     // assert(size % 2 == 0);
-	if (FILTER) printf(" %u Received: ", s->id);
+	trace_xl_bridge_rx(shm_names[s->id], size);
+	p404_stats_add(s->stats, P404_STAT_CHR_BYTES, size);
 	for (const uint8_t* p = buf; p<buf+size; p++)
 	{
 		qemu_set_irq(s->byte_receive, *p);
-		if (FILTER) printf("%02x ",*p);
 	}
-	if (FILTER) printf("\n");
 }
 
 #define PROCESS_BIT(pin, field) \
@@ -223,6 +227,7 @@ static void xl_bridge_gpio_receive(void *opaque, const uint8_t *buf, int size)
 {
    	XLBridgeState *s = XLBRIDGE(opaque);
 	assert(size==1);
+	p404_stats_inc(s->stats, P404_STAT_CHR_BYTES);
 
 	gpio_state_t state = {.byte  = buf[0]};
 	bool data_done = false;
@@ -238,7 +243,7 @@ static void xl_bridge_gpio_receive(void *opaque, const uint8_t *buf, int size)
 		data_done = true;
 		state = s->gpio_states[s->id]; // restore the state so we retrigger as "complete."
 	}
-	// printf("GPIO receive: %u - %02x\n", s->id, buf[0]);
+	trace_xl_bridge_gpio_rx(shm_names[s->id], buf[0]);
 
 	if (s->id != XL_DEV_XBUDDY)
 	{
@@ -246,7 +251,7 @@ static void xl_bridge_gpio_receive(void *opaque, const uint8_t *buf, int size)
 		{
 			if (data_done)
 			{
-				// printf("z value received: %d %08x\n", s->data_4b.i32, s->data_4b.i32);
+				trace_xl_bridge_gpio_rx_z(shm_names[s->id], s->data_4b.i32);
 				qemu_set_irq(s->gpio_out[XLBRIDGE_PIN_Z_UM], s->data_4b.i32);
 				s->data_4b.u32 = 0;
 			}
@@ -276,13 +281,13 @@ static void xl_bridge_reset_in(void *opaque, int n, int level)
 	XLBridgeState *s = XLBRIDGE(opaque);
 	if (s->id != XL_DEV_XBUDDY)
 	{
-		printf("Got GPIO inputs on client peripheral board %s - ignored.\n",shm_names[s->id]);
+		trace_xl_bridge_gpio_ignored(shm_names[s->id]);
 		return;
 	}
 	s->gpio_states[n].bits.reset = level>0;
 	// Dispatch the new state.
-	qemu_chr_fe_write_all(&s->gpio[n],&s->gpio_states[n].byte, 1);
-	// if (level) printf("Sent reset to %02x, %02x\n", n, s->gpio_states[n].byte);//, shm_names[target]);
+	xl_bridge_chr_write(s, &s->gpio[n],&s->gpio_states[n].byte, 1);
+	trace_xl_bridge_reset_tx(n, s->gpio_states[n].byte);
 }
 
 static void xl_bridge_gpio_in(void *opaque, int n, int level)
@@ -290,7 +295,7 @@ static void xl_bridge_gpio_in(void *opaque, int n, int level)
 	XLBridgeState *s = XLBRIDGE(opaque);
 	if (s->id != XL_DEV_XBUDDY)
 	{
-		printf("Got GPIO inputs on client peripheral board %s - ignored.\n",shm_names[s->id]);
+		trace_xl_bridge_gpio_ignored(shm_names[s->id]);
 		return;
 	}
 	uint8_t target = 0; //n/XLBRIDGE_PIN_COUNT;
@@ -314,9 +319,9 @@ static void xl_bridge_gpio_in(void *opaque, int n, int level)
 			s->gpio_states[target].bits.z_um = 1;
 			for (int i=XL_DEV_T0; i<XL_BRIDGE_COUNT; i++)
 			{
-				qemu_chr_fe_write_all(&s->gpio[i], &s->gpio_states[target].byte, 1);
-				qemu_chr_fe_write_all(&s->gpio[i], (uint8_t*)&level, 4);
-				// printf("Sent zpos %d 0x%08x\n", level, level);
+				xl_bridge_chr_write(s, &s->gpio[i], &s->gpio_states[target].byte, 1);
+				xl_bridge_chr_write(s, &s->gpio[i], (uint8_t*)&level, 4);
+				trace_xl_bridge_gpio_tx_z(level);
 				return;
 			}
 			break;
@@ -326,9 +331,9 @@ static void xl_bridge_gpio_in(void *opaque, int n, int level)
 	// Dispatch the new state.
 	for (int i=0; i<XL_BRIDGE_COUNT; i++)
 	{
-		qemu_chr_fe_write_all(&s->gpio[i],&s->gpio_states[target].byte, 1);
+		xl_bridge_chr_write(s, &s->gpio[i],&s->gpio_states[target].byte, 1);
 	}
-	printf("Sent gpio update %02x\n", s->gpio_states[target].byte);//, shm_names[target]);
+	trace_xl_bridge_gpio_tx(s->gpio_states[target].byte);
 }
 
 static void xl_bridge_finalize(Object *obj)
@@ -456,6 +461,8 @@ static void xl_bridge_init(Object *obj)
 	qdev_init_gpio_in_named(dev, xl_bridge_gpio_in, "gpio-in",XLBRIDGE_PIN_COUNT);
 	qdev_init_gpio_in_named(dev, xl_bridge_reset_in, "reset-in", XL_BRIDGE_COUNT);
 	qdev_init_gpio_out_named(dev, s->gpio_out, "gpio-out",XLBRIDGE_PIN_COUNT);
+	p404_stats_count_gpio_out(obj);
+	s->stats = p404_stats_get(obj);
 
 
 }
@@ -33,6 +33,17 @@
 #include "hw/ssi/ssi.h"
 #include "hw/loader.h"
 #include "utility/ArgHelper.h"
+#include "utility/p404_elf_syms.h"
+#include "utility/p404_turbo_idle.h"
+#include "utility/p404_hle.h"
+#include "utility/p404_cycle_model.h"
+#include "utility/p404_logic_analyzer.h"
+#include "utility/p404_regprof.h"
+#include "utility/p404_rtos_trace.h"
+#include "utility/p404_sampler.h"
+#include "utility/p404_telemetry.h"
+#include "utility/p404_bench.h"
+#include "utility/p404_print_report.h"
 #include "sysemu/runstate.h"
 #include "parts/dashboard_types.h"
 #include "stm32_common/stm32_shared.h"
@@ -133,6 +144,18 @@ static void prusa_mini_init(MachineState *machine, const mini_config_t* cfg)
                             default_flash_size);
         }
     }
+    // Pick up firmware symbols (ELF only) for the idle/debug helpers.
+    p404_elf_load_symbols(machine->kernel_filename);
+    p404_turbo_idle_setup();
+    p404_hle_setup();
+    p404_cycle_model_setup();
+    p404_la_setup();
+    p404_regprof_setup();
+    p404_sampler_setup();
+    p404_rtos_trace_setup();
+    p404_telemetry_setup();
+    p404_bench_setup();
+    p404_print_report_setup();
 
     DeviceState* key_in = qdev_new("p404-key-input");
     sysbus_realize(SYS_BUS_DEVICE(key_in), &error_fatal);
@@ -190,14 +213,16 @@ static void prusa_mini_init(MachineState *machine, const mini_config_t* cfg)
         qdev_realize(dev, bus, &error_fatal);
     }
 
-    DeviceState* pinda = qdev_new("pinda");
-    sysbus_realize(SYS_BUS_DEVICE(pinda), &error_fatal);
+    DeviceState* pinda = qdev_new("pinda"); // Realized once the motors it watches exist.
 
     // DeviceState *vis = qdev_new("mini-visuals");
     // sysbus_realize(SYS_BUS_DEVICE(vis), &error_fatal);
+    bool headless = p404_bench_headless();
 #ifdef BUDDY_HAS_GL
     DeviceState *gl_db = qdev_new("gl-dashboard");
-    if (arghelper_is_arg("gfx-full")) {
+    if (headless) {
+        // No dashboard_type, so it is still wired up but never started.
+    } else if (arghelper_is_arg("gfx-full")) {
         qdev_prop_set_uint8(gl_db, "dashboard_type", DB_MINI_FULL);
     } else if (arghelper_is_arg("gfx-lite")) {
         qdev_prop_set_uint8(gl_db, "dashboard_type", DB_MINI_LITE);
@@ -211,6 +236,7 @@ static void prusa_mini_init(MachineState *machine, const mini_config_t* cfg)
     qdev_prop_set_uint8(db2, "fans", 2);
     qdev_prop_set_uint8(db2, "thermistors", 5);
     qdev_prop_set_string(db2, "indicators", "ZF");
+    qdev_prop_set_bit(db2, "headless", headless);
 
 
     {
@@ -257,22 +283,14 @@ static void prusa_mini_init(MachineState *machine, const mini_config_t* cfg)
             object_property_set_link(OBJECT(db2), links[i], OBJECT(dev), &error_fatal);
             qdev_connect_gpio_out_named(dev,"diag", 0, qdev_get_gpio_in(stm32_soc_get_periph(dev_soc, diag_ports[i]),diag_pins[i]));
             qdev_connect_gpio_out(stm32_soc_get_periph(dev_soc, STM32_P_GPIOD), en_pins[i],qdev_get_gpio_in_named(dev,"enable",0));
-#ifdef BUDDY_HAS_GL
             if (i<3) {
-                qemu_irq split_step = qemu_irq_split(
-                    qdev_get_gpio_in_named(pinda,"position_xyz",i),
-                    qdev_get_gpio_in_named(gl_db,"motor-step",DB_MOTOR_X+i)
-                );
-                qdev_connect_gpio_out_named(dev,"step-out", 0,split_step);
-            } else {
-                qdev_connect_gpio_out_named(dev,"step-out", 0, qdev_get_gpio_in_named(gl_db,"motor-step",DB_MOTOR_X+i));
-            }
-#else
-            if (i<3) {
-                qdev_connect_gpio_out_named(dev,"step-out", 0, qdev_get_gpio_in_named(pinda,"position_xyz",i));
+                object_property_set_link(OBJECT(pinda), links[i], OBJECT(dev), &error_fatal);
             }
+#ifdef BUDDY_HAS_GL
+            qdev_connect_gpio_out_named(dev,"step-out", 0, qdev_get_gpio_in_named(gl_db,"motor-step",DB_MOTOR_X+i));
 #endif
         }
+        sysbus_realize(SYS_BUS_DEVICE(pinda), &error_fatal);
 
     }
 
@@ -304,6 +322,7 @@ static void prusa_mini_init(MachineState *machine, const mini_config_t* cfg)
     sysbus_realize(SYS_BUS_DEVICE(dev), &error_fatal);
     qdev_connect_gpio_out_named(stm32_soc_get_periph(dev_soc, STM32_P_TIM3),"pwm_ratio_changed",3,qdev_get_gpio_in_named(dev, "pwm_in",0));
     qdev_connect_gpio_out_named(dev, "temp_out",0, qdev_get_gpio_in_named(hotend, "thermistor_set_temperature",0));
+    qdev_connect_gpio_out_named(hotend, "thermistor_sample",0, qdev_get_gpio_in_named(dev, "temp_sample",0));
     qdev_connect_gpio_out_named(dev, "pwm-out", 0, qdev_get_gpio_in_named(db2,"therm-pwm",0));
 #ifdef BUDDY_HAS_GL
     qemu_irq split_htr = qemu_irq_split(qdev_get_gpio_in_named(db2,"therm-pwm",0),qdev_get_gpio_in_named(gl_db,"indicator-analog",DB_IND_HTR));
@@ -319,6 +338,7 @@ static void prusa_mini_init(MachineState *machine, const mini_config_t* cfg)
     sysbus_realize(SYS_BUS_DEVICE(dev), &error_fatal);
     qdev_connect_gpio_out_named(stm32_soc_get_periph(dev_soc, STM32_P_TIM3),"pwm_ratio_changed",2,qdev_get_gpio_in_named(dev, "pwm_in",0));
     qdev_connect_gpio_out_named(dev, "temp_out",0, qdev_get_gpio_in_named(bed, "thermistor_set_temperature",0));
+    qdev_connect_gpio_out_named(bed, "thermistor_sample",0, qdev_get_gpio_in_named(dev, "temp_sample",0));
     qdev_connect_gpio_out_named(dev, "pwm-out", 0, qdev_get_gpio_in_named(db2,"therm-pwm",1));
 #ifdef BUDDY_HAS_GL
     qemu_irq split_bed = qemu_irq_split(qdev_get_gpio_in_named(db2,"therm-pwm",1),qdev_get_gpio_in_named(gl_db,"indicator-analog",DB_IND_BED));
@@ -36,6 +36,17 @@
 #include "hw/arm/boot.h"
 #include "hw/loader.h"
 #include "utility/ArgHelper.h"
+#include "utility/p404_elf_syms.h"
+#include "utility/p404_turbo_idle.h"
+#include "utility/p404_hle.h"
+#include "utility/p404_cycle_model.h"
+#include "utility/p404_logic_analyzer.h"
+#include "utility/p404_regprof.h"
+#include "utility/p404_rtos_trace.h"
+#include "utility/p404_sampler.h"
+#include "utility/p404_telemetry.h"
+#include "utility/p404_bench.h"
+#include "utility/p404_print_report.h"
 #include "sysemu/block-backend.h"
 #include "sysemu/runstate.h"
 #include "parts/dashboard_types.h"
@@ -392,6 +403,18 @@ static void mk4_init(MachineState *machine)
                             flash_size);
         }
     }
+    // Pick up firmware symbols (ELF only) for the idle/debug helpers.
+    p404_elf_load_symbols(machine->kernel_filename);
+    p404_turbo_idle_setup();
+    p404_hle_setup();
+    p404_cycle_model_setup();
+    p404_la_setup();
+    p404_regprof_setup();
+    p404_sampler_setup();
+    p404_rtos_trace_setup();
+    p404_telemetry_setup();
+    p404_bench_setup();
+    p404_print_report_setup();
 
 	DeviceState* key_in = qdev_new("p404-key-input");
     sysbus_realize(SYS_BUS_DEVICE(key_in), &error_fatal);
@@ -499,9 +522,10 @@ static void mk4_init(MachineState *machine)
         qdev_realize(dev, bus, &error_fatal);
 	}
     DeviceState *motors[4];
+    bool headless = p404_bench_headless();
 #ifdef BUDDY_HAS_GL
-    DeviceState *gl_db = qdev_new("gl-dashboard");
-    if (arghelper_is_arg("gfx-lite")) {
+    DeviceState *gl_db = qdev_new("gl-dashboard"); // Still wired up when headless, but not started.
+    if (!headless && arghelper_is_arg("gfx-lite")) {
         qdev_prop_set_uint8(gl_db, "dashboard_type", DB_MK4_LITE);
     }
     sysbus_realize(SYS_BUS_DEVICE(gl_db), &error_fatal);
@@ -510,6 +534,7 @@ static void mk4_init(MachineState *machine)
     qdev_prop_set_uint8(db2, "fans", 2);
     qdev_prop_set_uint8(db2, "thermistors", 5);
     qdev_prop_set_string(db2, "indicators", "ZF");
+    qdev_prop_set_bit(db2, "headless", headless);
 
     {
 
@@ -601,6 +626,7 @@ static void mk4_init(MachineState *machine)
     sysbus_realize(SYS_BUS_DEVICE(dev), &error_fatal);
     qdev_connect_gpio_out_named(stm32_soc_get_periph(dev_soc, STM32_P_TIM3),"pwm_ratio_changed",3,qdev_get_gpio_in_named(dev, "pwm_in",0));
     qdev_connect_gpio_out_named(dev, "temp_out",0, qdev_get_gpio_in_named(hotend, "thermistor_set_temperature",0));
+    qdev_connect_gpio_out_named(hotend, "thermistor_sample",0, qdev_get_gpio_in_named(dev, "temp_sample",0));
 #ifdef BUDDY_HAS_GL
     qemu_irq split_htr = qemu_irq_split(qdev_get_gpio_in_named(db2,"therm-pwm",0),qdev_get_gpio_in_named(gl_db,"indicator-analog",DB_IND_HTR));
     qdev_connect_gpio_out_named(dev, "pwm-out", 0, split_htr);
@@ -615,6 +641,7 @@ static void mk4_init(MachineState *machine)
     sysbus_realize(SYS_BUS_DEVICE(dev), &error_fatal);
     qdev_connect_gpio_out_named(stm32_soc_get_periph(dev_soc, STM32_P_TIM3),"pwm_ratio_changed",2,qdev_get_gpio_in_named(dev, "pwm_in",0));
 	qdev_connect_gpio_out_named(dev, "temp_out",0, qdev_get_gpio_in_named(bed, "thermistor_set_temperature",0));
+	qdev_connect_gpio_out_named(bed, "thermistor_sample",0, qdev_get_gpio_in_named(dev, "temp_sample",0));
 #ifdef BUDDY_HAS_GL
     qemu_irq split_bed = qemu_irq_split(qdev_get_gpio_in_named(db2,"therm-pwm",1),qdev_get_gpio_in_named(gl_db,"indicator-analog",DB_IND_BED));
     qdev_connect_gpio_out_named(dev, "pwm-out", 0, split_bed);
@@ -624,8 +651,8 @@ static void mk4_init(MachineState *machine)
 
 	if (cfg.has_loadcell) {
 		DeviceState *lc = qdev_new("loadcell");
+		object_property_set_link(OBJECT(lc), "motor", OBJECT(motors[2]), &error_fatal);
 		sysbus_realize(SYS_BUS_DEVICE(lc), &error_fatal);
-		qdev_connect_gpio_out_named(motors[2],"um-out",0,qdev_get_gpio_in(lc,0));
 
 		DeviceState *hs = qdev_new("hall-sensor");
 		sysbus_realize(SYS_BUS_DEVICE(hs), &error_fatal);
@@ -650,6 +677,11 @@ static void mk4_init(MachineState *machine)
 	else
 	{
 		DeviceState* pinda = qdev_new("pinda");
+		static const char* links[3] = {"motor[0]","motor[1]","motor[2]"};
+		for (int i=0; i<3; i++)
+		{
+			object_property_set_link(OBJECT(pinda), links[i], OBJECT(motors[i]), &error_fatal);
+		}
 		sysbus_realize(SYS_BUS_DEVICE(pinda), &error_fatal);
         DeviceState* split_zmin = qdev_new("split-irq");
 		qdev_prop_set_uint16(split_zmin, "num-lines", 3);
@@ -660,10 +692,6 @@ static void mk4_init(MachineState *machine)
 //         qdev_connect_gpio_out(split_zmin, 2, qdev_get_gpio_in_named(gl_db,"indicator-analog",DB_IND_ZPROBE));
 // #endif
         qdev_connect_gpio_out(pinda, 0,  qdev_get_gpio_in(split_zmin,0));
-		for (int i=0; i<3; i++)
-		{
-			qdev_connect_gpio_out_named(motors[i],"step-out", 0, qdev_get_gpio_in_named(pinda,"position_xyz",i));
-		}
 
 	}
 
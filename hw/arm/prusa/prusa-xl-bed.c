@@ -176,6 +176,9 @@ static void prusa_xl_bed_init(MachineState *machine, int hw_type)
 	sysbus_realize_and_unref(SYS_BUS_DEVICE(pwmtest),&error_fatal);
 	qdev_connect_gpio_out_named(stm32_soc_get_periph(dev_soc, STM32_P_TIM3), "timer", 0, qdev_get_gpio_in_named(pwmtest, "tick-in", 0));
 
+	// Couples the 16 bed tiles thermally, zones are in visual (row-major) order.
+	DeviceState* grid = qdev_new("heater-grid");
+
 	uint16_t table = 65535;
 	for (int i=0; i<16; i++)
     {
@@ -211,6 +214,9 @@ static void prusa_xl_bed_init(MachineState *machine, int hw_type)
 		gchar* name = g_strdup_printf("heater[%d]", i>5 ? i-6 : i);
 		object_property_set_link(OBJECT(current_sense[i>5 ? 0 : 1]), name, OBJECT(dev2), &error_fatal);
 		g_free(name);
+		name = g_strdup_printf("heater[%d]", index2vis[i]);
+		object_property_set_link(OBJECT(grid), name, OBJECT(dev2), &error_fatal);
+		g_free(name);
 		qemu_irq split_pwm = qemu_irq_split( qdev_get_gpio_in_named(dev2, "raw-pwm-in", 0), qdev_get_gpio_in_named(visuals, "heat-in",index2vis[i]));
 		qdev_connect_gpio_out(pwmtest, i, split_pwm);
 		qdev_connect_gpio_out(
@@ -218,7 +224,9 @@ static void prusa_xl_bed_init(MachineState *machine, int hw_type)
 			PIN(bed_outs[i]),
 			qdev_get_gpio_in_named(pwmtest, "gpio-in", i));
 		qdev_connect_gpio_out_named(dev2, "temp_out",0, qdev_get_gpio_in_named(dev, "thermistor_set_temperature",0));
+		qdev_connect_gpio_out_named(dev, "thermistor_sample",0, qdev_get_gpio_in_named(dev2, "temp_sample",0));
     }
+	sysbus_realize_and_unref(SYS_BUS_DEVICE(grid), &error_fatal);
 
 	for (int i=0; i<2; i++)
 	{
@@ -252,6 +252,7 @@ static void _prusa_xl_extruder_init(MachineState *machine, int index, int type)
 		if (i==0)
 		{
 			qdev_connect_gpio_out_named(htr, "temp_out",0, qdev_get_gpio_in_named(dev, "thermistor_set_temperature", 0) );
+			qdev_connect_gpio_out_named(dev, "thermistor_sample",0, qdev_get_gpio_in_named(htr, "temp_sample", 0) );
 		}
        	qdev_connect_gpio_out_named(stm32_soc_get_periph(dev_soc, STM32_P_ADC1),"adc_read", cfg->therm_channels[i],  qdev_get_gpio_in_named(dev, "thermistor_read_request",0));
         qdev_connect_gpio_out_named(dev, "thermistor_value",0, qdev_get_gpio_in_named(stm32_soc_get_periph(dev_soc, STM32_P_ADC1),"adc_data_in",cfg->therm_channels[i]));
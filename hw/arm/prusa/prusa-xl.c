@@ -35,6 +35,17 @@
 #include "hw/arm/boot.h"
 #include "hw/loader.h"
 #include "utility/ArgHelper.h"
+#include "utility/p404_elf_syms.h"
+#include "utility/p404_turbo_idle.h"
+#include "utility/p404_hle.h"
+#include "utility/p404_cycle_model.h"
+#include "utility/p404_logic_analyzer.h"
+#include "utility/p404_regprof.h"
+#include "utility/p404_rtos_trace.h"
+#include "utility/p404_sampler.h"
+#include "utility/p404_telemetry.h"
+#include "utility/p404_bench.h"
+#include "utility/p404_print_report.h"
 #include "sysemu/runstate.h"
 #include "parts/dashboard_types.h"
 #include "parts/xl_bridge.h"
@@ -213,6 +224,18 @@ static void xl_init(MachineState *machine, xl_cfg_t cfg)
                             flash_size);
         }
     }
+    // Pick up firmware symbols (ELF only) for the idle/debug helpers.
+    p404_elf_load_symbols(machine->kernel_filename);
+    p404_turbo_idle_setup();
+    p404_hle_setup();
+    p404_cycle_model_setup();
+    p404_la_setup();
+    p404_regprof_setup();
+    p404_sampler_setup();
+    p404_rtos_trace_setup();
+    p404_telemetry_setup();
+    p404_bench_setup();
+    p404_print_report_setup();
 
 	DeviceState* key_in = qdev_new("p404-key-input");
     sysbus_realize(SYS_BUS_DEVICE(key_in), &error_fatal);
@@ -326,9 +349,10 @@ static void xl_init(MachineState *machine, xl_cfg_t cfg)
     }
 
     DeviceState *motors[4];
+    bool headless = p404_bench_headless();
 #ifdef BUDDY_HAS_GL
-    DeviceState *gl_db = qdev_new("gl-dashboard");
-    if (arghelper_is_arg("gfx-lite")) {
+    DeviceState *gl_db = qdev_new("gl-dashboard"); // Still wired up when headless, but not started.
+    if (!headless && arghelper_is_arg("gfx-lite")) {
         qdev_prop_set_uint8(gl_db, "dashboard_type", DB_MK4_LITE);
     }
     sysbus_realize(SYS_BUS_DEVICE(gl_db), &error_fatal);
@@ -353,6 +377,7 @@ static void xl_init(MachineState *machine, xl_cfg_t cfg)
 	qdev_prop_set_uint8(db2, "fans", 0);
 	qdev_prop_set_uint8(db2, "thermistors", 0);
 	qdev_prop_set_string(db2, "indicators", "ZRWCF123456");
+	qdev_prop_set_bit(db2, "headless", headless);
 
     {
         static int32_t stepsize[4] = { 80*16, 80*16, 800*16, 400*16 };
@@ -510,8 +535,8 @@ static void xl_init(MachineState *machine, xl_cfg_t cfg)
 #endif
 
     DeviceState *lc = qdev_new("loadcell");
+    object_property_set_link(OBJECT(lc), "motor", OBJECT(motors[2]), &error_fatal);
     sysbus_realize(SYS_BUS_DEVICE(lc), &error_fatal);
-    qdev_connect_gpio_out_named(motors[2],"um-out",0,qdev_get_gpio_in(lc,0));
 
     dev = qdev_new("hx717");
     sysbus_realize(SYS_BUS_DEVICE(dev), &error_fatal);
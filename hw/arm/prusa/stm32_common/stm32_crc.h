@@ -0,0 +1,85 @@
+/*
+    stm32_crc.h - Common STM32 CRC unit: slice-by-8 CRC-32 kernel and the
+	bulk ingest interface.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STM32_COMMON_CRC_H
+#define STM32_COMMON_CRC_H
+
+// The kernel is header-only so the unit test can check it against the device.
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+
+#define STM32_CRC_POLY 0x04C11DB7U
+
+// [0] is the classic MSB-first byte table, [k] is [0] followed by k zero bytes.
+typedef uint32_t stm32_crc_tables_t[8][256];
+
+static inline void stm32_crc_build_tables(stm32_crc_tables_t t)
+{
+	for (uint32_t b=0; b<256; b++)
+	{
+		uint32_t crc = b << 24;
+		for (int i=0; i<8; i++)
+		{
+			crc = (crc & 0x80000000U) ? (crc << 1) ^ STM32_CRC_POLY : crc << 1;
+		}
+		t[0][b] = crc;
+	}
+	for (int k=1; k<8; k++)
+	{
+		for (uint32_t b=0; b<256; b++)
+		{
+			t[k][b] = (t[k-1][b] << 8) ^ t[0][t[k-1][b] >> 24];
+		}
+	}
+}
+
+// One DR write: the four bytes of word, most significant first.
+static inline uint32_t stm32_crc_word(const stm32_crc_tables_t t, uint32_t crc, uint32_t word)
+{
+	crc ^= word;
+	return t[3][crc >> 24] ^ t[2][(crc >> 16) & 0xFF] ^ t[1][(crc >> 8) & 0xFF] ^ t[0][crc & 0xFF];
+}
+
+// n_words DR writes of the words in buf, as laid out in guest (little-endian) memory.
+static inline uint32_t stm32_crc_words(const stm32_crc_tables_t t, uint32_t crc, const uint8_t *buf, size_t n_words)
+{
+	for (; n_words >= 2; n_words -= 2, buf += 8)
+	{
+		uint32_t w0 = crc ^ ldl_le_p(buf);
+		uint32_t w1 = ldl_le_p(buf + 4);
+		crc = t[7][w0 >> 24] ^ t[6][(w0 >> 16) & 0xFF] ^ t[5][(w0 >> 8) & 0xFF] ^ t[4][w0 & 0xFF] ^
+			t[3][w1 >> 24] ^ t[2][(w1 >> 16) & 0xFF] ^ t[1][(w1 >> 8) & 0xFF] ^ t[0][w1 & 0xFF];
+	}
+	if (n_words)
+	{
+		crc = stm32_crc_word(t, crc, ldl_le_p(buf));
+	}
+	return crc;
+}
+
+// Feeds n_words words from buf to the CRC unit obj in one go, exactly as if each was
+// written to DR in turn. If reset is set, DR is reloaded from INIT first (CR.RESET).
+// Returns false if obj is not a CRC unit or its RCC clock is off.
+extern bool stm32_crc_feed_words(Object *obj, const void *buf, size_t n_words, bool reset);
+
+#endif // STM32_COMMON_CRC_H
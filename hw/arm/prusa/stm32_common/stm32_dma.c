@@ -116,8 +116,16 @@ typedef struct COM_STRUCT_NAME(Dma) {
 	QEMUTimer* dma_timer;
 	uint8_t dma_pending[STM32_COM_DMA_MAX_CHAN];
 
+	// Enabled channels per DMAR direction, so a request only compares the live
+	// CPAR of those. Rebuilt lazily when a channel's EN/DIR change.
+	uint8_t routes[2][STM32_COM_DMA_MAX_CHAN];
+	uint8_t route_count[2];
+	bool routes_dirty;
+
 	qemu_irq irq[STM32_COM_DMA_MAX_CHAN];
 
+	p404_stats_t *stats;
+
 	const stm32_reginfo_t* reginfo;
 
 } COM_STRUCT_NAME(Dma);
@@ -208,6 +216,7 @@ static void stm32_common_update_irqs(COM_STRUCT_NAME(Dma) *s, uint8_t channel)
 	{
 		s->regs.defs.ISR.raw |= gi_flag;
 		if (sr & int_en) {
+			p404_stats_inc(s->stats, P404_STAT_IRQ);
 			qemu_irq_raise(s->irq[channel]);
 		}
 	}
@@ -282,6 +291,7 @@ static void stm32_common_dma_do_xfer(COM_STRUCT_NAME(Dma) *s, hwaddr chan_base)
 		dest_size,
 		MEMTXATTRS_UNSPECIFIED
 	);
+	p404_stats_inc(s->stats, P404_STAT_DMA);
 
 	*dest += dest_inc;
 	*src += src_inc;
@@ -304,10 +314,27 @@ static void stm32_common_dma_do_xfer(COM_STRUCT_NAME(Dma) *s, hwaddr chan_base)
 		else
 		{
 			cr->EN = false; // Disable the channel, transmit is done.
+			s->routes_dirty = true;
 		}
 	}
 }
 
+static void stm32_common_dma_update_routes(COM_STRUCT_NAME(Dma) *s)
+{
+	s->route_count[DIR_P2M] = s->route_count[DIR_M2P] = 0;
+	for (int idx=0; idx<STM32_COM_DMA_MAX_CHAN; idx++)
+	{
+		hwaddr i = RI_CHAN_BASE + (idx*STM32_COM_DMA_CHAN_REGS);
+		REGDEF_NAME(dma,ccr) *cr = (REGDEF_NAME(dma,ccr)*)&s->regs.raw[i+CH_OFF_CCR];
+		if (cr->EN != true)
+		{
+			continue;
+		}
+		s->routes[cr->DIR][s->route_count[cr->DIR]++] = idx;
+	}
+	s->routes_dirty = false;
+}
+
 static void stm32_common_dma_dmar(void *opaque, int n, int level)
 {
 	//Idea: level contains the source address of the peripheral,
@@ -315,25 +342,21 @@ static void stm32_common_dma_dmar(void *opaque, int n, int level)
 	// in the STM32F4 implementation.
 	COM_STRUCT_NAME(Dma) *s = STM32COM_DMA(opaque);
 
-	REGDEF_NAME(dma,ccr) *cr;
-	int idx = 0;
-	for (int i=RI_CHAN_BASE; i<RI_CHAN_END; i+=STM32_COM_DMA_CHAN_REGS, idx++)
+	if (s->routes_dirty)
 	{
-		cr = (REGDEF_NAME(dma,ccr)*)&s->regs.raw[i+CH_OFF_CCR];
-		// Is this our peripheral?
-		if (s->regs.raw[i+CH_OFF_CPAR] != level)
-		{
-			continue;
-		}
-		if (cr->EN != true || s->regs.raw[i+CH_OFF_CNDTR] == 0)
-		{
-			continue;
-		}
-		if (cr->DIR != n) // Does the direction of the request match?
+		stm32_common_dma_update_routes(s);
+	}
+	// Only enabled channels with this direction are in the table.
+	for (int i=0; i<s->route_count[n]; i++)
+	{
+		uint8_t channel = s->routes[n][i];
+		hwaddr base = RI_CHAN_BASE + (channel*STM32_COM_DMA_CHAN_REGS);
+		// Is this our peripheral? CPAR is read live, as it moves with PINC.
+		if (s->regs.raw[base+CH_OFF_CPAR] != (uint32_t)level || s->regs.raw[base+CH_OFF_CNDTR] == 0)
 		{
 			continue;
 		}
-		s->dma_pending[idx]++;
+		s->dma_pending[channel]++;
 		// Rather than immediate DMA, we use a timer and channel pending count
 		// to keep things from going pear-shaped if the DMA action triggers
 		// a cascade - the triggered event will be delayed until the timer fires
@@ -397,6 +420,7 @@ stm32_common_dma_chan_write(COM_STRUCT_NAME(Dma) *s, hwaddr addr, uint64_t data,
 				s->regs.raw[addr+CH_OFF_CMAR] = s->original_cmars[chan];
 				s->regs.raw[addr+CH_OFF_CPAR] = s->original_cpars[chan];
 			}
+			s->routes_dirty |= (old.EN != new.EN) || (old.DIR != new.DIR);
 		}
 		break;
 		case CH_OFF_CNDTR:
@@ -462,6 +486,7 @@ static void stm32_common_dma_reset(DeviceState *dev)
 {
 	COM_STRUCT_NAME(Dma) *s = STM32COM_DMA(dev);
     memset(&s->regs, 0, sizeof(s->regs));
+	s->routes_dirty = true;
 }
 
 static void stm32_common_dma_realize(DeviceState *dev, Error **errp)
@@ -497,6 +522,7 @@ stm32_common_dma_init(Object *obj)
 
     STM32_MR_IO_INIT(&s->iomem, obj, &stm32_common_dma_ops, s, 1*KiB);
     sysbus_init_mmio(SYS_BUS_DEVICE(obj), &s->iomem);
+	s->stats = p404_stats_get(obj);
 
     qdev_init_gpio_in_named(DEVICE(obj),stm32_common_dma_dmar,"dmar-in",2);
 
@@ -509,10 +535,18 @@ stm32_common_dma_init(Object *obj)
 	s->reginfo = k->var_reginfo;
 }
 
+static int stm32_common_dma_post_load(void *opaque, int version_id)
+{
+	COM_STRUCT_NAME(Dma) *s = STM32COM_DMA(opaque);
+	s->routes_dirty = true;
+	return 0;
+}
+
 static const VMStateDescription vmstate_stm32_common_dma = {
     .name = TYPE_STM32COM_DMA,
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = stm32_common_dma_post_load,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32_ARRAY(regs.raw,COM_STRUCT_NAME(Dma), RI_END),
         VMSTATE_UINT32_ARRAY(original_ndtrs,COM_STRUCT_NAME(Dma), STM32_COM_DMA_MAX_CHAN),
@@ -140,10 +140,19 @@ typedef struct STM32F2XX_STRUCT_NAME(Dma) {
 	uint32_t original_cpars[STM32_F2xx_DMA_MAX_CHAN];
 	uint8_t dma_pending[STM32_F2xx_DMA_MAX_CHAN];
 
+	// Enabled streams per DMAR direction, so a request only compares the live
+	// SxPAR of those (usually one or two) rather than of all eight. Rebuilt
+	// lazily when a stream's EN/CHSEL/DIR change, not on SxPAR/SxNDTR writes.
+	uint8_t routes[2][STM32_F2xx_DMA_MAX_CHAN];
+	uint8_t route_count[2];
+	bool routes_dirty;
+
 	QEMUTimer* dma_timer;
 
 	qemu_irq irq[STM32_F2xx_DMA_MAX_CHAN];
 
+	p404_stats_t *stats;
+
 } STM32F2XX_STRUCT_NAME(Dma);
 
 
@@ -203,6 +212,7 @@ static void stm32_f2xx_f4xx_update_irqs(STM32F2XX_STRUCT_NAME(Dma) *s, uint8_t c
 	if (sr != 0)
 	{
 		if (sr & int_en) {
+			p404_stats_inc(s->stats, P404_STAT_IRQ);
 			qemu_irq_raise(s->irq[channel]);
 		}
 	}
@@ -318,6 +328,7 @@ static void stm32_f2xx_f4xx_dma_do_xfer(STM32F2XX_STRUCT_NAME(Dma) *s, hwaddr ch
 		dest_size,
 		MEMTXATTRS_UNSPECIFIED
 	);
+	p404_stats_inc(s->stats, P404_STAT_DMA);
 
 	(*ndtr)--; // NDTR is in transfers, not bytes.
 	*dest += dest_inc;
@@ -339,10 +350,27 @@ static void stm32_f2xx_f4xx_dma_do_xfer(STM32F2XX_STRUCT_NAME(Dma) *s, hwaddr ch
 		else
 		{
 			cr->EN = false; // Transfer done, disable channel.
+			s->routes_dirty = true;
 		}
 	}
 }
 
+static void stm32_f2xx_f4xx_dma_update_routes(STM32F2XX_STRUCT_NAME(Dma) *s)
+{
+	s->route_count[DIR_P2M] = s->route_count[DIR_M2P] = 0;
+	for (int idx=0; idx<STM32_F2xx_DMA_MAX_CHAN; idx++)
+	{
+		hwaddr i = RI_CHAN_BASE + (idx*STM32_F2xx_DMA_CHAN_REGS);
+		REGDEF_NAME(dma,sxcr) *cr = (REGDEF_NAME(dma,sxcr)*)&s->regs.raw[i+CH_OFF_SxCR];
+		if (cr->EN != true || cr->DIR > DIR_M2P)
+		{
+			continue;
+		}
+		s->routes[cr->DIR][s->route_count[cr->DIR]++] = idx;
+	}
+	s->routes_dirty = false;
+}
+
 static void stm32_f2xx_f4xx_dma_dmar(void *opaque, int n, int level)
 {
 	//Idea: level contains the source address of the peripheral,
@@ -350,25 +378,21 @@ static void stm32_f2xx_f4xx_dma_dmar(void *opaque, int n, int level)
 	// in the STM32F4 implementation.
 	STM32F2XX_STRUCT_NAME(Dma) *s = STM32F4xx_DMA(opaque);
 
-	REGDEF_NAME(dma,sxcr) *cr;
-	int idx = 0;
-	for (int i=RI_CHAN_BASE; i<RI_CHAN_END; i+= CH_OFF_END, idx++)
+	if (s->routes_dirty)
 	{
-		cr = (REGDEF_NAME(dma,sxcr)*)&s->regs.raw[i+CH_OFF_SxCR];
-		// Is this our peripheral?
-		if (s->regs.raw[i+CH_OFF_SxPAR] != level)
-		{
-			continue;
-		}
-		if (cr->DIR != n) // Does the direction of the request match?
-		{
-			continue;
-		}
-		if (cr->EN != true || s->regs.raw[i+CH_OFF_SxNDTR] == 0)
+		stm32_f2xx_f4xx_dma_update_routes(s);
+	}
+	// Only enabled streams with this direction are in the table.
+	for (int i=0; i<s->route_count[n]; i++)
+	{
+		uint8_t stream = s->routes[n][i];
+		hwaddr base = RI_CHAN_BASE + (stream*STM32_F2xx_DMA_CHAN_REGS);
+		// Is this our peripheral? PAR is read live, as it moves with PINC.
+		if (s->regs.raw[base+CH_OFF_SxPAR] != (uint32_t)level || s->regs.raw[base+CH_OFF_SxNDTR] == 0)
 		{
 			continue;
 		}
-		s->dma_pending[idx]++;
+		s->dma_pending[stream]++;
 		timer_mod_ns(s->dma_timer,qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
 	}
 }
@@ -430,6 +454,7 @@ stm32_f2xx_f4xx_dma_chan_write(STM32F2XX_STRUCT_NAME(Dma) *s, hwaddr addr, uint6
 				s->regs.raw[addr+CH_OFF_SxPAR] = s->original_cpars[chan];
 			}
 			s->regs.raw[addr] = new.raw;
+			s->routes_dirty |= (old.EN != new.EN) || (old.CHSEL != new.CHSEL) || (old.DIR != new.DIR);
 		}
 		break;
 		case CH_OFF_SxNDTR:
@@ -503,6 +528,7 @@ static void stm32_f2xx_f4xx_dma_reset(DeviceState *dev)
 {
 	STM32F2XX_STRUCT_NAME(Dma) *s = STM32F4xx_DMA(dev);
     memset(&s->regs, 0, sizeof(s->regs));
+	s->routes_dirty = true;
 }
 
 static void stm32_f2xx_f4xx_dma_realize(DeviceState *dev, Error **errp)
@@ -543,12 +569,21 @@ stm32_f2xx_f4xx_dma_init(Object *obj)
 	qdev_init_gpio_out_named(DEVICE(obj), s->irq, SYSBUS_DEVICE_GPIO_IRQ, STM32_F2xx_DMA_MAX_CHAN);
 
 	s->dma_timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, stm32_f2xx_f4xx_dma_timer, obj);
+	s->stats = p404_stats_get(obj);
+}
+
+static int stm32_f2xx_f4xx_dma_post_load(void *opaque, int version_id)
+{
+	STM32F2XX_STRUCT_NAME(Dma) *s = STM32F4xx_DMA(opaque);
+	s->routes_dirty = true;
+	return 0;
 }
 
 static const VMStateDescription vmstate_stm32_f2xx_f4xx_dma = {
     .name = TYPE_STM32F2xx_DMA,
     .version_id = 1,
     .minimum_version_id = 1,
+    .post_load = stm32_f2xx_f4xx_dma_post_load,
     .fields = (VMStateField[]) {
         VMSTATE_UINT32_ARRAY(regs.raw,STM32F2XX_STRUCT_NAME(Dma), RI_MAX),
         VMSTATE_UINT32_ARRAY(original_ndtrs,STM32F2XX_STRUCT_NAME(Dma), STM32_F2xx_DMA_MAX_CHAN),
@@ -33,17 +33,7 @@
 #include "qemu/log.h"
 #include "migration/vmstate.h"
 #include "hw/qdev-properties.h"
-
-//#define DEBUG_STM32_GPIO
-#ifdef DEBUG_STM32_GPIO
-// NOTE: The usleep() helps the MacOS stdout from freezing when we have a lot of print out
-#define DPRINTF(fmt, ...)                                       \
-    do { printf("STM32F2XX_GPIO: " fmt , ## __VA_ARGS__); \
-         usleep(100); \
-    } while (0)
-#else
-#define DPRINTF(fmt, ...)
-#endif
+#include "../trace.h"
 
 
 #define STM32_GPIO_PIN_COUNT 16
@@ -253,7 +243,7 @@ stm32_common_gpio_set(void *arg, int pin, int level)
     // tied to a handler callback in the NVIC.
     qemu_set_irq(s->cpu_wake[pin], level);
 
-    DPRINTF("GPIO %u set pin %d level %d\n", s->periph, pin, level);
+    trace_stm32_gpio_set_pin(s->parent.periph, pin, level);
 }
 
 
@@ -261,7 +251,7 @@ void
 stm32_common_gpio_wake_set(COM_STRUCT_NAME(Gpio) *s, unsigned pin, qemu_irq irq)
 {
     s->cpu_wake[pin] = irq;
-    DPRINTF("GPIO %u set cpu_wake %u irq %p\n", s->parent.periph, pin, irq);
+    trace_stm32_gpio_wake_set(s->parent.periph, pin, irq);
 }
 
 static void
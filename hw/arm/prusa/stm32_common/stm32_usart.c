@@ -237,6 +237,8 @@ typedef struct COM_STRUCT_NAME(Usart) {
     qemu_irq irq;
     int curr_irq_level;
 
+	p404_stats_t *stats;
+
 	qemu_irq byte_out;
 
 	bool do_rs485;
@@ -378,6 +380,9 @@ static void stm32_common_usart_update_irq(COM_STRUCT_NAME(Usart) *s) {
      * set the level regardless, but we will just check for good measure.
      */
     if(new_irq_level ^ s->curr_irq_level) {
+        if (new_irq_level) {
+            p404_stats_inc(s->stats, P404_STAT_IRQ);
+        }
         qemu_set_irq(s->irq, new_irq_level);
         s->curr_irq_level = new_irq_level;
     }
@@ -444,6 +449,7 @@ static void stm32_common_usart_start_tx(COM_STRUCT_NAME(Usart) *s, uint32_t valu
 			// }
 			// printf("\n");
 			qemu_chr_fe_write_all(&s->chr, &s->rs485_in[3], s->rs485_in_i-7);
+			p404_stats_add(s->stats, P404_STAT_CHR_BYTES, s->rs485_in_i-7);
 			s->rs485_in_i = 0;
 		}
 	}
@@ -455,6 +461,7 @@ static void stm32_common_usart_start_tx(COM_STRUCT_NAME(Usart) *s, uint32_t valu
 			printf("RS485 TX: %02x (%c)\n", ch, ch);
 		} // LCOV_EXCL_STOP
     	qemu_chr_fe_write_all(&s->chr, &ch, 1);
+		p404_stats_inc(s->stats, P404_STAT_CHR_BYTES);
 	}
     // if (s->chr_write_obj) {
         // s->chr_write(s->chr_write_obj, &ch, 1);
@@ -698,6 +705,7 @@ static void stm32_common_usart_receive(void *opaque, const uint8_t *buf, int siz
 	timer_del(s->rto_timer); // Cancel pending RTO
 	timer_del(s->idle_timer);
     assert(size > 0);
+	p404_stats_add(s->stats, P404_STAT_CHR_BYTES, size);
     /* Copy the characters into our buffer first */
     assert (size <= USART_RCV_BUF_LEN - s->rcv_char_bytes);
 	if (s->debug_rs485) // LCOV_EXCL_START
@@ -964,6 +972,7 @@ static void stm32_common_usart_init(Object *obj)
     sysbus_init_mmio(SYS_BUS_DEVICE(obj), &s->iomem);
 
     sysbus_init_irq(SYS_BUS_DEVICE(obj), &s->irq);
+	s->stats = p404_stats_get(obj);
 
     s->rx_timer =
         timer_new_ns(QEMU_CLOCK_VIRTUAL,
@@ -0,0 +1,195 @@
+/*
+ * QTest testcase for the bit-banged AT21CSxx EEPROM and ws281x LED decoders,
+ * run without -icount at several guest speeds.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "libqos/libqtest.h"
+
+#define EEPROM "/machine/peripheral/eeprom"
+#define LED "/machine/peripheral/led"
+
+// How slow (or fast) the simulated guest runs, as a percentage of real time.
+// The same pulses are sent at each, so only relative timing can decode them.
+static const int speeds_pct[] = { 50, 100, 300 };
+
+static int64_t scaled_ns(int speed_pct, int64_t ns)
+{
+	return (ns * speed_pct) / 100;
+}
+
+// Drives the pin, then holds it for ns of (scaled) virtual time.
+static void drive(QTestState *ts, const char *path, int level, int speed_pct, int64_t ns)
+{
+	qtest_set_irq_in(ts, path, NULL, 0, level);
+	qtest_clock_step(ts, scaled_ns(speed_pct, ns));
+}
+
+// Low pulse of low_ns. The line is left high, so the caller can check the
+// EEPROM's answer before the rest of the bit frame.
+static void at21_low(QTestState *ts, int speed_pct, int64_t low_ns)
+{
+	drive(ts, EEPROM, 0, speed_pct, low_ns);
+	qtest_set_irq_in(ts, EEPROM, NULL, 0, 1);
+}
+
+// High-speed mode: a 1 is a 1us low and a 0 a 10us low, in a 15us frame.
+static void at21_bit(QTestState *ts, int speed_pct, bool bit)
+{
+	at21_low(ts, speed_pct, bit ? 1000 : 10000);
+	qtest_clock_step(ts, scaled_ns(speed_pct, bit ? 14000 : 5000));
+}
+
+// Returns true if the EEPROM held the line low (ACK) after the byte.
+static bool at21_write_byte(QTestState *ts, int speed_pct, uint8_t byte)
+{
+	for (int i=7; i>=0; i--)
+	{
+		at21_bit(ts, speed_pct, (byte >> i) & 1);
+	}
+	at21_low(ts, speed_pct, 1000);
+	bool ack = qtest_get_irq_level(ts, 0) == 0;
+	qtest_clock_step(ts, scaled_ns(speed_pct, 14000));
+	return ack;
+}
+
+static uint8_t at21_read_byte(QTestState *ts, int speed_pct, bool last)
+{
+	uint8_t byte = 0;
+	for (int i=0; i<8; i++)
+	{
+		at21_low(ts, speed_pct, 1000);
+		byte = (byte << 1) | (qtest_get_irq_level(ts, 0) > 0);
+		qtest_clock_step(ts, scaled_ns(speed_pct, 14000));
+	}
+	at21_bit(ts, speed_pct, last); // NACK ends the read.
+	return byte;
+}
+
+// Reset, discovery and a start condition. Returns true if the discovery was acked.
+static bool at21_start(QTestState *ts, int speed_pct, bool reset)
+{
+	bool ack = true;
+	if (reset)
+	{
+		drive(ts, EEPROM, 0, speed_pct, 150000);
+		drive(ts, EEPROM, 1, speed_pct, 10000);
+		at21_low(ts, speed_pct, 1000);
+		ack = qtest_get_irq_level(ts, 0) == 0;
+		qtest_clock_step(ts, scaled_ns(speed_pct, 10000));
+		// The ack must also be released again.
+		ack &= qtest_get_irq_level(ts, 0) > 0;
+	}
+	qtest_clock_step(ts, scaled_ns(speed_pct, 600000));
+	return ack;
+}
+
+static void test_at21csxx(void)
+{
+	for (int i=0; i<ARRAY_SIZE(speeds_pct); i++)
+	{
+		int speed = speeds_pct[i];
+		QTestState *ts = qtest_init("-machine stm32f407xE -device at21csxx,id=eeprom");
+		qtest_irq_intercept_out(ts, EEPROM);
+		qtest_set_irq_in(ts, EEPROM, NULL, 0, 1);
+		qtest_clock_step(ts, scaled_ns(speed, 100000));
+
+		// Twice, so the discovery ack is checked against a line that was seen high.
+		g_assert_true(at21_start(ts, speed, true));
+		g_assert_true(at21_start(ts, speed, true));
+
+		// Write 0x5A to 0x10.
+		g_assert_true(at21_write_byte(ts, speed, 0xA0));
+		g_assert_true(at21_write_byte(ts, speed, 0x10));
+		g_assert_true(at21_write_byte(ts, speed, 0x5A));
+
+		// Out-of-range addresses are NACKed.
+		at21_start(ts, speed, false);
+		g_assert_true(at21_write_byte(ts, speed, 0xA0));
+		g_assert_false(at21_write_byte(ts, speed, 0x90));
+
+		// Random read from 0x0F: the erased default, then the written byte.
+		at21_start(ts, speed, false);
+		g_assert_true(at21_write_byte(ts, speed, 0xA0));
+		g_assert_true(at21_write_byte(ts, speed, 0x0F));
+		at21_start(ts, speed, false);
+		g_assert_true(at21_write_byte(ts, speed, 0xA1));
+		g_assert_cmphex(at21_read_byte(ts, speed, false), ==, 0xFF);
+		g_assert_cmphex(at21_read_byte(ts, speed, true), ==, 0x5A);
+
+		// A bus reset in the middle of a transfer restarts discovery.
+		at21_start(ts, speed, false);
+		at21_bit(ts, speed, 1);
+		g_assert_true(at21_start(ts, speed, true));
+		g_assert_true(at21_write_byte(ts, speed, 0xA0));
+		g_assert_true(at21_write_byte(ts, speed, 0x01));
+		at21_start(ts, speed, false);
+		g_assert_true(at21_write_byte(ts, speed, 0xA1));
+		g_assert_cmphex(at21_read_byte(ts, speed, true), ==, 0x20);
+
+		qtest_quit(ts);
+	}
+}
+
+// 800 kHz: a 1 is high for ~2/3 of the 1.25us period, a 0 for ~1/3.
+static void ws281x_word(QTestState *ts, int speed_pct, uint32_t grb)
+{
+	for (int i=23; i>=0; i--)
+	{
+		bool bit = (grb >> i) & 1;
+		drive(ts, LED, 1, speed_pct, bit ? 800 : 400);
+		drive(ts, LED, 0, speed_pct, bit ? 450 : 850);
+	}
+}
+
+static void ws281x_latch(QTestState *ts, int speed_pct)
+{
+	qtest_clock_step(ts, scaled_ns(speed_pct, 80000));
+}
+
+static void test_ws281x(void)
+{
+	for (int i=0; i<ARRAY_SIZE(speeds_pct); i++)
+	{
+		int speed = speeds_pct[i];
+		QTestState *ts = qtest_init("-machine stm32f407xE -device ws281x,id=led");
+		qtest_irq_intercept_out_named(ts, LED, "colour");
+		qtest_set_irq_in(ts, LED, NULL, 0, 0);
+		qtest_clock_step(ts, scaled_ns(speed, 100000));
+
+		// The first LED takes the first word, later ones pass through.
+		ws281x_word(ts, speed, 0x123456);
+		ws281x_word(ts, speed, 0xFFFFFF);
+		ws281x_latch(ts, speed);
+		g_assert_cmphex(qtest_get_irq_level(ts, 0), ==, 0x341256);
+
+		// After the latch the next word is ours again.
+		ws281x_word(ts, speed, 0xA5C30F);
+		ws281x_latch(ts, speed);
+		g_assert_cmphex(qtest_get_irq_level(ts, 0), ==, 0xC3A50F);
+
+		qtest_quit(ts);
+	}
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    qtest_add_func("/bitbang_timing/at21csxx", test_at21csxx);
+    qtest_add_func("/bitbang_timing/ws281x", test_ws281x);
+
+    return g_test_run();
+}
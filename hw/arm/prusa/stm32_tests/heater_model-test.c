@@ -0,0 +1,195 @@
+/*
+ * Unit test for the closed-form heater model, against the old 250 ms tick.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+
+// The model has no QEMU dependencies beyond the headers, so test it directly.
+#include "../utility/p404_thermal.c"
+
+#define AMBIENT 18.f
+#define TICK_MS 250
+
+typedef struct {
+	int64_t at_ms;
+	uint16_t pwm;
+} pwm_step_t;
+
+// What heater_temp_tick_expire used to do before the closed-form model.
+typedef struct {
+	float mass, temp;
+	uint16_t pwm, lastpwm;
+	bool ticking;
+	int64_t next_ms;
+} old_heater_t;
+
+static void old_tick(old_heater_t *h, int64_t now_ms)
+{
+	static const float updaterate = 0.25;
+	if (h->pwm || h->lastpwm>0)
+	{
+		float pwmval = (h->pwm>h->lastpwm)? h->pwm : h->lastpwm;
+		h->temp += (h->mass*(pwmval/255.0f))*updaterate;
+		h->lastpwm = h->pwm;
+	} else {
+		float dT = (h->temp - AMBIENT)*pow(2.7183,-0.005*updaterate);
+		h->temp -= h->temp - (AMBIENT + dT);
+	}
+	if (h->pwm || h->temp>AMBIENT+0.3)
+	{
+		h->next_ms = now_ms + TICK_MS;
+	}
+	else
+	{
+		h->ticking = false;
+		h->temp = AMBIENT;
+	}
+}
+
+// Runs both models through the same PWM schedule and returns the worst difference
+// seen at the old model's ticks. worst_step is the most the difference moved between
+// two PWM changes, since the old model's lag at each change adds up over a long run.
+static float compare_schedule(float mass, const pwm_step_t *steps, int count, int64_t end_ms,
+	float *worst_step)
+{
+	old_heater_t old = { .mass = mass, .temp = AMBIENT };
+	p404_thermal_t model;
+	double tau = 200;
+	float worst = 0, diff = 0, diff_at_step = 0;
+	int step = 0;
+
+	*worst_step = 0;
+
+	p404_thermal_init(&model, 1, NULL, 0, &tau, AMBIENT, 0);
+	for (int64_t now_ms = 0; now_ms <= end_ms; now_ms++)
+	{
+		int64_t now_ns = now_ms * SCALE_MS;
+		if (step < count && steps[step].at_ms == now_ms)
+		{
+			old.pwm = steps[step].pwm;
+			if (!old.ticking)
+			{
+				old.ticking = true;
+				old.next_ms = now_ms + 1;
+			}
+			p404_thermal_set_rate(&model, 0, mass*(steps[step].pwm/255.0), now_ns);
+			diff_at_step = diff;
+			step++;
+		}
+		if (old.ticking && old.next_ms == now_ms)
+		{
+			old_tick(&old, now_ms);
+			if (old.ticking)
+			{
+				diff = old.temp - p404_thermal_get_temp(&model, 0, now_ns);
+				worst = MAX(worst, fabs(diff));
+				*worst_step = MAX(*worst_step, fabs(diff - diff_at_step));
+			}
+			else
+			{
+				// The heater settles on ambient at the same threshold.
+				g_assert_cmpfloat(p404_thermal_get_temp(&model, 0, now_ns), <=, AMBIENT + 0.3 + 0.05);
+			}
+		}
+	}
+	return worst;
+}
+
+// Heat-up is linear with no loss, then an exponential cooldown.
+static void test_heat_then_cool(void)
+{
+	static const pwm_step_t steps[] = {
+		{ 1000, 255 },
+		{ 61000, 0 },
+	};
+	for (int mass10x = 3; mass10x <= 30; mass10x += 9)
+	{
+		float mass = mass10x/10.f, worst_step;
+		// The old tick applies each PWM level up to one tick early or late.
+		g_assert_cmpfloat(compare_schedule(mass, steps, ARRAY_SIZE(steps), 1000000, &worst_step), <=, (mass * 0.25f) + 0.05f);
+	}
+}
+
+// A regulating heater: partial duty, frequent changes, and short off periods.
+static void test_regulating(void)
+{
+	pwm_step_t steps[400];
+	int64_t at_ms = 500;
+	for (int i=0; i<ARRAY_SIZE(steps); i++)
+	{
+		steps[i].at_ms = at_ms;
+		steps[i].pwm = (i % 7 == 3) ? 0 : (i * 37) % 256;
+		at_ms += 333 + ((i * 101) % 2000);
+	}
+	float mass = 2.5f, worst_step;
+	compare_schedule(mass, steps, ARRAY_SIZE(steps), at_ms + 1000000, &worst_step);
+	// A decrease only takes effect after one more tick at the old level, so allow two.
+	g_assert_cmpfloat(worst_step, <=, (mass * 0.5f) + 0.05f);
+}
+
+// Uncoupled grid zones keep their own cooldown, and match a standalone heater.
+static void test_grid_zone_tau(void)
+{
+	p404_thermal_t grid, single;
+	double tau[4] = { 200, 600, 200, 50 };
+	for (int i=0; i<4; i++)
+	{
+		p404_thermal_init(&grid, 4, NULL, 0, tau, AMBIENT, 0);
+		p404_thermal_init(&single, 1, NULL, 0, &tau[i], AMBIENT, 0);
+		p404_thermal_set_rate(&grid, i, 1.0, 0);
+		p404_thermal_set_rate(&single, 0, 1.0, 0);
+		p404_thermal_set_rate(&grid, i, 0, 100 * NANOSECONDS_PER_SECOND);
+		p404_thermal_set_rate(&single, 0, 0, 100 * NANOSECONDS_PER_SECOND);
+		for (int s=100; s<1000; s+=50)
+		{
+			int64_t now_ns = s * NANOSECONDS_PER_SECOND;
+			double expected = AMBIENT + 100.0 * exp(-(s - 100) / tau[i]);
+			g_assert_cmpfloat(fabs(p404_thermal_get_temp(&single, 0, now_ns) - expected), <, 1e-6);
+			g_assert_cmpfloat(fabs(p404_thermal_get_temp(&grid, i, now_ns) - expected), <, 1e-6);
+		}
+	}
+}
+
+// Coupled zones share heat but, with nothing lost while heating, conserve it.
+static void test_grid_coupled_heating(void)
+{
+	static const uint8_t neighbours[4] = {
+		0, 1,
+		1, 0,
+	};
+	double tau[2] = { 200, 200 };
+	p404_thermal_t grid;
+	p404_thermal_init(&grid, 2, neighbours, 0.02, tau, AMBIENT, 0);
+	p404_thermal_set_rate(&grid, 0, 2.0, 0);
+	p404_thermal_set_rate(&grid, 1, 1.0, 0);
+	int64_t now_ns = 60 * NANOSECONDS_PER_SECOND;
+	double t0 = p404_thermal_get_temp(&grid, 0, now_ns);
+	double t1 = p404_thermal_get_temp(&grid, 1, now_ns);
+	g_assert_cmpfloat(fabs((t0 - AMBIENT) + (t1 - AMBIENT) - (3.0 * 60)), <, 1e-6);
+	g_assert_cmpfloat(t0, >, t1);
+	g_assert_cmpfloat(t1, >, AMBIENT + 60);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/heater_model/heat_then_cool", test_heat_then_cool);
+	g_test_add_func("/heater_model/regulating", test_regulating);
+	g_test_add_func("/heater_model/grid_zone_tau", test_grid_zone_tau);
+	g_test_add_func("/heater_model/grid_coupled_heating", test_grid_coupled_heating);
+
+	return g_test_run();
+}
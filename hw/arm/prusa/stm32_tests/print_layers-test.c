@@ -0,0 +1,223 @@
+/*
+ * Unit test for the print report's layer detection, with a scripted print
+ * on an uneven, mesh-levelled bed.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include <math.h>
+#include "../utility/p404_layer_detect.h"
+
+#define LAYERS 6
+#define LAYER_UM 200
+#define HOP_UM 400
+#define RETRACT_UM 800
+#define SEGMENT_UM 2000 // Mesh levelling splits moves into segments this long.
+
+enum { X, Y, Z, E, AXES };
+
+// Step sizes, coarser than a real printer's microsteps to keep the run short.
+static const int32_t step_um[AXES] = { 10, 10, 2, 5 };
+
+typedef struct {
+	int32_t pos[AXES];
+	int32_t retract_debt;
+	p404_layer_detect_t detect;
+	int script_layer, script_island; // Where the script is, island -1 is the purge line.
+	struct {
+		int layer, island;
+	} detected[LAYERS * 4]; // Where each detected layer started.
+	int n_detected;
+} printer_t;
+
+// A warped bed: a tilt plus two waves, about 0.3 mm peak to peak where the
+// print is, more than a layer height.
+static int32_t mesh_um(int32_t x, int32_t y)
+{
+	return (x / 500) + (int32_t)(150 * sin(x / 30000.0)) + (int32_t)(120 * cos(y / 25000.0));
+}
+
+static void step(printer_t *p, int axis, int dir)
+{
+	p->pos[axis] += dir * step_um[axis];
+	switch (axis)
+	{
+		case X:
+		case Y:
+			p404_layer_detect_xy(&p->detect);
+			break;
+		case Z:
+			p404_layer_detect_z(&p->detect, dir * step_um[Z]);
+			break;
+		case E:
+			// As the print report does: un-retracts only pay back the debt.
+			if (dir < 0)
+			{
+				p->retract_debt += step_um[E];
+			}
+			else if (p->retract_debt > 0)
+			{
+				p->retract_debt -= step_um[E];
+			}
+			else if (p404_layer_detect_extrude(&p->detect))
+			{
+				p->detected[p->n_detected].layer = p->script_layer;
+				p->detected[p->n_detected++].island = p->script_island;
+			}
+			break;
+	}
+}
+
+// A linear move, with the axes stepping interleaved the way a stepper ISR does.
+static void move_raw(printer_t *p, const int32_t target[AXES])
+{
+	int32_t n[AXES], done[AXES] = { 0 };
+	int dir[AXES];
+	int32_t ticks = 0;
+	for (int a=0; a<AXES; a++)
+	{
+		int32_t delta = target[a] - p->pos[a];
+		dir[a] = delta < 0 ? -1 : 1;
+		n[a] = abs(delta) / step_um[a];
+		ticks = MAX(ticks, n[a]);
+	}
+	for (int32_t t=1; t<=ticks; t++)
+	{
+		for (int a=0; a<AXES; a++)
+		{
+			while (done[a] < ((int64_t)n[a] * t) / ticks)
+			{
+				step(p, a, dir[a]);
+				done[a]++;
+			}
+		}
+	}
+}
+
+// A G1 move to x/y at height z above the bed, levelled by the mesh. e_um is
+// the filament to extrude on the way.
+static void move(printer_t *p, int32_t x, int32_t y, int32_t z, int32_t e_um)
+{
+	int32_t x0 = p->pos[X], y0 = p->pos[Y], e0 = p->pos[E];
+	int32_t len = (int32_t)hypot(x - x0, y - y0);
+	int segments = MAX(1, len / SEGMENT_UM);
+	for (int i=1; i<=segments; i++)
+	{
+		int32_t sx = x0 + ((int64_t)(x - x0) * i) / segments;
+		int32_t sy = y0 + ((int64_t)(y - y0) * i) / segments;
+		int32_t target[AXES] = { sx, sy, z + mesh_um(sx, sy), e0 + ((int64_t)e_um * i) / segments };
+		move_raw(p, target);
+	}
+}
+
+// Z only, at the current x/y.
+static void move_z(printer_t *p, int32_t z)
+{
+	move(p, p->pos[X], p->pos[Y], z, 0);
+}
+
+static void retract(printer_t *p, int32_t e_um)
+{
+	int32_t target[AXES] = { p->pos[X], p->pos[Y], p->pos[Z], p->pos[E] + e_um };
+	move_raw(p, target);
+}
+
+// Travel with retraction and a Z hop, landing at height z.
+static void travel(printer_t *p, int32_t x, int32_t y, int32_t z_from, int32_t z)
+{
+	retract(p, -RETRACT_UM);
+	move_z(p, MAX(z_from, z) + HOP_UM);
+	move(p, x, y, MAX(z_from, z) + HOP_UM, 0);
+	move_z(p, z);
+	retract(p, RETRACT_UM);
+}
+
+// A 20 mm square perimeter starting at x/y.
+static void island(printer_t *p, int32_t x, int32_t y, int32_t z)
+{
+	static const int32_t corners[4][2] = { {20000, 0}, {20000, 20000}, {0, 20000}, {0, 0} };
+	for (int i=0; i<4; i++)
+	{
+		move(p, x + corners[i][0], y + corners[i][1], z, 1000);
+	}
+}
+
+static void print(printer_t *p, bool lift_on_layer_change)
+{
+	// Islands spread over the bed, so travels cross the mesh's highs and lows.
+	static const int32_t islands[][2] = { {10000, 10000}, {140000, 30000}, {60000, 150000}, {150000, 160000} };
+	memset(p, 0, sizeof(*p));
+	p->script_island = -1;
+	// Purge line along the front edge, at the first layer height.
+	move_z(p, LAYER_UM);
+	move(p, 5000, 0, LAYER_UM, 0);
+	move(p, 175000, 0, LAYER_UM, 8000);
+	int32_t z = LAYER_UM;
+	for (int layer=0; layer<LAYERS; layer++)
+	{
+		p->script_layer = layer;
+		int32_t next_z = LAYER_UM * (layer + 1);
+		if (!lift_on_layer_change && layer > 0)
+		{
+			// A plain layer change: G1 Z at the end of the previous layer.
+			move_z(p, next_z);
+			z = next_z;
+		}
+		for (int i=0; i<ARRAY_SIZE(islands); i++)
+		{
+			p->script_island = i;
+			// Otherwise the first travel of the layer takes it up.
+			travel(p, islands[i][0], islands[i][1], z, next_z);
+			z = next_z;
+			island(p, islands[i][0], islands[i][1], z);
+		}
+	}
+}
+
+static void check_layers(const printer_t *p)
+{
+	g_assert_cmpint(p->n_detected, ==, LAYERS);
+	for (int i=0; i<p->n_detected; i++)
+	{
+		// Each layer starts with its first extrusion: the purge line, then the first island.
+		g_assert_cmpint(p->detected[i].layer, ==, i);
+		g_assert_cmpint(p->detected[i].island, ==, i ? 0 : -1);
+	}
+}
+
+// Layer changes as a Z move of their own, then travels with Z hops.
+static void test_uneven_mesh(void)
+{
+	printer_t p;
+	print(&p, false);
+	check_layers(&p);
+}
+
+// The layer change folded into the first hop of the layer.
+static void test_uneven_mesh_lift(void)
+{
+	printer_t p;
+	print(&p, true);
+	check_layers(&p);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/print_layers/uneven_mesh", test_uneven_mesh);
+	g_test_add_func("/print_layers/uneven_mesh_lift", test_uneven_mesh_lift);
+
+	return g_test_run();
+}
@@ -0,0 +1,123 @@
+/*
+ * QTest testcase for the P404 script console.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/units.h"
+#include "libqos/libqtest.h"
+
+#define STEP_NS (10 * 1000 * 1000)
+
+static char *make_file(const char *tmpl, const char *contents, size_t size)
+{
+	char *path = NULL;
+	int fd = g_file_open_tmp(tmpl, &path, NULL);
+	g_assert_cmpint(fd, >=, 0);
+	if (contents)
+	{
+		g_assert_cmpint(write(fd, contents, strlen(contents)), ==, strlen(contents));
+	}
+	g_assert_cmpint(ftruncate(fd, MAX(size, contents ? strlen(contents) : 0)), ==, 0);
+	close(fd);
+	return path;
+}
+
+// Steps the clock until the console has printed str, or gives up.
+static bool wait_for_output(QTestState *ts, int fd, GString *out, const char *str)
+{
+	for (int i = 0; i < 100; i++)
+	{
+		char buf[256];
+		ssize_t len;
+		while ((len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+		{
+			g_string_append_len(out, buf, len);
+		}
+		if (strstr(out->str, str))
+		{
+			return true;
+		}
+		qtest_clock_step(ts, STEP_NS);
+	}
+	return false;
+}
+
+static bool script_timer_idle(QTestState *ts)
+{
+	g_autofree char *timers = qtest_hmp(ts, "info p404-timers");
+	g_auto(GStrv) lines = g_strsplit(timers, "\n", -1);
+	for (int i = 0; lines[i] != NULL; i++)
+	{
+		if (strstr(lines[i], " scripting "))
+		{
+			return strstr(lines[i], "idle") != NULL;
+		}
+	}
+	g_assert_not_reached();
+}
+
+// A line typed after the startup script has drained (and the console timer
+// has stopped) must still be run.
+static void test_command_after_script(void)
+{
+	g_autofree char *sock = g_strdup_printf("%s/scriptcon-test-%d.sock", g_get_tmp_dir(), getpid());
+	g_autofree char *script = make_file("scriptcon-XXXXXX.txt", "ScriptHost::Log(startup)\n", 0);
+	g_autofree char *kernel = make_file("scriptcon-XXXXXX.bin", NULL, 1024);
+	g_autofree char *xflash = make_file("scriptcon-XXXXXX.xflash", NULL, 8 * MiB);
+	g_autofree char *eeprom = make_file("scriptcon-XXXXXX.eeprom", NULL, 8 * KiB);
+	g_autofree char *eeprom_sys = make_file("scriptcon-XXXXXX.eeprom", NULL, 8 * KiB);
+	int server = qtest_socket_server(sock);
+
+	QTestState *ts = qtest_initf("-machine prusa-mini -kernel %s -append script=%s "
+		"-drive if=none,id=mini404-xflash,format=raw,file=%s "
+		"-drive if=none,id=mini404-eeprom,format=raw,file=%s "
+		"-drive if=none,id=mini404-eeprom-sys,format=raw,file=%s "
+		"-chardev socket,id=p404-scriptcon,path=%s",
+		kernel, script, xflash, eeprom, eeprom_sys, sock);
+	int fd = accept(server, NULL, NULL);
+	g_assert_cmpint(fd, >=, 0);
+
+	g_autoptr(GString) out = g_string_new("");
+	g_assert_true(wait_for_output(ts, fd, out, "P404> "));
+	for (int i = 0; i < 10; i++)
+	{
+		qtest_clock_step(ts, STEP_NS);
+	}
+	g_assert_true(script_timer_idle(ts));
+
+	// An unknown command reports a syntax error once it has been run.
+	const char cmd[] = "NoSuchContext::Nothing()\r";
+	g_assert_cmpint(send(fd, cmd, strlen(cmd), 0), ==, strlen(cmd));
+	g_assert_true(wait_for_output(ts, fd, out, "Syntax/Argument Error"));
+
+	close(fd);
+	close(server);
+	qtest_quit(ts);
+	unlink(sock);
+	unlink(script);
+	unlink(kernel);
+	unlink(xflash);
+	unlink(eeprom);
+	unlink(eeprom_sys);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/scriptcon/command_after_script", test_command_after_script);
+
+    return g_test_run();
+}
@@ -0,0 +1,94 @@
+/*
+ * QTest microbenchmark for the SPI display model, fed the way the Mini
+ * firmware does it: SPI TX driven by DMA.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "libqos/libqtest.h"
+
+#include "../stm32_chips/stm32f407xx.h"
+
+#include "../stm32_common/stm32_f2xx_f4xx_dma_regdata.h"
+
+#include "stm32_bench.h"
+
+#define SPI_CR1 0x00
+#define SPI_CR2 0x04
+#define SPI_DR 0x0C
+
+#define LCD_PATH "/machine/peripheral/lcd"
+#define LCD_PIXELS (320*240) // st7789v
+#define LCD_CHUNK_PIXELS (LCD_PIXELS/3) // Fits in NDTR at 16bpp.
+#define BENCH_FRAMES 10
+
+static const stm32_soc_cfg_t* cfg = &stm32f407xx_cfg;
+
+static void lcd_byte(QTestState *ts, uint32_t spi, bool data, uint8_t value)
+{
+	qtest_set_irq_in(ts, LCD_PATH, NULL, 0, data); // C/D
+	qtest_writel(ts, spi + SPI_DR, value);
+}
+
+static void bench_fill(void)
+{
+	uint32_t base = cfg->perhipherals[STM32_P_DMA2].base_addr;
+	uint8_t ch_base = RI_CHAN_BASE + (STM32_F2xx_DMA_CHAN_REGS*3);
+	// The SoC SPI buses are all called "ssi", so find out which one the display landed on.
+	QTestState *ts = qtest_init("-machine stm32f407xE -device st7789v,id=lcd,bus=ssi");
+	QDict *rsp = qtest_qmp(ts, "{ 'execute': 'qom-get', 'arguments': "
+		"{ 'path': '" LCD_PATH "', 'property': 'parent_bus' } }");
+	int spi_n = 0;
+	g_assert_cmpint(sscanf(qdict_get_str(rsp, "return"), "/machine/soc/SPI%d", &spi_n), ==, 1);
+	qobject_unref(rsp);
+	uint32_t spi = cfg->perhipherals[STM32_P_SPI1 + spi_n - 1].base_addr;
+
+	qtest_memset(ts, cfg->sram_base, 0xF8, LCD_CHUNK_PIXELS * 2);
+	qtest_writel(ts, spi + SPI_CR1, BIT(6) | BIT(2)); // SPE, MSTR
+	qtest_set_irq_in(ts, LCD_PATH, "ssi-gpio-cs", 0, 1);
+	lcd_byte(ts, spi, false, 0x3A); // COLMOD
+	lcd_byte(ts, spi, true, 0x55);	// 16bpp
+	lcd_byte(ts, spi, false, 0x2C); // RAMWR, full screen window after reset.
+	qtest_set_irq_in(ts, LCD_PATH, NULL, 0, 1);
+
+	gint64 start = g_get_monotonic_time();
+	for (int i=0; i<BENCH_FRAMES * (LCD_PIXELS/LCD_CHUNK_PIXELS); i++)
+	{
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxM0AR), cfg->sram_base);
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxPAR), spi + SPI_DR);
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxNDTR), LCD_CHUNK_PIXELS * 2);
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxCR), BIT(10) | DMAR_M2P << 6U | BIT(0));
+		qtest_writel(ts, spi + SPI_CR2, 0);
+		qtest_writel(ts, spi + SPI_CR2, BIT(1)); // TXDMAEN
+		while (qtest_readl(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxNDTR)))
+		{
+			qtest_clock_step(ts, 1);
+		}
+	}
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	g_assert_cmpuint(stm32_bench_get_stat(ts, "/machine/soc/DMA2", "dma-beats"), ==, 2ULL * LCD_PIXELS * BENCH_FRAMES);
+	stm32_bench_report("spi_display/fill", "pixels", (uint64_t)LCD_PIXELS * BENCH_FRAMES, elapsed);
+
+	qtest_quit(ts);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	qtest_add_func("/spi_display/bench_fill", bench_fill);
+
+	return g_test_run();
+}
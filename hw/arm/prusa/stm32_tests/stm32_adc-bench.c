@@ -0,0 +1,87 @@
+/*
+ * QTest microbenchmark for the STM32F4xx ADC in scan + DMA mode.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "libqos/libqtest.h"
+
+#include "../stm32_chips/stm32f407xx.h"
+
+#include "../stm32_common/stm32_f2xx_f4xx_dma_regdata.h"
+
+#include "stm32_bench.h"
+
+#define ADC_CR1 0x04
+#define ADC_CR2 0x08
+#define ADC_SQR1 0x2C
+#define ADC_SQR2 0x30
+#define ADC_SQR3 0x34
+#define ADC_DR 0x4C
+
+#define BENCH_CHANNELS 16
+#define BENCH_VIRTUAL_NS (200 * NANOSECONDS_PER_SECOND)
+
+static const stm32_soc_cfg_t* cfg = &stm32f407xx_cfg;
+
+// ADC1 continuously scanning 16 channels into a circular DMA2 buffer, as the
+// firmware runs its thermistors. The whole run is one clock step, so this is
+// conversion + DMA cost only; conversions are counted from the DMA beats.
+static void bench_scan_dma(void)
+{
+	uint32_t adc = cfg->perhipherals[STM32_P_ADC1].base_addr;
+	uint32_t dma = cfg->perhipherals[STM32_P_DMA2].base_addr;
+	uint8_t ch_base = RI_CHAN_BASE; // Stream 0
+	QTestState *ts = qtest_init("-machine stm32f407xE");
+
+	qtest_writel(ts, cfg->perhipherals[STM32_P_RCC].base_addr + STM32_BENCH_F4_RCC_APB2ENR, BIT(8)); // ADC1EN
+
+	qtest_writel(ts, STM32_RI_ADDRESS(dma, ch_base+CH_OFF_SxM0AR), cfg->sram_base);
+	qtest_writel(ts, STM32_RI_ADDRESS(dma, ch_base+CH_OFF_SxPAR), adc + ADC_DR);
+	qtest_writel(ts, STM32_RI_ADDRESS(dma, ch_base+CH_OFF_SxNDTR), BENCH_CHANNELS);
+	// 16 bit to 16 bit, MINC, CIRC, P2M
+	qtest_writel(ts, STM32_RI_ADDRESS(dma, ch_base+CH_OFF_SxCR), BIT(13) | BIT(11) | BIT(10) | BIT(8) | DMAR_P2M << 6U | BIT(0));
+
+	for (int i=0; i<BENCH_CHANNELS; i++)
+	{
+		qtest_set_irq_in(ts, "/machine/soc/ADC1", "adc_data_in", i, 256*i);
+	}
+	qtest_writel(ts, adc + ADC_SQR3, 0 | 1 << 5 | 2 << 10 | 3 << 15 | 4 << 20 | 5 << 25);
+	qtest_writel(ts, adc + ADC_SQR2, 6 | 7 << 5 | 8 << 10 | 9 << 15 | 10 << 20 | 11 << 25);
+	qtest_writel(ts, adc + ADC_SQR1, 12 | 13 << 5 | 14 << 10 | 15 << 15 | (BENCH_CHANNELS - 1) << 20);
+	qtest_writel(ts, adc + ADC_CR1, BIT(8)); // SCAN
+	qtest_writel(ts, adc + ADC_CR2, BIT(0)); // ADON
+
+	gint64 start = g_get_monotonic_time();
+	// SWSTART, EOCS (a request per conversion), DDS, DMA, CONT, ADON
+	qtest_writel(ts, adc + ADC_CR2, BIT(30) | BIT(10) | BIT(9) | BIT(8) | BIT(1) | BIT(0));
+	qtest_clock_step(ts, BENCH_VIRTUAL_NS);
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	uint64_t conversions = stm32_bench_get_stat(ts, "/machine/soc/DMA2", "dma-beats");
+	g_assert_cmpuint(conversions, >, BENCH_CHANNELS);
+	g_assert_cmphex(qtest_readw(ts, cfg->sram_base + 2*(BENCH_CHANNELS - 1)), ==, 256*(BENCH_CHANNELS - 1));
+	stm32_bench_report("adc/scan-dma", "conversions", conversions, elapsed);
+
+	qtest_quit(ts);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	qtest_add_func("/stm32_adc/bench_scan_dma", bench_scan_dma);
+
+	return g_test_run();
+}
@@ -0,0 +1,82 @@
+/*
+ * Shared helpers for the STM32 peripheral microbenchmarks (qtests_buddy_bench).
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#ifndef STM32_BENCH_H
+#define STM32_BENCH_H
+
+#include "qapi/qmp/qdict.h"
+#include "qapi/qmp/qlist.h"
+
+// F4xx RCC clock enables, the timer and ADC models need a running clock.
+#define STM32_BENCH_F4_RCC_APB1ENR 0x40
+#define STM32_BENCH_F4_RCC_APB2ENR 0x44
+
+/*
+ * Every result is printed as a TAP comment holding one JSON object:
+ *
+ *   # {"bench":"dma/spi-m2p","unit":"beats","count":655350,"host_us":81234,"per_sec":8067606}
+ *
+ * and, if $P404_BENCH_JSON names a file, appended to it as one object per
+ * line so runs can be collected and compared. Numbers are host time, so
+ * only compare runs from the same host.
+ */
+static inline void stm32_bench_report(const char *name, const char *unit, uint64_t count, gint64 host_us)
+{
+	host_us = MAX(host_us, 1);
+	g_autofree char *json = g_strdup_printf(
+		"{\"bench\":\"%s\",\"unit\":\"%s\",\"count\":%" PRIu64 ",\"host_us\":%" PRId64 ",\"per_sec\":%.0f}",
+		name, unit, count, host_us, (count * 1e6) / host_us);
+	printf("# %s\n", json);
+	const char *file = g_getenv("P404_BENCH_JSON");
+	if (file != NULL)
+	{
+		FILE *out = fopen(file, "a");
+		if (out != NULL)
+		{
+			fprintf(out, "%s\n", json);
+			fclose(out);
+		}
+	}
+}
+
+// Reads one of the query-p404-stats counters, e.g. ("/machine/soc/DMA2", "dma-beats").
+static inline uint64_t stm32_bench_get_stat(QTestState *ts, const char *path, const char *counter)
+{
+	uint64_t count = 0;
+	QDict *rsp = qtest_qmp(ts, "{ 'execute': 'query-p404-stats' }");
+	QList *devices = qdict_get_qlist(qdict_get_qdict(rsp, "return"), "devices");
+	for (const QListEntry *d = qlist_first(devices); d; d = qlist_next(d))
+	{
+		QDict *dev = qobject_to(QDict, qlist_entry_obj(d));
+		if (strcmp(qdict_get_str(dev, "path"), path))
+		{
+			continue;
+		}
+		QList *counters = qdict_get_qlist(dev, "counters");
+		for (const QListEntry *c = qlist_first(counters); c; c = qlist_next(c))
+		{
+			QDict *ctr = qobject_to(QDict, qlist_entry_obj(c));
+			if (!strcmp(qdict_get_str(ctr, "name"), counter))
+			{
+				count = qdict_get_int(ctr, "count");
+			}
+		}
+	}
+	qobject_unref(rsp);
+	return count;
+}
+
+#endif // STM32_BENCH_H
@@ -19,6 +19,7 @@
 
 #include "../stm32_chips/stm32f030xx.h"
 #include "../stm32_common/stm32_crc_regdata.h"
+#include "../stm32_common/stm32_crc.h"
 
 static void test_storage_idr(void)
 {
@@ -72,6 +73,32 @@ static void test_dr_reset(void)
 
 }
 
+// The bulk (slice-by-8) kernel must agree with feeding DR one word at a time.
+static void test_bulk_kernel(void)
+{
+	static stm32_crc_tables_t tables;
+	uint32_t base = stm32f030xx_cfg.perhipherals[STM32_P_CRC].base_addr;
+	uint8_t buf[4*37];
+	stm32_crc_build_tables(tables);
+	writel(STM32_RI_ADDRESS(stm32f030xx_cfg.perhipherals[STM32_P_RCC].base_addr, 5), 64); // Enable the CRC peripheral's clock
+
+	g_assert_cmphex(stm32_crc_word(tables, UINT32_MAX, 0xDEADBEEF), ==, 0x81da1a18);
+
+	for (int i=0; i<sizeof(buf); i++)
+	{
+		buf[i] = (i * 151U) ^ (i >> 3);
+	}
+	for (int n=0; n<=37; n++)
+	{
+		writel(STM32_RI_ADDRESS(base, RI_INIT) , 0xFFFFFFFF);
+		for (int i=0; i<n; i++)
+		{
+			writel(STM32_RI_ADDRESS(base, RI_DR), ldl_le_p(&buf[4*i]));
+		}
+		g_assert_cmphex(stm32_crc_words(tables, UINT32_MAX, buf, n), ==, readl(STM32_RI_ADDRESS(base, RI_DR)));
+	}
+}
+
 int main(int argc, char **argv)
 {
     int ret;
@@ -86,6 +113,7 @@ int main(int argc, char **argv)
 
     qtest_add_func("/stm32_crc/storage_idr", test_storage_idr);
     qtest_add_func("/stm32_crc/dr_reset", test_dr_reset);
+    qtest_add_func("/stm32_crc/bulk_kernel", test_bulk_kernel);
 
     qtest_start("-machine stm32f030x4");
 
@@ -0,0 +1,79 @@
+/*
+ * QTest microbenchmark for the STM32 F2xx/F4xx DMA module.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "libqos/libqtest.h"
+
+#include "../stm32_chips/stm32f407xx.h"
+
+#include "../stm32_common/stm32_f2xx_f4xx_dma_regdata.h"
+
+#include "stm32_bench.h"
+
+#define SPI_CR1 0x00
+#define SPI_CR2 0x04
+#define SPI_DR 0x0C
+
+#define BENCH_BEATS 0xFFFFU // Max NDTR
+#define BENCH_ROUNDS 20
+
+static const stm32_soc_cfg_t* cfg = &stm32f407xx_cfg;
+
+// M2P stream paced by SPI1 TXE with nothing on the bus. Once kicked off, each
+// beat's DR write raises the next request, so the whole transfer runs inside
+// QEMU with no qtest round-trips - this is the DMA beat path on its own.
+static void bench_spi_m2p(void)
+{
+	uint32_t base = cfg->perhipherals[STM32_P_DMA2].base_addr;
+	uint32_t spi = cfg->perhipherals[STM32_P_SPI1].base_addr;
+	uint8_t ch_base = RI_CHAN_BASE + (STM32_F2xx_DMA_CHAN_REGS*3);
+	QTestState *ts = qtest_init("-machine stm32f407xE");
+
+	qtest_memset(ts, cfg->sram_base, 0xA5, BENCH_BEATS);
+	qtest_writel(ts, spi + SPI_CR1, BIT(6) | BIT(2)); // SPE, MSTR
+
+	gint64 start = g_get_monotonic_time();
+	for (int i=0; i<BENCH_ROUNDS; i++)
+	{
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxM0AR), cfg->sram_base);
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxPAR), spi + SPI_DR);
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxNDTR), BENCH_BEATS);
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxCR), BIT(10) | DMAR_M2P << 6U | BIT(0));
+		// TXDMAEN rising edge makes the first request.
+		qtest_writel(ts, spi + SPI_CR2, 0);
+		qtest_writel(ts, spi + SPI_CR2, BIT(1));
+		while (qtest_readl(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxNDTR)))
+		{
+			qtest_clock_step(ts, 1);
+		}
+	}
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	g_assert_cmphex(qtest_readl(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxCR)) & BIT(0), ==, 0);
+	g_assert_cmpuint(stm32_bench_get_stat(ts, "/machine/soc/DMA2", "dma-beats"), ==, (uint64_t)BENCH_BEATS * BENCH_ROUNDS);
+	stm32_bench_report("dma/spi-m2p", "beats", (uint64_t)BENCH_BEATS * BENCH_ROUNDS, elapsed);
+
+	qtest_quit(ts);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	qtest_add_func("/stm32_dma/bench_spi_m2p", bench_spi_m2p);
+
+	return g_test_run();
+}
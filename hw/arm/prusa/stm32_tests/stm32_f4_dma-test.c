@@ -402,6 +402,43 @@ static void test_circ(void)
 	qtest_quit(ts);
 }
 
+#define BENCH_REQUESTS 100000
+
+// Microbenchmark for the DMAR request path: all streams enabled (as busy
+// firmware would have them), requests aimed at the last one. Most of the
+// time is qtest round-trips, so compare numbers from the same host only.
+static void test_bench_dmar(void)
+{
+	uint32_t base = stm32f407xx_cfg.perhipherals[STM32_P_DMA1].base_addr;
+	uint32_t sram = stm32f407xx_cfg.sram_base;
+	QTestState *ts = qtest_init("-machine stm32f407xE");
+	mem_data(ts);
+
+	for (int i=0; i<STM32_F2xx_DMA_MAX_CHAN; i++)
+	{
+		uint8_t ch_base = RI_CHAN_BASE + (STM32_F2xx_DMA_CHAN_REGS*i);
+		bool last = i == (STM32_F2xx_DMA_MAX_CHAN - 1);
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxM0AR), sram );
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxPAR), sram + (last ? 0x100 : 0x200 + (4*i)));
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxNDTR), 10);
+		qtest_writel(ts, STM32_RI_ADDRESS(base, ch_base+CH_OFF_SxCR), BIT(8) | (last ? DMAR_M2P : DMAR_P2M) << 6U | BIT(0));
+	}
+
+	gint64 start = g_get_monotonic_time();
+	for (int i=0; i<BENCH_REQUESTS; i++)
+	{
+		qtest_set_irq_in(ts, "/machine/soc/DMA1", "dmar-in", DMAR_M2P, sram + 0x100);
+	}
+	gint64 elapsed = MAX(g_get_monotonic_time() - start, 1);
+
+	g_assert_cmphex(qtest_readl(ts, sram + 0x100), ==, 0x01);
+	g_assert_cmpint(qtest_readl(ts, STM32_RI_ADDRESS(base, RI_CHAN8+CH_OFF_SxNDTR)), ==, 10 - (BENCH_REQUESTS % 10));
+	printf("# %d DMA requests in %" PRId64 " us, %.0f requests/s\n", BENCH_REQUESTS, elapsed,
+		(BENCH_REQUESTS * 1e6) / elapsed);
+
+	qtest_quit(ts);
+}
+
 
 int main(int argc, char **argv)
 {
@@ -423,6 +460,10 @@ int main(int argc, char **argv)
 	qtest_add_data_func("/stm32_dma/test_irq_ch6", (void *)(intptr_t)5, test_irqs);
 	qtest_add_data_func("/stm32_dma/test_irq_ch7", (void *)(intptr_t)6, test_irqs);
 	qtest_add_data_func("/stm32_dma/test_irq_ch8", (void *)(intptr_t)7, test_irqs);
+	if (g_test_perf())
+	{
+		qtest_add_func("/stm32_dma/bench_dmar", test_bench_dmar);
+	}
 
     ret = g_test_run();
 
@@ -0,0 +1,56 @@
+/*
+ * QTest microbenchmark for STM32 GPIO output toggling.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "libqos/libqtest.h"
+
+#include "../stm32_chips/stm32f407xx.h"
+#include "../stm32_common/stm32_gpio_regdata.h"
+
+#include "stm32_bench.h"
+
+#define BENCH_TOGGLES 200000
+
+// ODR writes with the pins connected (intercepted), so each toggle goes all
+// the way out of the GPIO model. One qtest round-trip per toggle, so compare
+// numbers from the same host only.
+static void bench_odr(void)
+{
+	uint32_t base = stm32f407xx_cfg.perhipherals[STM32_P_GPIOA].base_addr;
+	QTestState *ts = qtest_init("-machine stm32f407xE");
+	qtest_irq_intercept_out(ts, "/machine/soc/GPIOA");
+
+	gint64 start = g_get_monotonic_time();
+	for (int i=0; i<BENCH_TOGGLES; i++)
+	{
+		qtest_writel(ts, STM32_RI_ADDRESS(base, RI_ODR), (i & 1) ? 0 : 0x5555);
+	}
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	g_assert_cmphex(qtest_readl(ts, STM32_RI_ADDRESS(base, RI_ODR)), ==, (BENCH_TOGGLES & 1) ? 0x5555 : 0);
+	stm32_bench_report("gpio/odr", "toggles", BENCH_TOGGLES, elapsed);
+
+	qtest_quit(ts);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	qtest_add_func("/stm32_gpio/bench_odr", bench_odr);
+
+	return g_test_run();
+}
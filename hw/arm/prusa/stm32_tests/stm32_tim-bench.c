@@ -0,0 +1,71 @@
+/*
+ * QTest microbenchmark for STM32F4xx timer compare (CCR) events.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "libqos/libqtest.h"
+
+#include "../stm32_chips/stm32f407xx.h"
+
+#include "stm32_bench.h"
+
+#define TIM_CR1 0x00
+#define TIM_DIER 0x0C
+#define TIM_SR 0x10
+#define TIM_ARR 0x2C
+#define TIM_CCR1 0x34
+
+#define BENCH_EVENTS 50000
+
+static const stm32_soc_cfg_t* cfg = &stm32f407xx_cfg;
+
+// The step generator pattern: CCR1 is moved ahead, the compare fires, the
+// handler clears CC1IF. Three qtest round-trips per event, so compare
+// numbers from the same host only.
+static void bench_ccr(void)
+{
+	uint32_t base = cfg->perhipherals[STM32_P_TIM2].base_addr;
+	QTestState *ts = qtest_init("-machine stm32f407xE");
+	qtest_irq_intercept_out_named(ts, "/machine/soc/TIM2", "sysbus-irq");
+
+	qtest_writel(ts, cfg->perhipherals[STM32_P_RCC].base_addr + STM32_BENCH_F4_RCC_APB1ENR, BIT(0)); // TIM2EN
+	qtest_writel(ts, base + TIM_ARR, UINT32_MAX);
+	qtest_writel(ts, base + TIM_DIER, BIT(1)); // CC1IE, channel 1 frozen output by default.
+	qtest_writel(ts, base + TIM_CR1, BIT(0));
+
+	gint64 start = g_get_monotonic_time();
+	for (int i=0; i<BENCH_EVENTS; i++)
+	{
+		qtest_writel(ts, base + TIM_CCR1, 100 + (i & 1)); // Must change to re-arm.
+		qtest_clock_step_next(ts);
+		g_assert_true(qtest_get_irq(ts, 0));
+		qtest_writel(ts, base + TIM_SR, ~(uint32_t)BIT(1));
+	}
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	g_assert_false(qtest_get_irq(ts, 0));
+	stm32_bench_report("tim/ccr", "events", BENCH_EVENTS, elapsed);
+
+	qtest_quit(ts);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	qtest_add_func("/stm32_tim/bench_ccr", bench_ccr);
+
+	return g_test_run();
+}
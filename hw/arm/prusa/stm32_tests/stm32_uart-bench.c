@@ -0,0 +1,59 @@
+/*
+ * QTest microbenchmark for the STM32 USART receive path.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+#include "libqos/libqtest.h"
+
+#include "../stm32_chips/stm32g070xx.h"
+#include "../stm32_common/stm32_usart_regdata.h"
+
+#include "stm32_bench.h"
+
+#define BENCH_BYTES 100000
+
+// Bytes come in on byte-in (as from another modelled part) and are read out
+// of RDR. No baud rate is set so there is no receive delay beyond a 1ns step.
+// Three qtest round-trips per byte, so compare numbers from the same host only.
+static void bench_rx(void)
+{
+	uint32_t base = stm32g070xx_cfg.perhipherals[STM32_P_UART1].base_addr;
+	QTestState *ts = qtest_init("-machine stm32g070xB");
+
+	qtest_writel(ts, STM32_RI_ADDRESS(base, RI_CR1), BIT(0) | BIT(2)); // UE, RE
+
+	gint64 start = g_get_monotonic_time();
+	for (int i=0; i<BENCH_BYTES; i++)
+	{
+		qtest_set_irq_in(ts, "/machine/soc/UART1", "byte-in", 0, i & 0xFF);
+		g_assert_cmphex(qtest_readl(ts, STM32_RI_ADDRESS(base, RI_RDR)), ==, i & 0xFF);
+		qtest_clock_step(ts, 1);
+	}
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	g_assert_cmpuint(stm32_bench_get_stat(ts, "/machine/soc/UART1", "chardev-bytes"), ==, BENCH_BYTES);
+	stm32_bench_report("usart/rx", "bytes", BENCH_BYTES, elapsed);
+
+	qtest_quit(ts);
+}
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	qtest_add_func("/stm32_uart/bench_rx", bench_rx);
+
+	return g_test_run();
+}
@@ -0,0 +1,295 @@
+/*
+ * Unit test for the precomputed thermistor conversion tables.
+ *
+ * Copyright 2023 VintagePC <https://github.com/vintagepc>
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the
+ * Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details.
+ */
+
+#include "qemu/osdep.h"
+
+#include "../parts/thermistor_table_list.h"
+#include "../parts/thermistor_lut.h"
+
+// What the thermistor does on a read request, without the oversampling shift.
+static bool lut_convert(uint16_t index, float value, int32_t *adc)
+{
+	static thermistor_lut_t luts[ARRAY_SIZE(thermistor_tables)];
+	const thermistor_table_def_t *def = thermistor_table_find(index);
+	g_assert_nonnull(def);
+	thermistor_lut_t *lut = &luts[def - thermistor_tables];
+	if (lut->adc == NULL)
+	{
+		thermistor_lut_build_table(lut, def->table, def->length);
+	}
+	if (thermistor_lut_lookup(lut, value, adc))
+	{
+		return *adc != INT32_MIN;
+	}
+	if (value < lut->min_temp)
+	{
+		return false;
+	}
+	*adc = lut->adc[lut->count - 1];
+	return true;
+}
+
+// The rest of this file is reference data. It was captured from the table walk
+// in thermistor.c before the LUTs (and the exp() map for the modular bed), so a
+// change to both the LUT and thermistor_lut_interpolate() still shows up here.
+
+typedef struct {
+	uint16_t table;
+	float temp;
+	int32_t adc;
+} thermistor_ref_t;
+
+// Table entries, 0.1C LUT steps, and temperatures above each table (hottest entry).
+static const thermistor_ref_t grid_refs[] = {
+	{ 1, 0.00f, 16128 },
+	{ 1, 25.00f, 15632 },
+	{ 1, 60.00f, 13712 },
+	{ 1, 60.10f, 13703 },
+	{ 1, 85.00f, 11232 },
+	{ 1, 99.90f, 9467 },
+	{ 1, 215.00f, 1344 },
+	{ 1, 290.00f, 432 },
+	{ 5, 0.00f, 16160 },
+	{ 5, 25.00f, 15616 },
+	{ 5, 60.00f, 13536 },
+	{ 5, 60.10f, 13526 },
+	{ 5, 85.00f, 10784 },
+	{ 5, 99.90f, 8876 },
+	{ 5, 215.00f, 1072 },
+	{ 5, 290.00f, 320 },
+	{ 2000, 0.00f, 16192 },
+	{ 2000, 25.00f, 15648 },
+	{ 2000, 60.00f, 13328 },
+	{ 2000, 60.10f, 13317 },
+	{ 2000, 85.00f, 10208 },
+	{ 2000, 99.90f, 8109 },
+	{ 2004, 0.00f, 16160 },
+	{ 2004, 25.00f, 15624 },
+	{ 2004, 60.00f, 13504 },
+	{ 2004, 60.10f, 13493 },
+	{ 2004, 85.00f, 10656 },
+	{ 2004, 99.90f, 8701 },
+	{ 2005, 0.00f, 16320 },
+	{ 2005, 25.00f, 16208 },
+	{ 2005, 60.00f, 15664 },
+	{ 2005, 60.10f, 15660 },
+	{ 2005, 85.00f, 14752 },
+	{ 2005, 99.90f, 13877 },
+	{ 2005, 215.00f, 4104 },
+	{ 2005, 290.00f, 1440 },
+	{ 21, 0.00f, 160 },
+	{ 21, 25.00f, 1240 },
+	{ 21, 60.00f, 2753 },
+	{ 21, 60.10f, 2757 },
+	{ 21, 85.00f, 3834 },
+	{ 21, 99.90f, 4478 },
+	{ 21, 215.00f, 8423 },
+	{ 21, 290.00f, 10815 },
+	{ 22, 0.00f, 896 },
+	{ 22, 25.00f, 4604 },
+	{ 22, 60.00f, 9795 },
+	{ 22, 60.10f, 9810 },
+	{ 22, 85.00f, 13503 },
+	{ 22, 99.90f, 15713 },
+	{ 2006, 0.00f, 64656 },
+	{ 2006, 25.00f, 62448 },
+	{ 2006, 60.00f, 52256 },
+	{ 2006, 60.10f, 52215 },
+	{ 2006, 85.00f, 38752 },
+	{ 2006, 99.90f, 30168 },
+	{ 2007, 0.00f, 65424 },
+	{ 2007, 25.00f, 65312 },
+	{ 2007, 60.00f, 64256 },
+	{ 2007, 60.10f, 64253 },
+	{ 2007, 85.00f, 62576 },
+	{ 2007, 99.90f, 60813 },
+	{ 2007, 215.00f, 33424 },
+	{ 2007, 290.00f, 0 },
+	{ 2008, 25.00f, 12828 },
+	{ 2008, 60.00f, 14678 },
+	{ 2008, 60.10f, 14683 },
+	{ 2008, 85.00f, 15996 },
+	{ 2008, 99.90f, 16785 },
+	{ 2008, 215.00f, 22860 },
+	{ 2008, 290.00f, 26822 },
+	{ 1, 800.00f, 368 },
+	{ 5, 800.00f, 16 },
+	{ 2000, 800.00f, 5008 },
+	{ 2004, 800.00f, 5664 },
+	{ 2005, 800.00f, 800 },
+	{ 21, 800.00f, 15920 },
+	{ 22, 800.00f, 15728 },
+	{ 2006, 800.00f, 0 },
+	{ 2007, 800.00f, 0 },
+	{ 2008, 800.00f, 53751 },
+};
+
+typedef struct {
+	uint16_t table;
+	float temp;
+	int32_t adc_below, adc_above; // Reference at temp -/+ 0.05C.
+} thermistor_between_ref_t;
+
+// Off the 0.1C grid the LUT answers with the nearest step, so the reading has to
+// land between the reference readings half a step either side.
+static const thermistor_between_ref_t between_refs[] = {
+	{ 1, 25.37f, 15620, 15617 },
+	{ 1, 60.23f, 13696, 13687 },
+	{ 1, 110.37f, 8219, 8207 },
+	{ 1, 215.04f, 1344, 1342 },
+	{ 1, 237.73f, 933, 931 },
+	{ 5, 25.37f, 15605, 15602 },
+	{ 5, 60.23f, 13518, 13508 },
+	{ 5, 110.37f, 7578, 7566 },
+	{ 5, 215.04f, 1072, 1070 },
+	{ 5, 237.73f, 717, 716 },
+	{ 2000, 25.37f, 15635, 15631 },
+	{ 2000, 60.23f, 13308, 13297 },
+	{ 2000, 110.37f, 6712, 6699 },
+	{ 2004, 25.37f, 15613, 15609 },
+	{ 2004, 60.23f, 13485, 13475 },
+	{ 2004, 110.37f, 7369, 7356 },
+	{ 2005, 25.37f, 16204, 16203 },
+	{ 2005, 60.23f, 15657, 15654 },
+	{ 2005, 110.37f, 13079, 13071 },
+	{ 2005, 215.04f, 4104, 4098 },
+	{ 2005, 237.73f, 2957, 2952 },
+	{ 21, 25.37f, 1254, 1258 },
+	{ 21, 60.23f, 2761, 2765 },
+	{ 21, 110.37f, 4928, 4932 },
+	{ 21, 215.04f, 8422, 8425 },
+	{ 21, 237.73f, 9146, 9149 },
+	{ 22, 25.37f, 4651, 4666 },
+	{ 22, 60.23f, 9821, 9836 },
+	{ 2006, 25.37f, 62397, 62381 },
+	{ 2006, 60.23f, 52182, 52140 },
+	{ 2006, 110.37f, 24284, 24228 },
+	{ 2007, 25.37f, 65307, 65306 },
+	{ 2007, 60.23f, 64251, 64248 },
+	{ 2007, 110.37f, 59299, 59280 },
+	{ 2007, 215.04f, 33427, 33404 },
+	{ 2007, 237.73f, 29064, 29046 },
+	{ 2008, 25.37f, 12846, 12851 },
+	{ 2008, 60.23f, 14687, 14692 },
+	{ 2008, 110.37f, 17334, 17339 },
+	{ 2008, 215.04f, 22860, 22865 },
+	{ 2008, 237.73f, 24062, 24068 },
+};
+
+typedef struct {
+	float temp;
+	int32_t adc;
+} modbed_ref_t;
+
+// Includes one point either side of the LUT range, which is computed directly.
+static const modbed_ref_t modbed_grid_refs[] = {
+	{ -41.00f, 4092 },
+	{ -40.00f, 4092 },
+	{ 18.00f, 3966 },
+	{ 25.00f, 3911 },
+	{ 60.00f, 3314 },
+	{ 100.00f, 2021 },
+	{ 399.90f, 16 },
+	{ 401.00f, 16 },
+};
+
+typedef struct {
+	float temp;
+	int32_t adc_below, adc_above;
+} modbed_between_ref_t;
+
+static const modbed_between_ref_t modbed_between_refs[] = {
+	{ 25.37f, 3908, 3907 },
+	{ 60.23f, 3309, 3307 },
+	{ 110.37f, 1687, 1684 },
+	{ 215.04f, 211, 210 },
+};
+
+static void test_grid_points(void)
+{
+	for (int i=0; i<ARRAY_SIZE(grid_refs); i++)
+	{
+		int32_t adc = 0;
+		g_assert_true(lut_convert(grid_refs[i].table, grid_refs[i].temp, &adc));
+		// The LUT's own 0.1C steps may round differently in the last bit of the float.
+		g_assert_cmpint(abs(adc - grid_refs[i].adc), <=, 1);
+	}
+}
+
+static void test_between_points(void)
+{
+	for (int i=0; i<ARRAY_SIZE(between_refs); i++)
+	{
+		const thermistor_between_ref_t *ref = &between_refs[i];
+		int32_t adc = 0;
+		g_assert_true(lut_convert(ref->table, ref->temp, &adc));
+		g_assert_cmpint(adc, >=, MIN(ref->adc_below, ref->adc_above) - 1);
+		g_assert_cmpint(adc, <=, MAX(ref->adc_below, ref->adc_above) + 1);
+	}
+}
+
+static void test_below_table(void)
+{
+	int32_t adc;
+	for (int t=0; t<ARRAY_SIZE(thermistor_tables); t++)
+	{
+		g_assert_false(lut_convert(thermistor_tables[t].index, -45.f, &adc));
+	}
+}
+
+// What the thermistor does for the modular bed map.
+static int32_t modbed_convert(float value)
+{
+	static thermistor_lut_t lut;
+	int32_t adc;
+	if (lut.adc == NULL)
+	{
+		thermistor_lut_build_modbed(&lut);
+	}
+	if (!thermistor_lut_lookup(&lut, value, &adc))
+	{
+		adc = thermistor_lut_modbed(value);
+	}
+	return adc;
+}
+
+static void test_modbed(void)
+{
+	for (int i=0; i<ARRAY_SIZE(modbed_grid_refs); i++)
+	{
+		g_assert_cmpint(abs(modbed_convert(modbed_grid_refs[i].temp) - modbed_grid_refs[i].adc), <=, 1);
+	}
+	for (int i=0; i<ARRAY_SIZE(modbed_between_refs); i++)
+	{
+		const modbed_between_ref_t *ref = &modbed_between_refs[i];
+		int32_t adc = modbed_convert(ref->temp);
+		g_assert_cmpint(adc, >=, MIN(ref->adc_below, ref->adc_above) - 1);
+		g_assert_cmpint(adc, <=, MAX(ref->adc_below, ref->adc_above) + 1);
+	}
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions();
+
+    g_test_add_func("/thermistor_lut/grid_points", test_grid_points);
+    g_test_add_func("/thermistor_lut/between_points", test_between_points);
+    g_test_add_func("/thermistor_lut/below_table", test_below_table);
+    g_test_add_func("/thermistor_lut/modbed", test_modbed);
+
+    return g_test_run();
+}
@@ -34,8 +34,10 @@
 #include "qemu/bcd.h"
 #include "qemu/units.h"
 #include "qemu/cutils.h"
+#include "hw/qdev-properties.h"
 #include "../stm32_common/stm32_shared.h"
 #include "../utility/macros.h"
+#include "trace.h"
 
 //#include "hw/arm/stm32.h"
 
@@ -53,6 +55,28 @@
 // Update target date and time from the host
 static void f2xx_update_current_date_and_time(void *arg);
 
+// Current "host" time in microseconds. With virtual-clock set this is the host
+// epoch captured at realize plus elapsed QEMU_CLOCK_VIRTUAL time, so the calendar
+// stays consistent with the rest of the machine when running faster/slower than real time.
+static int64_t
+f2xx_rtc_now_us(f2xx_rtc *s)
+{
+    if (s->virtual_clock) {
+        return s->virt_epoch_us + qemu_clock_get_us(QEMU_CLOCK_VIRTUAL);
+    }
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + (tv.tv_usec);
+}
+
+// The per-tick timer is only needed to evaluate alarms in virtual-clock mode,
+// calendar registers are brought up to date lazily on reads.
+static bool
+f2xx_rtc_needs_tick(f2xx_rtc *s)
+{
+    return !s->virtual_clock || (s->regs[R_RTC_CR] & (3U << R_RTC_CR_ALRAE_BIT));
+}
+
 
 // Compute the period for the clock (seconds increments) in nanoseconds
 static uint64_t
@@ -133,9 +157,7 @@ f2xx_rtc_compute_target_time_from_host_time(f2xx_rtc *s, uint64_t rtc_period_ns,
                                             struct tm *target_tm)
 {
     // Get the host time in microseconds
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int64_t host_time_us = tv.tv_sec * 1000000LL + (tv.tv_usec);
+    int64_t host_time_us = f2xx_rtc_now_us(s);
 
     // Compute the target time by adding the offset
     int64_t target_time_us = host_time_us + s->host_to_target_offset_us;
@@ -194,9 +216,7 @@ f2xx_rtc_compute_host_to_target_offset(f2xx_rtc *s, int64_t period_ns, uint64_t
     int64_t target_time_us = target_ticks * period_ns / 1000;
 
     // Get the host time in microseconds
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int64_t host_time_us = tv.tv_sec * 1000000LL + (tv.tv_usec);
+    int64_t host_time_us = f2xx_rtc_now_us(s);
 
     // Get the host to target offset in micro seconds
     return target_time_us - host_time_us;
@@ -246,9 +266,7 @@ f2xx_rtc_read(void *arg, hwaddr addr, unsigned int size)
         uint64_t full_cycle_us = f2xx_clock_period_ns(s) / 1000;
 
         // What fraction of a full cycle are we in?
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
-        int64_t host_time_us = tv.tv_sec * 1000000LL + (tv.tv_usec);
+        int64_t host_time_us = f2xx_rtc_now_us(s);
         host_time_us += s->host_to_target_offset_us;
 
         int64_t host_mod = host_time_us % full_cycle_us;
@@ -285,6 +303,7 @@ f2xx_rtc_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
     int offset = addr & 0x3;
     bool    compute_new_target_offset = false;
     bool    update_wut = false;
+    bool    update_alarms = false;
 
     DPRINTF("%s: addr: 0x%llx, data: 0x%lx, size: %u\n", __func__, addr, data, size);
 
@@ -343,6 +362,9 @@ f2xx_rtc_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
         if ((data & R_RTC_CR_WUTE) != (s->regs[R_RTC_CR] & R_RTC_CR_WUTE)) {
             update_wut = true;
         }
+        if ((data ^ s->regs[R_RTC_CR]) & (3U << R_RTC_CR_ALRAE_BIT)) {
+            update_alarms = true;
+        }
         break;
     case R_RTC_ISR:
         if ((data & 1<<8) == 0 && (s->regs[R_RTC_ISR] & 1<<8) != 0) {
@@ -404,13 +426,21 @@ f2xx_rtc_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
         if (s->regs[R_RTC_CR] & R_RTC_CR_WUTE) {
             int64_t elapsed = f2xx_wut_period_ns(s, s->regs[R_RTC_WUTR]);
             DPRINTF("%s: scheduling WUT to fire in %f ms\n", __func__, (float)elapsed/1000000.0);
-            timer_mod(s->wu_timer, qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + elapsed);
+            timer_mod(s->wu_timer, qemu_clock_get_ns(s->wut_clock) + elapsed);
         } else {
             DPRINTF("%s: Cancelling WUT\n", __func__);
             qemu_set_irq(s->wut_irq, 0);
             timer_del(s->wu_timer);
         }
     }
+
+    // Catch up to now before alarm checking starts/stops.
+    if (update_alarms) {
+        f2xx_update_current_date_and_time(s);
+        if (!f2xx_rtc_needs_tick(s)) {
+            timer_del(s->timer);
+        }
+    }
 }
 
 
@@ -485,8 +515,8 @@ f2xx_update_current_date_and_time(void *arg)
     int delta = new_target_ticks - s->ticks;
     //DPRINTF("%s: advancing target by %d ticks\n", __func__, delta);
     if (delta < 0 || delta > 1000) {
-        printf("DEBUG_STM32F2XX_RTC %s: detected %d mismatch between host and target ticks, "
-              "jamming new host time into RTC without checking for alarms\n", __func__, delta);
+        // Expected in virtual-clock mode, where reads can be far apart when no alarm is armed.
+        trace_stm32f2xx_rtc_resync(delta, s->virtual_clock);
         s->ticks = new_target_ticks;
         f2xx_rtc_set_time_and_date_registers(s, &new_target_tm);
     } else {
@@ -502,7 +532,9 @@ f2xx_update_current_date_and_time(void *arg)
     }
 
     // Reschedule tick timer to run one tick from now to check for alarms again
-    timer_mod(s->timer, qemu_clock_get_ns(QEMU_CLOCK_HOST) + period_ns);
+    if (f2xx_rtc_needs_tick(s)) {
+        timer_mod(s->timer, qemu_clock_get_ns(s->tick_clock) + period_ns);
+    }
 }
 
 
@@ -543,7 +575,7 @@ f2xx_wu_timer(void *arg)
 
     // Reschedule again
     int64_t elapsed = f2xx_wut_period_ns(s, s->regs[R_RTC_WUTR]);
-    timer_mod(s->wu_timer, qemu_clock_get_ns(QEMU_CLOCK_REALTIME) + elapsed);
+    timer_mod(s->wu_timer, qemu_clock_get_ns(s->wut_clock) + elapsed);
 }
 
 
@@ -591,10 +623,28 @@ f2xx_rtc_init(Object *obj)
     s->regs[R_RTC_ISR] = R_RTC_ISR_RESET;
     s->regs[R_RTC_PRER] = R_RTC_PRER_RESET;
     s->regs[R_RTC_WUTR] = R_RTC_WUTR_RESET;
+}
+
+static void
+f2xx_rtc_realize(DeviceState *dev, Error **errp)
+{
+    f2xx_rtc *s = STM32F2XX_RTC(dev);
 
     uint32_t period_ns = f2xx_clock_period_ns(s);
     DPRINTF("%s: period: %u ns\n", __func__, period_ns);
 
+    if (s->virtual_clock) {
+        // Anchor virtual time to the host epoch once, everything after that advances with the VM.
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        s->virt_epoch_us = (tv.tv_sec * 1000000LL + tv.tv_usec) - qemu_clock_get_us(QEMU_CLOCK_VIRTUAL);
+        s->tick_clock = QEMU_CLOCK_VIRTUAL;
+        s->wut_clock = QEMU_CLOCK_VIRTUAL;
+    } else {
+        s->tick_clock = QEMU_CLOCK_HOST;
+        s->wut_clock = QEMU_CLOCK_REALTIME;
+    }
+
     // Init the time and date registers from the time on the host as the default
     s->host_to_target_offset_us = 0;
     struct tm now;
@@ -608,15 +658,22 @@ f2xx_rtc_init(Object *obj)
     s->host_to_target_offset_us = f2xx_rtc_compute_host_to_target_offset(s,
                                         f2xx_clock_period_ns(s), s->ticks);
 
-    s->timer = timer_new_ns(QEMU_CLOCK_HOST, f2xx_timer, s);
-    timer_mod(s->timer, qemu_clock_get_ns(QEMU_CLOCK_HOST) + period_ns);
+    s->timer = timer_new_ns(s->tick_clock, f2xx_timer, s);
+    if (f2xx_rtc_needs_tick(s)) {
+        timer_mod(s->timer, qemu_clock_get_ns(s->tick_clock) + period_ns);
+    }
 
-    s->wu_timer = timer_new_ns(QEMU_CLOCK_REALTIME, f2xx_wu_timer, s);
+    s->wu_timer = timer_new_ns(s->wut_clock, f2xx_wu_timer, s);
 }
 
+static Property f2xx_rtc_properties[] = {
+    DEFINE_PROP_BOOL("virtual-clock", f2xx_rtc, virtual_clock, false),
+    DEFINE_PROP_END_OF_LIST(),
+};
+
 static const VMStateDescription vmstate_stm32f2xx_rtc = {
     .name = TYPE_STM32F2XX_RTC,
-    .version_id = 1,
+    .version_id = 2,
     .minimum_version_id = 1,
     .fields = (VMStateField[]) {
         VMSTATE_TIMER_PTR(timer,f2xx_rtc),
@@ -625,6 +682,7 @@ static const VMStateDescription vmstate_stm32f2xx_rtc = {
         VMSTATE_UINT64(ticks,f2xx_rtc),
         VMSTATE_UINT32_ARRAY(regs,f2xx_rtc,R_RTC_MAX),
         VMSTATE_INT32(wp_count,f2xx_rtc),
+        VMSTATE_INT64_V(virt_epoch_us,f2xx_rtc, 2),
         VMSTATE_END_OF_LIST()
     }
 };
@@ -635,6 +693,8 @@ f2xx_rtc_class_init(ObjectClass *klass, void *data)
     DeviceClass *dc = DEVICE_CLASS(klass);
     dc->vmsd = &vmstate_stm32f2xx_rtc;
     dc->reset = f2xx_rtc_reset;
+    dc->realize = f2xx_rtc_realize;
+    device_class_set_props(dc, f2xx_rtc_properties);
 }
 
 static const TypeInfo
@@ -30,6 +30,7 @@
 #include "qemu/osdep.h"
 #include "qemu-common.h" 
 #include "hw/sysbus.h"
+#include "qemu/timer.h"
 
 
 // Define this to add extra BKUP registers past the normal ones implemented by the STM.
@@ -97,6 +98,12 @@ struct f2xx_rtc{
     // target time in ticks (seconds according to the RTC registers)
     uint64_t        ticks;
 
+    // Derive time from QEMU_CLOCK_VIRTUAL instead of the host clock.
+    bool          virtual_clock;
+    // host epoch (us) at virtual time 0, used when virtual_clock is set.
+    int64_t       virt_epoch_us;
+    QEMUClockType tick_clock, wut_clock;
+
     uint32_t      regs[R_RTC_MAX];
     int           wp_count; /* Number of correct writes to WP reg */
 } ;
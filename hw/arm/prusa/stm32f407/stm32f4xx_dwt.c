@@ -25,6 +25,7 @@
 #include "../stm32_common/stm32_shared.h"
 #include <assert.h>
 #include "../utility/macros.h"
+#include "../utility/p404_cycle_model.h"
 #include "sysemu/cpu-timers.h"
 #include "hw/irq.h"
 #include "migration/vmstate.h"
@@ -108,7 +109,7 @@ stm32f4xx_dwt_read(void *arg, hwaddr offset, unsigned int size)
         case RI_CYCCNT:
 			if (s->regs.defs.CTRL.CYCCNT_ENA)
 			{
-            	r = icount_get_raw() - s->cyccnt_start;
+            	r = p404_cycle_model_cycles() - s->cyccnt_start;
 			}
         break;
         default:
@@ -152,22 +153,22 @@ stm32f4xx_dwt_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
     switch (addr) {
         case RI_CTRL:
             if ((changed & 0x1) && s->regs.defs.CTRL.CYCCNT_ENA) {
-				if (icount_get_raw() == 0)
+				if (icount_enabled())
 				{
-					printf("WARNING: -icount (instruction counting) is not enabled. DWT CYCCNT register will not function reliably!\n");
+					printf("CYCCNT: 1 instruction is %ld ns\n", icount_to_ns(1));
 				}
 				else
 				{
-					printf("CYCCNT: 1 instruction is %ld ns\n", icount_to_ns(1));
+					printf("CYCCNT: -icount is not enabled, counting cycles from virtual time or the cycle model.\n");
 				}
-                s->cyccnt_start = icount_get_raw();
+                s->cyccnt_start = p404_cycle_model_cycles();
             }
         break;
         case RI_CYCCNT:
             if (data) {
                 printf("FIXME: Nonzero Cyccnt set not supported!\n");
             } else {
-                s->cyccnt_start = icount_get_raw();
+                s->cyccnt_start = p404_cycle_model_cycles();
             }
         break;
         default:
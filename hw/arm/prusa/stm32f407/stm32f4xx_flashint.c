@@ -27,7 +27,10 @@
 #include "qemu/log.h"
 #include "../utility/macros.h"
 #include "../stm32_common/stm32_common.h"
+#include "../utility/p404_cycle_model.h"
+#include "stm32f4xx_flashint.h"
 #include "stm32f4xx_flashint_regdata.h"
+#include "trace.h"
 
 
 OBJECT_DECLARE_TYPE(STM32F4XX_STRUCT_NAME(FlashIF), COM_CLASS_NAME(F4xxFlashIF), STM32F4xx_FINT)
@@ -185,7 +188,7 @@ stm32f4xx_fint_read(void *arg, hwaddr offset, unsigned int size)
             break;
     }
     ADJUST_FOR_OFFSET_AND_SIZE_R(r, size, offset, 0b111);
-//printf("FINT unit %d reg %x return 0x%x\n", s->periph, (int)offset << 2, r);
+    trace_stm32f4xx_fint_read(index << 2, r);
     return r;
 }
 
@@ -196,15 +199,53 @@ static void stm32f4xx_flashif_sector_erase(STM32F4XX_STRUCT_NAME(FlashIF) *s)
         s->regs.defs.SR.WRPERR = 1;
         return;
     }
-    printf("# Erasing flash sector %u\n", s->regs.defs.CR.SNB);
+    trace_stm32f4xx_fint_erase(s->regs.defs.CR.SNB);
     uint32_t (*p)[2] = &sector_boundaries[s->regs.defs.CR.SNB];
-    uint32_t buff = 0xFFFFFFFFU;
-    for (int i=(*p)[0]; i<=(*p)[1]; i+=4)
+    hwaddr len = (*p)[1] - (*p)[0] + 1U;
+    if ((*p)[0] >= memory_region_size(s->flash))
     {
-        cpu_physical_memory_write(s->flash->addr +i, &buff, 4);
+        return;
+    }
+    len = MIN(len, memory_region_size(s->flash) - (*p)[0]);
+    memset((uint8_t*)memory_region_get_ram_ptr(s->flash) + (*p)[0], 0xFF, len);
+    // Only drops the TBs translated from this sector.
+    memory_region_flush_rom_device(s->flash, (*p)[0], len);
+}
+
+// The flash array is a ROM device: reads go straight to its RAM and only writes
+// come here. That means lock/unlock doesn't have to change the memory map, and
+// programming only invalidates the TBs covering the bytes written.
+static uint64_t stm32f4xx_fint_flash_read(void *opaque, hwaddr addr, unsigned int size)
+{
+    STM32F4XX_STRUCT_NAME(FlashIF) *s = STM32F4xx_FINT(opaque);
+    if (s->flash == NULL)
+    {
+        return 0;
+    }
+    return ldn_le_p((uint8_t*)memory_region_get_ram_ptr(s->flash) + addr, size);
+}
+
+static void stm32f4xx_fint_flash_write(void *opaque, hwaddr addr, uint64_t data, unsigned int size)
+{
+    STM32F4XX_STRUCT_NAME(FlashIF) *s = STM32F4xx_FINT(opaque);
+    if (s->flash == NULL || s->flash_state != UNLOCKED)
+    {
+        return;
     }
+    stn_le_p((uint8_t*)memory_region_get_ram_ptr(s->flash) + addr, size, data);
+    memory_region_flush_rom_device(s->flash, addr, size);
 }
 
+const MemoryRegionOps stm32f4xx_fint_flash_ops = {
+    .read = stm32f4xx_fint_flash_read,
+    .write = stm32f4xx_fint_flash_write,
+    .endianness = DEVICE_LITTLE_ENDIAN,
+    .valid = {
+        .min_access_size = 1,
+        .max_access_size = 4
+    }
+};
+
 static void
 stm32f4xx_fint_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
 {
@@ -222,6 +263,13 @@ stm32f4xx_fint_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
     }
 
     switch (addr) {
+        case RI_ACR:
+            s->regs.raw[addr] = data;
+            if (s->flash)
+            {
+                p404_cycle_model_set_acr(data, memory_region_size(s->flash));
+            }
+            break;
         case RI_KEYR:
         {
             if (data == KEY1)
@@ -229,8 +277,7 @@ stm32f4xx_fint_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
             else if (data == KEY2 && s->flash_state == KEY1_OK)
             {
                 s->flash_state = UNLOCKED;
-                printf("# Flash unlocked!\n");
-                memory_region_set_readonly(s->flash, false);
+                trace_stm32f4xx_fint_unlock();
             }
         }
         break;
@@ -254,8 +301,7 @@ stm32f4xx_fint_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
     }
             else if (s->flash_state == UNLOCKED && r.LOCK)
             {
-                printf("# Flash LOCKED\n");
-                memory_region_set_readonly(s->flash, true);
+                trace_stm32f4xx_fint_lock();
                 s->flash_state = LOCKED;
             }
             s->regs.defs.CR.raw = r.raw;
@@ -292,14 +338,14 @@ stm32f4xx_fint_reset(DeviceState *dev)
 {
     STM32F4XX_STRUCT_NAME(FlashIF) *s = STM32F4xx_FINT(dev);
     s->flash_state = LOCKED;
-    if (s->flash)
-    {
-        memory_region_set_readonly(s->flash, true);
-    }
     for (int i=0; i<RI_END; i++)
     {
         s->regs.raw[i] = s->reginfo[i].reset_val;
     }
+    if (s->flash)
+    {
+        p404_cycle_model_set_acr(s->regs.raw[RI_ACR], memory_region_size(s->flash));
+    }
 }
 
 static void
@@ -0,0 +1,31 @@
+/*
+    stm32f4xx_flashint.h - Flash interface for STM32F4xx
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STM32F4XX_FLASHINT_H
+#define STM32F4XX_FLASHINT_H
+#include "qemu/osdep.h"
+#include "exec/memory.h"
+
+// Write side of the flash ROM device: the SoC maps the flash with these ops,
+// and writes only land while the flash interface is unlocked.
+extern const MemoryRegionOps stm32f4xx_fint_flash_ops;
+
+#endif //STM32F4XX_FLASHINT_H
@@ -27,6 +27,7 @@
 #include "migration/vmstate.h"
 #include "qemu/log.h"
 #include "../stm32_common/stm32_common.h"
+#include "../utility/p404_rtos_trace.h"
 
 enum reg_index {
 	RI_PORT_BASE,
@@ -95,6 +96,9 @@ stm32f4xx_itm_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
 			qemu_chr_fe_write(&s->chr, &ch, 1);
 		}
             break;
+        case RI_PORT_BASE + 1 ... RI_PORT_BASE + 31: // Trace markers
+            p404_rtos_trace_itm(addr - RI_PORT_BASE, data);
+            break;
         default:
             qemu_log_mask(LOG_UNIMP, "f2xx ITM reg 0x%x:%d write (0x%x) unimplemented\n",
             (int)addr << 2, offset, (int)data);
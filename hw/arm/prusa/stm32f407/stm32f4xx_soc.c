@@ -41,6 +41,7 @@
 #include "../stm32_chips/stm32f407xx.h"
 #include "../stm32_chips/stm32f427xx.h"
 #include "hw/arm/armv7m.h"
+#include "stm32f4xx_flashint.h"
 
 #include "qom/object.h"
 
@@ -97,8 +98,10 @@ static void stm32f4xx_soc_realize(DeviceState *dev_soc, Error **errp)
 
 	const stm32_soc_cfg_t* cfg = (STM32_SOC_GET_CLASS(dev_soc))->cfg;
 
-    memory_region_init_rom(&s->flash, OBJECT(dev_soc), "STM32F407.flash",
-                           flash_size, &err);
+    // Writes go to the flash interface, which decides if they're allowed.
+    memory_region_init_rom_device(&s->flash, OBJECT(dev_soc), &stm32f4xx_fint_flash_ops,
+                                  stm32_soc_get_periph(dev_soc, STM32_P_FINT), "STM32F407.flash",
+                                  flash_size, &err);
     if (err != NULL) {
         error_propagate(errp, err);
         return;
@@ -319,6 +322,9 @@ static void stm32_f4xx_class_init(ObjectClass *oc, void *data)
 		STM32SocMachineClass* smc = STM32_MACHINE_CLASS(oc);
 		smc->soc_type = data;
 		smc->cpu_type = ARM_CPU_TYPE_NAME("cortex-m4");
+		// Bit-banged parts that the qtests drive directly.
+		machine_class_allow_dynamic_sysbus_dev(mc, "at21csxx");
+		machine_class_allow_dynamic_sysbus_dev(mc, "ws281x");
 }
 
 static const TypeInfo stm32f4xx_machine_types[] = {
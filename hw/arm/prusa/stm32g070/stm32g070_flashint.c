@@ -27,6 +27,7 @@
 #include "../stm32_common/stm32_common.h"
 #include "hw/irq.h"
 #include "stm32g070_flashint_regdata.h"
+#include "trace.h"
 
 
 OBJECT_DECLARE_SIMPLE_TYPE(STM32G070_STRUCT_NAME(FlashIF), STM32G070_FINT);
@@ -208,7 +209,7 @@ static void stm32g070_flashif_sector_erase(STM32G070_STRUCT_NAME(FlashIF) *s)
         s->regs.defs.SR.WRPERR = 1;
         return;
     }
-    printf("# Erasing flash sector %u\n", s->regs.defs.CR.PNB);
+    trace_stm32g070_fint_erase(s->regs.defs.CR.PNB);
     uint32_t (*p)[2] = &sector_boundaries[s->regs.defs.CR.PNB];
     uint32_t buff = 0xFFFFFFFFU;
     for (int i=(*p)[0]; i<=(*p)[1]; i+=4)
@@ -241,7 +242,7 @@ stm32g070_fint_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
             else if (data == KEY2 && s->flash_state == KEY1_OK)
             {
                 s->flash_state = UNLOCKED;
-                printf("# Flash unlocked!\n");
+                trace_stm32g070_fint_unlock();
                 memory_region_set_readonly(s->flash, false);
             }
         }
@@ -256,7 +257,7 @@ stm32g070_fint_write(void *arg, hwaddr addr, uint64_t data, unsigned int size)
     		}
             else if (s->flash_state == UNLOCKED && r.LOCK)
             {
-                printf("# Flash LOCKED\n");
+                trace_stm32g070_fint_lock();
                 memory_region_set_readonly(s->flash, true);
                 s->flash_state = LOCKED;
             }
@@ -0,0 +1 @@
+#include "trace/trace-hw_arm_prusa_stm32g070.h"
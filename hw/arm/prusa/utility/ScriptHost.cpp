@@ -75,6 +75,7 @@ extern "C"{
 	extern void qemu_system_shutdown_request(int);
 
 	extern void scriptcon_print_out(void* opaque, const char* msg);
+	extern void scriptcon_wake(void* opaque);
 }
 
 void ScriptHost::PrintScriptHelp(bool bMarkdown)
@@ -312,6 +313,7 @@ void ScriptHost::KeyCB(char key)
 				std::lock_guard<std::mutex> lck (m_lckScript);
 				m_script.push_back(m_strCmd);
 			}
+			WakeConsole();
 			m_bCanAcceptInput = true;
 			break;
 		case 0x9: // tab
@@ -766,6 +768,12 @@ void ScriptHost::OnMachineCycle(int64_t iGuestUs)
 	}
 }
 
+bool ScriptHost::HasPendingLines()
+{
+	std::lock_guard<std::mutex> lck(m_lckScript);
+	return m_iLine < m_script.size();
+}
+
 void ScriptHost::AddScriptable_C(IScriptable* src)
 {
 	ScriptHost::AddScriptable(src->GetName() ,src);
@@ -790,8 +798,20 @@ void ScriptHost::OnCommand_C(std::string strCmd) {
 	{
 		return;
 	}
-	std::lock_guard<std::mutex> lck (m_lckScript);
-	m_script.push_back(strCmd);
+	{
+		std::lock_guard<std::mutex> lck (m_lckScript);
+		m_script.push_back(strCmd);
+	}
+	WakeConsole();
+}
+
+void ScriptHost::WakeConsole()
+{
+	// The console stops polling once the script has run out, restart it.
+	if (m_pConsole)
+	{
+		scriptcon_wake(m_pConsole);
+	}
 }
 
 void ScriptHost::PrintToConsole_C(std::string strOut) {
@@ -834,6 +854,11 @@ extern "C" {
 		return ScriptHost::GetTermStatus();
     }
 
+	extern bool scripthost_has_pending(void)
+	{
+		return ScriptHost::HasPendingLines();
+	}
+
 	extern int scripthost_get_int(script_args pArgs, uint8_t iIdx)
 	{
 		const std::vector<std::string> *pvArgs = static_cast<const std::vector<std::string>*>(pArgs);
@@ -99,6 +99,9 @@ class ScriptHost: public IScriptable
 
 		static inline int GetTermStatus(){ return m_eCmdStatus;}
 
+		// True while there are script/terminal lines left to execute.
+		static bool HasPendingLines();
+
 
     private:
 
@@ -118,6 +121,9 @@ class ScriptHost: public IScriptable
 
 		static void AddSubmenu(IScriptable *src);
 
+		// Tells the console a line was queued, so it resumes polling.
+		static void WakeConsole();
+
 		//We can't register ourselves as a scriptable so just fake it with a processing func.
 		LineStatus ProcessAction(unsigned int ID, const std::vector<std::string> &vArgs) override;
 
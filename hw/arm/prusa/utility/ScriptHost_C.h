@@ -59,4 +59,7 @@ extern bool scripthost_setup(const char* strScript, void *pConsole);
 // Runs one cycle of script processing. 
 extern int scripthost_run(int64_t iTime);
 
+// Returns true if there are still script lines waiting to be run.
+extern bool scripthost_has_pending(void);
+
 extern void scripthost_execute(const char* cmd);
@@ -22,6 +22,8 @@
 	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include "p404_stats.h"
+
 #define OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(ModuleObjName, module_obj_name, \
                                     MODULE_OBJ_NAME, PARENT_MODULE_OBJ_NAME, \
                                     ...) \
@@ -131,14 +133,15 @@ CHECK_REG_u32(REGDEF_NAME(part,x));
 	} \
 }
 
+// Accesses are counted for query-p404-stats.
 #define STM32_MR_IO_INIT(_mr, _obj, _ops, _opaque, _size) \
 { \
 	if (g_stm32_periph_init != STM32_P_UNDEFINED) { \
 		gchar* _mr_name = g_strdup_printf("%s (%s)", object_get_typename(_obj), _PERIPHNAMES[g_stm32_periph_init]); \
-			memory_region_init_io(_mr, _obj, _ops, _opaque, _mr_name, _size); \
+			p404_stats_init_io(_mr, _obj, _ops, _opaque, _mr_name, _size); \
 		g_free(_mr_name); \
 	} else { \
-		memory_region_init_io(_mr, _obj, _ops, _opaque, "UNKNOWN_INSTANCE", _size); \
+		p404_stats_init_io(_mr, _obj, _ops, _opaque, "UNKNOWN_INSTANCE", _size); \
 	} \
 }
 
@@ -0,0 +1,271 @@
+/*
+    p404_bench.c  - End-to-end emulator speed report for scripted workloads.
+
+	Measures how fast the whole machine runs a real firmware: virtual time
+	against host time, and guest MIPS when instructions are being counted
+	(cycle-model or -icount). Both slow the machine down, so take the ratio
+	from a run without them and MIPS from a separate one. A script splits
+	the run into phases with p404-bench::Phase(name) and ends it with
+	p404-bench::Finish(); each phase gets the same numbers.
+
+	The report is one JSON object, written at exit so an interrupted run
+	still reports.
+
+	The report also has the translated blocks left in the TCG cache at exit
+	and their host code size, to show how much of a run goes to translating.
+
+	The workloads and a runner are in hw/arm/prusa/bench.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/notify.h"
+#include "qemu/timer.h"
+#include "qom/object.h"
+#include "hw/boards.h"
+#include "sysemu/runstate.h"
+#include "sysemu/sysemu.h"
+#include "sysemu/tcg.h"
+#include "tcg/tcg.h"
+#include "ArgHelper.h"
+#include "macros.h"
+#include "p404scriptable.h"
+#include "ScriptHost_C.h"
+#include "p404_cycle_model.h"
+#include "p404_bench.h"
+
+typedef struct {
+	int64_t host_ns;
+	int64_t virtual_ns;
+	uint64_t insns;
+} p404_bench_mark_t;
+
+typedef struct {
+	char *name;
+	p404_bench_mark_t start, end;
+} p404_bench_phase_t;
+
+static struct {
+	bool has_insns;
+	FILE *out;
+	p404_bench_mark_t start;
+	GPtrArray *phases;
+	p404_bench_phase_t *current;
+} p404_bench;
+
+struct P404BenchState {
+	Object parent_obj;
+	script_handle handle;
+};
+
+OBJECT_DECLARE_SIMPLE_TYPE(P404BenchState, P404_BENCH)
+
+OBJECT_DEFINE_TYPE_SIMPLE_WITH_INTERFACES(P404BenchState, p404_bench, P404_BENCH, OBJECT, {TYPE_P404_SCRIPTABLE}, {NULL})
+
+enum {
+	ACT_PHASE,
+	ACT_FINISH,
+};
+
+static void p404_bench_mark(p404_bench_mark_t *m)
+{
+	m->host_ns = get_clock();
+	m->virtual_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+	m->insns = 0;
+	p404_cycle_model_insns(&m->insns);
+}
+
+static void p404_bench_end_phase(void)
+{
+	if (p404_bench.current)
+	{
+		p404_bench_mark(&p404_bench.current->end);
+		p404_bench.current = NULL;
+	}
+}
+
+// Writes str as a JSON string. Firmware paths can have backslashes (Windows)
+// and phase names come from the script, so neither can go out verbatim.
+static void p404_bench_write_str(const char *str)
+{
+	fputc('"', p404_bench.out);
+	for (const unsigned char *c = (const unsigned char *)str; *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			fprintf(p404_bench.out, "\\%c", *c);
+		}
+		else if (*c < 0x20)
+		{
+			fprintf(p404_bench.out, "\\u%04x", *c);
+		}
+		else
+		{
+			fputc(*c, p404_bench.out);
+		}
+	}
+	fputc('"', p404_bench.out);
+}
+
+// Writes the fields for one interval, without the enclosing braces.
+static void p404_bench_write(const p404_bench_mark_t *start, const p404_bench_mark_t *end)
+{
+	double host_s = (double)(end->host_ns - start->host_ns) / NANOSECONDS_PER_SECOND;
+	double virtual_s = (double)(end->virtual_ns - start->virtual_ns) / NANOSECONDS_PER_SECOND;
+	fprintf(p404_bench.out, "\"host_s\":%.3f,\"virtual_s\":%.3f,\"ratio\":%.4f,",
+		host_s, virtual_s, host_s > 0 ? virtual_s / host_s : 0);
+	if (p404_bench.has_insns)
+	{
+		uint64_t insns = end->insns - start->insns;
+		fprintf(p404_bench.out, "\"insns\":%" PRIu64 ",\"mips\":%.2f", insns,
+			host_s > 0 ? insns / host_s / 1e6 : 0);
+	}
+	else
+	{
+		fprintf(p404_bench.out, "\"insns\":null,\"mips\":null");
+	}
+}
+
+static void p404_bench_report(void)
+{
+	p404_bench_mark_t end;
+	p404_bench_mark(&end);
+	const char *fw = current_machine->kernel_filename;
+	fprintf(p404_bench.out, "{\"machine\":");
+	p404_bench_write_str(MACHINE_GET_CLASS(current_machine)->name);
+	fprintf(p404_bench.out, ",\"firmware\":");
+	p404_bench_write_str(fw ? fw : "");
+	if (tcg_enabled())
+	{
+		fprintf(p404_bench.out, ",\"tbs\":%zu,\"tb_code_bytes\":%zu", tcg_nb_tbs(), tcg_code_size());
+	}
+	fprintf(p404_bench.out, ",");
+	p404_bench_write(&p404_bench.start, &end);
+	fprintf(p404_bench.out, ",\"phases\":[");
+	for (guint i = 0; i < p404_bench.phases->len; i++)
+	{
+		p404_bench_phase_t *p = g_ptr_array_index(p404_bench.phases, i);
+		fprintf(p404_bench.out, "%s{\"name\":", i ? "," : "");
+		p404_bench_write_str(p->name);
+		fprintf(p404_bench.out, ",");
+		p404_bench_write(&p->start, &p->end);
+		fprintf(p404_bench.out, "}");
+	}
+	fprintf(p404_bench.out, "]}\n");
+	fflush(p404_bench.out);
+}
+
+static int p404_bench_process_action(P404ScriptIF *obj, unsigned int action, script_args args)
+{
+	switch (action)
+	{
+		case ACT_PHASE:
+		{
+			p404_bench_end_phase();
+			p404_bench_phase_t *p = g_new0(p404_bench_phase_t, 1);
+			p->name = g_strdup(scripthost_get_string(args, 0));
+			p404_bench_mark(&p->start);
+			g_ptr_array_add(p404_bench.phases, p);
+			p404_bench.current = p;
+			break;
+		}
+		case ACT_FINISH:
+			p404_bench_end_phase();
+			qemu_system_shutdown_request(SHUTDOWN_CAUSE_HOST_SIGNAL);
+			break;
+		default:
+			return ScriptLS_Unhandled;
+	}
+	return ScriptLS_Finished;
+}
+
+static void p404_bench_init(Object *obj)
+{
+	P404BenchState *s = P404_BENCH(obj);
+	s->handle = script_instance_new(P404_SCRIPTABLE(obj), TYPE_P404_BENCH);
+	script_register_action(s->handle, "Phase", "Ends the current benchmark phase and starts the named one", ACT_PHASE);
+	script_add_arg_string(s->handle, ACT_PHASE);
+	script_register_action(s->handle, "Finish", "Ends the current benchmark phase and quits, writing the report", ACT_FINISH);
+	scripthost_register_scriptable(s->handle);
+}
+
+static void p404_bench_finalize(Object *obj)
+{
+}
+
+static void p404_bench_class_init(ObjectClass *oc, void *data)
+{
+	P404ScriptIFClass *sc = P404_SCRIPTABLE_CLASS(oc);
+	sc->ScriptHandler = p404_bench_process_action;
+}
+
+static void p404_bench_machine_done(Notifier *n, void *data)
+{
+	// Start the clocks as late as possible so board setup is not counted.
+	p404_bench_mark(&p404_bench.start);
+}
+
+static void p404_bench_exit(Notifier *n, void *data)
+{
+	p404_bench_end_phase();
+	p404_bench_report();
+	if (p404_bench.out != stdout)
+	{
+		fclose(p404_bench.out);
+	}
+}
+
+static Notifier p404_bench_machine_done_notifier = { .notify = p404_bench_machine_done };
+static Notifier p404_bench_exit_notifier = { .notify = p404_bench_exit };
+
+extern bool p404_bench_headless(void)
+{
+	return arghelper_is_arg("headless") || arghelper_is_arg("bench");
+}
+
+extern void p404_bench_setup(void)
+{
+	if (!arghelper_is_arg("bench"))
+	{
+		return;
+	}
+	const char *file = arghelper_get_string("bench");
+	p404_bench.out = stdout;
+	if (strcmp(file, "true") != 0) // Bare "bench" reports to stdout.
+	{
+		p404_bench.out = fopen(file, "w");
+		if (p404_bench.out == NULL)
+		{
+			printf("bench: cannot open %s, reporting to stdout.\n", file);
+			p404_bench.out = stdout;
+		}
+	}
+	uint64_t insns;
+	p404_bench.has_insns = p404_cycle_model_insns(&insns);
+	if (!p404_bench.has_insns)
+	{
+		printf("bench: neither cycle-model nor -icount is enabled, MIPS will not be reported.\n");
+	}
+	p404_bench.phases = g_ptr_array_new();
+	Object *obj = object_new(TYPE_P404_BENCH);
+	object_property_add_child(OBJECT(current_machine), TYPE_P404_BENCH, obj);
+	object_unref(obj);
+	qemu_add_machine_init_done_notifier(&p404_bench_machine_done_notifier);
+	qemu_add_exit_notifier(&p404_bench_exit_notifier);
+}
@@ -0,0 +1,38 @@
+/*
+    p404_bench.h  - End-to-end emulator speed report for scripted workloads.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_BENCH_H
+#define P404_BENCH_H
+
+#include "qemu/osdep.h"
+
+#define TYPE_P404_BENCH "p404-bench"
+
+// True if the board should leave out the GL and 2D dashboards, i.e. "headless"
+// or "bench" is in -append.
+extern bool p404_bench_headless(void);
+
+// "bench" (or "bench=<file>") in -append: times the run and any phases marked
+// by a script with p404-bench::Phase(name), and writes a JSON report at exit.
+// Call from the board init, before the script console is realized.
+extern void p404_bench_setup(void);
+
+#endif // P404_BENCH_H
@@ -0,0 +1,100 @@
+/*
+    p404_cycle_model.c  - Approximate Cortex-M4 cycle timing, including
+	flash wait states and the ART accelerator.
+
+	With the "cycle-model" -append option each translated block charges an
+	estimated cost per instruction class (loads, LDM/STM, branches, divides,
+	VFP) plus FLASH_ACR.LATENCY wait states for every 16-byte flash line that
+	misses the ART instruction cache and isn't covered by the prefetcher.
+	With -icount the extra cycles are charged to the instruction counter too,
+	so virtual time follows the estimated cycles; either way they show up in
+	DWT CYCCNT. Data reads from flash and bus contention are not modelled.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "sysemu/cpu-timers.h"
+#include "hw/arm/armv7m.h"
+#include "ArgHelper.h"
+#include "p404_edge_timing.h"
+#include "p404_cycle_model.h"
+
+#define P404_FLASH_BASE 0x08000000U
+
+// FLASH_ACR bits
+#define ACR_LATENCY_MASK 0xFU
+#define ACR_PRFTEN BIT(8)
+#define ACR_ICEN BIT(9)
+#define ACR_ICRST BIT(11)
+
+extern void p404_cycle_model_setup(void)
+{
+	if (!arghelper_is_arg("cycle-model")) {
+		return;
+	}
+	ARMCPU *cpu = ARM_CPU(first_cpu);
+	cpu->cycle_model = true;
+	cpu->flash_base = P404_FLASH_BASE;
+	if (!icount_enabled()) {
+		printf("cycle-model: -icount is not enabled, only DWT CYCCNT will follow the model.\n");
+	}
+}
+
+extern void p404_cycle_model_set_acr(uint32_t acr, uint64_t flash_size)
+{
+	if (first_cpu == NULL) {
+		return;
+	}
+	ARMCPU *cpu = ARM_CPU(first_cpu);
+	if (!cpu->cycle_model) {
+		return;
+	}
+	cpu->flash_size = flash_size;
+	cpu->flash_ws = acr & ACR_LATENCY_MASK;
+	cpu->art_prefetch = (acr & ACR_PRFTEN) != 0;
+	cpu->art_icache = (acr & ACR_ICEN) != 0;
+	if (acr & ACR_ICRST || !cpu->art_icache) {
+		memset(cpu->art_tags, 0, sizeof(cpu->art_tags));
+	}
+}
+
+extern uint64_t p404_cycle_model_cycles(void)
+{
+	if (first_cpu != NULL && !icount_enabled()) {
+		ARMCPU *cpu = ARM_CPU(first_cpu);
+		if (cpu->cycle_model) {
+			return cpu->cycle_count;
+		}
+	}
+	return p404_edge_cycles();
+}
+
+extern bool p404_cycle_model_insns(uint64_t *insns)
+{
+	if (first_cpu != NULL && ARM_CPU(first_cpu)->cycle_model) {
+		// Not icount_get_raw(), that also holds the model's extra cycles.
+		*insns = ARM_CPU(first_cpu)->insn_count;
+		return true;
+	}
+	if (icount_enabled()) {
+		*insns = icount_get_raw();
+		return true;
+	}
+	return false;
+}
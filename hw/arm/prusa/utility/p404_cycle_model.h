@@ -0,0 +1,43 @@
+/*
+    p404_cycle_model.h  - Approximate Cortex-M4 cycle timing, including
+	flash wait states and the ART accelerator.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_CYCLE_MODEL_H
+#define P404_CYCLE_MODEL_H
+
+#include "qemu/osdep.h"
+
+// Applies the "cycle-model" -append option to the first CPU. Call before the CPU runs.
+extern void p404_cycle_model_setup(void);
+
+// Called by the flash interface when FLASH_ACR changes, flash_size is the
+// size of the internal flash at 0x08000000.
+extern void p404_cycle_model_set_acr(uint32_t acr, uint64_t flash_size);
+
+// Core cycles for DWT CYCCNT: the model's count if it is enabled, otherwise
+// the instruction count or virtual time, see p404_edge_cycles().
+extern uint64_t p404_cycle_model_cycles(void);
+
+// Guest instructions executed so far, from the cycle model if it is enabled,
+// otherwise from -icount. Returns false if neither is counting.
+extern bool p404_cycle_model_insns(uint64_t *insns);
+
+#endif // P404_CYCLE_MODEL_H
@@ -0,0 +1,68 @@
+/*
+    p404_edge_timing.h  - Time base for peripherals that decode bit-banged
+	GPIO protocols, working with or without -icount.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_EDGE_TIMING_H
+#define P404_EDGE_TIMING_H
+
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include "sysemu/cpu-timers.h"
+
+// Edge timestamps are in "edge units": instructions under -icount (which is also
+// what DWT CYCCNT counts, so firmware delay loops line up), otherwise virtual ns.
+// Only differences between two edge times are meaningful.
+
+// Nominal core clock, used to convert between the two.
+#define P404_EDGE_CYCLES_PER_US 168
+
+static inline int64_t p404_edge_now(void)
+{
+	if (icount_enabled())
+	{
+		return icount_get_raw();
+	}
+	return qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+}
+
+static inline int64_t p404_edge_per_us(void)
+{
+	return icount_enabled() ? P404_EDGE_CYCLES_PER_US : 1000;
+}
+
+// Converts a duration in edge units to QEMU_CLOCK_VIRTUAL ns, for arming timers.
+static inline int64_t p404_edge_to_ns(int64_t units)
+{
+	return icount_enabled() ? icount_to_ns(units) : units;
+}
+
+// Core cycle count for DWT CYCCNT. Without icount, derived from virtual time
+// so busy-waits on it take the same virtual time the peripherals measure.
+static inline uint64_t p404_edge_cycles(void)
+{
+	if (icount_enabled())
+	{
+		return icount_get_raw();
+	}
+	return muldiv64(qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL), P404_EDGE_CYCLES_PER_US, 1000);
+}
+
+#endif // P404_EDGE_TIMING_H
@@ -0,0 +1,185 @@
+/*
+    p404_elf_syms.c  - Minimal symbol table reader for the firmware ELF
+	so models and tooling can look up firmware symbols by name/address.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "elf.h"
+#include "p404_elf_syms.h"
+
+typedef struct p404_elf_sym_t {
+	const char *name;
+	uint32_t addr;
+	uint32_t size;
+} p404_elf_sym_t;
+
+static GHashTable *p404_syms_by_name = NULL;
+// Sorted by address for symbolization.
+static p404_elf_sym_t *p404_syms = NULL;
+static unsigned p404_sym_count = 0;
+static char *p404_strtab = NULL;
+
+static int p404_elf_sym_cmp(const void *a, const void *b)
+{
+	const p404_elf_sym_t *sa = a, *sb = b;
+	return (sa->addr > sb->addr) - (sa->addr < sb->addr);
+}
+
+static void* p404_elf_read(FILE *f, long offset, size_t len)
+{
+	void *buf = g_malloc(len);
+	if (fseek(f, offset, SEEK_SET) || fread(buf, 1, len, f) != len) {
+		g_free(buf);
+		return NULL;
+	}
+	return buf;
+}
+
+extern bool p404_elf_load_symbols(const char *filename)
+{
+	if (filename == NULL) {
+		return false;
+	}
+	FILE *f = fopen(filename, "rb");
+	if (f == NULL) {
+		return false;
+	}
+	bool ok = false;
+	Elf32_Ehdr ehdr;
+	Elf32_Shdr *shdrs = NULL;
+	Elf32_Sym *syms = NULL;
+	if (fread(&ehdr, sizeof(ehdr), 1, f) != 1 ||
+		memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0 ||
+		ehdr.e_ident[EI_CLASS] != ELFCLASS32 ||
+		ehdr.e_ident[EI_DATA] != ELFDATA2LSB) {
+		goto done;
+	}
+	uint16_t shnum = le16_to_cpu(ehdr.e_shnum);
+	shdrs = p404_elf_read(f, le32_to_cpu(ehdr.e_shoff), shnum * sizeof(Elf32_Shdr));
+	if (shdrs == NULL) {
+		goto done;
+	}
+	Elf32_Shdr *symtab = NULL;
+	for (int i = 0; i < shnum; i++) {
+		if (le32_to_cpu(shdrs[i].sh_type) == SHT_SYMTAB) {
+			symtab = &shdrs[i];
+			break;
+		}
+	}
+	if (symtab == NULL || le32_to_cpu(symtab->sh_link) >= shnum) {
+		goto done;
+	}
+	Elf32_Shdr *strtab = &shdrs[le32_to_cpu(symtab->sh_link)];
+	uint32_t strsize = le32_to_cpu(strtab->sh_size);
+	syms = p404_elf_read(f, le32_to_cpu(symtab->sh_offset), le32_to_cpu(symtab->sh_size));
+	char *str = p404_elf_read(f, le32_to_cpu(strtab->sh_offset), strsize);
+	if (syms == NULL || str == NULL || strsize == 0) {
+		g_free(str);
+		goto done;
+	}
+	str[strsize - 1] = '\0';
+
+	unsigned nsyms = le32_to_cpu(symtab->sh_size) / sizeof(Elf32_Sym);
+	g_free(p404_syms);
+	g_free(p404_strtab);
+	if (p404_syms_by_name) {
+		g_hash_table_destroy(p404_syms_by_name);
+	}
+	p404_strtab = str;
+	p404_syms = g_new0(p404_elf_sym_t, nsyms);
+	p404_sym_count = 0;
+	for (unsigned i = 0; i < nsyms; i++) {
+		uint8_t type = ELF32_ST_TYPE(syms[i].st_info);
+		uint16_t shndx = le16_to_cpu(syms[i].st_shndx);
+		uint32_t name = le32_to_cpu(syms[i].st_name);
+		if ((type != STT_FUNC && type != STT_OBJECT) || shndx == SHN_UNDEF ||
+			shndx >= SHN_LORESERVE || name >= strsize || str[name] == '\0') {
+			continue;
+		}
+		p404_elf_sym_t *s = &p404_syms[p404_sym_count++];
+		s->name = str + name;
+		s->addr = le32_to_cpu(syms[i].st_value);
+		s->size = le32_to_cpu(syms[i].st_size);
+		if (type == STT_FUNC) {
+			s->addr &= ~1U; // Thumb bit.
+		}
+	}
+	qsort(p404_syms, p404_sym_count, sizeof(p404_elf_sym_t), p404_elf_sym_cmp);
+	// Build the name map after sorting so the pointers stay valid.
+	p404_syms_by_name = g_hash_table_new(g_str_hash, g_str_equal);
+	for (unsigned i = 0; i < p404_sym_count; i++) {
+		g_hash_table_insert(p404_syms_by_name, (gpointer)p404_syms[i].name, &p404_syms[i]);
+	}
+	ok = p404_sym_count > 0;
+done:
+	g_free(syms);
+	g_free(shdrs);
+	fclose(f);
+	return ok;
+}
+
+extern bool p404_elf_have_symbols(void)
+{
+	return p404_sym_count > 0;
+}
+
+extern bool p404_elf_lookup(const char *name, uint32_t *addr, uint32_t *size)
+{
+	if (p404_syms_by_name == NULL) {
+		return false;
+	}
+	const p404_elf_sym_t *s = g_hash_table_lookup(p404_syms_by_name, name);
+	if (s == NULL) {
+		return false;
+	}
+	if (addr) {
+		*addr = s->addr;
+	}
+	if (size) {
+		*size = s->size;
+	}
+	return true;
+}
+
+extern const char* p404_elf_symbolize(uint32_t addr, uint32_t *offset)
+{
+	// Binary search for the last symbol starting at or before addr.
+	unsigned lo = 0, hi = p404_sym_count;
+	while (lo < hi) {
+		unsigned mid = (lo + hi) / 2;
+		if (p404_syms[mid].addr <= addr) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo == 0) {
+		return NULL;
+	}
+	const p404_elf_sym_t *s = &p404_syms[lo - 1];
+	if (addr - s->addr >= MAX(s->size, 1)) {
+		return NULL;
+	}
+	if (offset) {
+		*offset = addr - s->addr;
+	}
+	return s->name;
+}
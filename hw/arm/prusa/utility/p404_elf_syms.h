@@ -0,0 +1,43 @@
+/*
+    p404_elf_syms.h  - Minimal symbol table reader for the firmware ELF
+	so models and tooling can look up firmware symbols by name/address.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_ELF_SYMS_H
+#define P404_ELF_SYMS_H
+
+#include "qemu/osdep.h"
+
+// Loads the function and object symbols of a 32-bit little endian ELF.
+// Returns false (silently) if the file is not an ELF or has no symtab,
+// e.g. for .bin/.bbf firmware images.
+extern bool p404_elf_load_symbols(const char *filename);
+
+// Returns true if a symbol table was loaded.
+extern bool p404_elf_have_symbols(void);
+
+// Looks up a symbol by name. The Thumb bit is already stripped from functions.
+extern bool p404_elf_lookup(const char *name, uint32_t *addr, uint32_t *size);
+
+// Returns the name of the function/object covering addr (and the offset into it)
+// or NULL if there is none.
+extern const char* p404_elf_symbolize(uint32_t addr, uint32_t *offset);
+
+#endif // P404_ELF_SYMS_H
@@ -0,0 +1,255 @@
+/*
+    p404_hle.c  - High-level emulation of hot firmware libc routines.
+
+	With the "hle" -append option, a call to one of the routines below (located
+	via the firmware ELF symbols) is performed on the host instead of being
+	translated. The STM32 HAL CRC routines feed the whole buffer to the CRC
+	unit in one call rather than one DR write per word.
+
+	This only happens when every byte a call touches is plain RAM (or ROM,
+	for reads) in a single region; anything else - MMIO, bit-band aliases,
+	an unterminated string - falls back to running the guest code as usual.
+
+	Caveats: MPU permissions are not checked, and the skipped instructions do
+	not count towards -icount, so these calls take no virtual time.
+
+	hw/arm/prusa/bench/compare-bench.sh <qemu> <firmware.elf> hle measures
+	the boot-to-home speedup. It is unmeasured so far: no before/after run
+	has been recorded against a Buddy firmware.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/range.h"
+#include "qemu/rcu.h"
+#include "qemu/main-loop.h"
+#include "exec/memory.h"
+#include "hw/arm/armv7m.h"
+#include "ArgHelper.h"
+#include "p404_elf_syms.h"
+#include "p404_hle.h"
+#include "../stm32_common/stm32_crc.h"
+
+typedef enum {
+	HLE_MEMCPY,			// (dest, src, n) -> dest
+	HLE_MEMMOVE,		// Same, but the ranges may overlap.
+	HLE_MEMSET,			// (dest, c, n) -> dest
+	HLE_AEABI_MEMSET,	// (dest, n, c)
+	HLE_AEABI_MEMCLR,	// (dest, n)
+	HLE_STRLEN,			// (s) -> length
+	HLE_CRC_ACCUMULATE,	// (hcrc, words, n) -> CRC, STM32 HAL
+	HLE_CRC_CALCULATE,	// Same, with the CRC unit reset first.
+} p404_hle_op_t;
+
+static const struct {
+	const char *name;
+	p404_hle_op_t op;
+} p404_hle_funcs[] = {
+	// memmove first: if memcpy is an alias of it, the address keeps the safe op.
+	{"memmove", HLE_MEMMOVE},
+	{"__aeabi_memmove", HLE_MEMMOVE},
+	{"__aeabi_memmove4", HLE_MEMMOVE},
+	{"__aeabi_memmove8", HLE_MEMMOVE},
+	{"memcpy", HLE_MEMCPY},
+	{"memset", HLE_MEMSET},
+	{"strlen", HLE_STRLEN},
+	{"__aeabi_memcpy", HLE_MEMCPY},
+	{"__aeabi_memcpy4", HLE_MEMCPY},
+	{"__aeabi_memcpy8", HLE_MEMCPY},
+	{"__aeabi_memset", HLE_AEABI_MEMSET},
+	{"__aeabi_memset4", HLE_AEABI_MEMSET},
+	{"__aeabi_memset8", HLE_AEABI_MEMSET},
+	{"__aeabi_memclr", HLE_AEABI_MEMCLR},
+	{"__aeabi_memclr4", HLE_AEABI_MEMCLR},
+	{"__aeabi_memclr8", HLE_AEABI_MEMCLR},
+	{"HAL_CRC_Accumulate", HLE_CRC_ACCUMULATE},
+	{"HAL_CRC_Calculate", HLE_CRC_CALCULATE},
+};
+
+QEMU_BUILD_BUG_ON(ARRAY_SIZE(p404_hle_funcs) > ARM_HLE_MAX_ENTRIES);
+
+static p404_hle_op_t p404_hle_ops[ARM_HLE_MAX_ENTRIES];
+
+// Returns a host pointer to addr if it is RAM (or readable ROM when !is_write), and in
+// *avail how many bytes from there on are in the same region.
+static void* p404_hle_ram_ptr(AddressSpace *as, uint32_t addr, bool is_write, hwaddr *avail)
+{
+	hwaddr xlat, len = UINT32_MAX - addr + 1;
+	MemoryRegion *mr = address_space_translate(as, addr, &xlat, &len, is_write, MEMTXATTRS_UNSPECIFIED);
+	bool readable = memory_region_is_ram(mr) || memory_region_is_romd(mr); // ROM device (e.g. flash) in ROM mode
+	if (!readable || memory_region_is_ram_device(mr) || (is_write && (mr->readonly || !memory_region_is_ram(mr))))
+	{
+		return NULL;
+	}
+	*avail = MIN(len, memory_region_size(mr) - xlat);
+	return (uint8_t *)memory_region_get_ram_ptr(mr) + xlat;
+}
+
+static bool p404_hle_is_ram(AddressSpace *as, uint32_t addr, uint32_t n, bool is_write)
+{
+	hwaddr avail;
+	return p404_hle_ram_ptr(as, addr, is_write, &avail) != NULL && avail >= n;
+}
+
+// Feeds the words to the CRC unit at instance in one go instead of one DR write each.
+static bool p404_hle_crc(AddressSpace *as, uint32_t instance, const void *words, uint32_t n, bool reset)
+{
+	hwaddr xlat, len = 4;
+	MemoryRegion *mr = address_space_translate(as, instance, &xlat, &len, true, MEMTXATTRS_UNSPECIFIED);
+	if (xlat != 0 || memory_region_owner(mr) == NULL)
+	{
+		return false;
+	}
+	bool locked = qemu_mutex_iothread_locked();
+	if (!locked)
+	{
+		qemu_mutex_lock_iothread();
+	}
+	bool ok = stm32_crc_feed_words(memory_region_owner(mr), words, n, reset);
+	if (!locked)
+	{
+		qemu_mutex_unlock_iothread();
+	}
+	return ok;
+}
+
+static bool p404_hle_call(CPUARMState *env, int index)
+{
+	AddressSpace *as = env_cpu(env)->as;
+	uint32_t *r = env->regs;
+	uint32_t lr = r[14];
+	hwaddr avail;
+
+	if (!(lr & 1) || lr >= 0xF0000000) // Not a plain Thumb return (e.g. EXC_RETURN)
+	{
+		return false;
+	}
+
+	RCU_READ_LOCK_GUARD();
+
+	switch (p404_hle_ops[index])
+	{
+		case HLE_MEMCPY:
+		case HLE_MEMMOVE:
+		{
+			// address_space_write() takes care of dirty tracking and invalidating
+			// any TBs in the destination, but it memcpy()s from src, so a move
+			// whose ranges overlap goes through a bounce buffer first.
+			const void *src = p404_hle_ram_ptr(as, r[1], false, &avail);
+			if (src == NULL || avail < r[2] || !p404_hle_is_ram(as, r[0], r[2], true))
+			{
+				return false;
+			}
+			g_autofree void *bounce = NULL;
+			if (p404_hle_ops[index] == HLE_MEMMOVE && r[2] && ranges_overlap(r[0], r[2], r[1], r[2]))
+			{
+				bounce = g_memdup2(src, r[2]);
+				src = bounce;
+			}
+			address_space_write(as, r[0], MEMTXATTRS_UNSPECIFIED, src, r[2]);
+			break;
+		}
+		case HLE_MEMSET:
+			if (!p404_hle_is_ram(as, r[0], r[2], true))
+			{
+				return false;
+			}
+			address_space_set(as, r[0], r[1], r[2], MEMTXATTRS_UNSPECIFIED);
+			break;
+		case HLE_AEABI_MEMSET:
+		case HLE_AEABI_MEMCLR:
+			if (!p404_hle_is_ram(as, r[0], r[1], true))
+			{
+				return false;
+			}
+			address_space_set(as, r[0], p404_hle_ops[index] == HLE_AEABI_MEMSET ? r[2] : 0, r[1],
+				MEMTXATTRS_UNSPECIFIED);
+			break;
+		case HLE_STRLEN:
+		{
+			const char *s = p404_hle_ram_ptr(as, r[0], false, &avail);
+			const char *end = s ? memchr(s, 0, avail) : NULL;
+			if (end == NULL)
+			{
+				return false;
+			}
+			r[0] = end - s;
+			break;
+		}
+		case HLE_CRC_ACCUMULATE:
+		case HLE_CRC_CALCULATE:
+		{
+			// hcrc->Instance is the first member of the handle. hcrc->State is
+			// READY both on entry and on return, so it is left alone.
+			hwaddr words_avail;
+			const uint8_t *hcrc = p404_hle_ram_ptr(as, r[0], false, &avail);
+			const void *words = p404_hle_ram_ptr(as, r[1], false, &words_avail);
+			if (hcrc == NULL || avail < 4 || words == NULL || words_avail < (uint64_t)r[2] * 4U)
+			{
+				return false;
+			}
+			uint32_t instance = ldl_le_p(hcrc);
+			if (!p404_hle_crc(as, instance, words, r[2], p404_hle_ops[index] == HLE_CRC_CALCULATE))
+			{
+				return false;
+			}
+			// Regular DR read, so the clock gating still applies.
+			r[0] = address_space_ldl_le(as, instance, MEMTXATTRS_UNSPECIFIED, NULL);
+			break;
+		}
+	}
+	// memcpy/memset return dest, which is already in r0.
+	r[15] = lr & ~1U;
+	return true;
+}
+
+extern void p404_hle_setup(void)
+{
+	if (!arghelper_is_arg("hle")) {
+		return;
+	}
+	if (!p404_elf_have_symbols()) {
+		printf("hle: no firmware ELF symbols, nothing will be emulated.\n");
+		return;
+	}
+	ARMCPU *cpu = ARM_CPU(first_cpu);
+	int count = 0;
+	for (int i=0; i<ARRAY_SIZE(p404_hle_funcs); i++)
+	{
+		uint32_t addr = 0, size = 0;
+		if (!p404_elf_lookup(p404_hle_funcs[i].name, &addr, &size) || addr == 0)
+		{
+			continue;
+		}
+		bool dup = false;
+		for (int j=0; j<count; j++)
+		{
+			dup |= cpu->hle_pc[j] == addr; // Aliases, e.g. __aeabi_memcpy4 -> __aeabi_memcpy
+		}
+		if (dup)
+		{
+			continue;
+		}
+		cpu->hle_pc[count] = addr;
+		p404_hle_ops[count] = p404_hle_funcs[i].op;
+		printf("hle: %s @ 0x%08x\n", p404_hle_funcs[i].name, addr);
+		count++;
+	}
+	cpu->hle_fn = p404_hle_call;
+}
@@ -0,0 +1,33 @@
+/*
+    p404_hle.h  - High-level emulation of hot firmware libc routines.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_HLE_H
+#define P404_HLE_H
+
+#include "qemu/osdep.h"
+
+// Applies the "hle" -append option to the first CPU: calls to memcpy, memmove,
+// memset, strlen and their __aeabi_ variants (and HAL_CRC_Accumulate/Calculate)
+// found in the firmware ELF are done natively on the host. Call after the
+// firmware (and its symbols) are loaded.
+extern void p404_hle_setup(void);
+
+#endif // P404_HLE_H
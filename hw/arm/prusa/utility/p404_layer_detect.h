@@ -0,0 +1,82 @@
+/*
+    p404_layer_detect.h  - Layer change detection from the motor steps of a print.
+
+	Mesh bed levelling moves Z along with X/Y, by a few tenths of a mm across
+	a warped bed, so neither the Z an extrusion happens at nor how far it
+	moved since the last one tells a new layer from a travel to a higher part
+	of the bed. What does is that layer changes and Z hops are Z-only moves:
+	a run of Z steps with no X/Y step in between. Levelling spreads its Z
+	steps out over many more X/Y steps, so it never makes such a run. A layer
+	starts at the first extrusion after the Z-only moves since the previous
+	extrusion add up to a rise; a hop that comes back down adds up to nothing,
+	give or take a step of rounding where levelling lands it.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_LAYER_DETECT_H
+#define P404_LAYER_DETECT_H
+
+// Header-only so the unit test can run a scripted print through it.
+
+#include "qemu/osdep.h"
+
+// Rounding a hop's way down can end it a step off; layers are tens of steps.
+#define P404_LAYER_DETECT_SLACK_STEPS 2
+
+typedef struct {
+	int32_t run_dir; // Net direction of the current run of Z steps, in steps.
+	uint32_t run_steps;
+	int32_t lift_steps; // Net Z-only travel since the last extrusion.
+	bool started;
+} p404_layer_detect_t;
+
+static inline void p404_layer_detect_end_run(p404_layer_detect_t *d)
+{
+	if (d->run_steps > 1)
+	{
+		d->lift_steps += d->run_dir;
+	}
+	d->run_dir = 0;
+	d->run_steps = 0;
+}
+
+// One Z step, delta_um is how far Z moved.
+static inline void p404_layer_detect_z(p404_layer_detect_t *d, int32_t delta_um)
+{
+	d->run_dir += (delta_um > 0) - (delta_um < 0);
+	d->run_steps++;
+}
+
+// One X or Y step.
+static inline void p404_layer_detect_xy(p404_layer_detect_t *d)
+{
+	p404_layer_detect_end_run(d);
+}
+
+// Net extrusion, i.e. not an un-retract. Returns true if it starts a new layer.
+static inline bool p404_layer_detect_extrude(p404_layer_detect_t *d)
+{
+	p404_layer_detect_end_run(d);
+	bool new_layer = !d->started || d->lift_steps > P404_LAYER_DETECT_SLACK_STEPS;
+	d->started = true;
+	d->lift_steps = 0;
+	return new_layer;
+}
+
+#endif // P404_LAYER_DETECT_H
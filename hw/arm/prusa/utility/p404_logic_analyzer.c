@@ -0,0 +1,340 @@
+/*
+    p404_logic_analyzer.c  - Captures edges on GPIO/IRQ lines to a VCD file.
+
+	Any output GPIO of a device (stm32 GPIO pins, their "exti" lines that
+	follow the input state, chip selects, named part outputs, ...) can be
+	tapped. The tap forwards the level to the original destination and,
+	while capturing, appends a timestamped entry to a ring buffer that a
+	background thread drains into the VCD file. Untapped lines are not
+	touched at all, so there is no cost unless something is being captured.
+
+	Levels are recorded as level != 0, on the virtual clock (1 ns timescale).
+	If the writer falls behind, edges are dropped and counted rather than
+	stalling emulation - see "info p404-la".
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/module.h"
+#include "qemu/notify.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "qapi/error.h"
+#include "qapi/qmp/qdict.h"
+#include "hw/irq.h"
+#include "hw/qdev-core.h"
+#include "monitor/hmp.h"
+#include "monitor/monitor.h"
+#include "sysemu/sysemu.h"
+#include "ArgHelper.h"
+#include "p404_logic_analyzer.h"
+
+#define P404_LA_RING_SIZE (1U << 16) // Must be a power of 2.
+#define P404_LA_WRITER_SLEEP_US 10000
+
+typedef struct {
+	int64_t time;
+	uint32_t line;
+	uint32_t level;
+} p404_la_event_t;
+
+typedef struct {
+	char *label;
+	uint32_t index;
+	qemu_irq downstream;
+} p404_la_line_t;
+
+static struct {
+	GPtrArray *lines;
+	bool capturing;
+	char *filename;
+	FILE *out;
+	QemuThread writer;
+	bool stop;
+	// Single producer (edges, always under the BQL) / single consumer (writer thread).
+	uint32_t head, tail;
+	uint64_t dropped, written;
+	p404_la_event_t ring[P404_LA_RING_SIZE];
+} p404_la;
+
+static void p404_la_irq(void *opaque, int n, int level)
+{
+	p404_la_line_t *line = opaque;
+	if (qatomic_read(&p404_la.capturing))
+	{
+		uint32_t head = p404_la.head;
+		if (head - qatomic_load_acquire(&p404_la.tail) < P404_LA_RING_SIZE)
+		{
+			p404_la.ring[head & (P404_LA_RING_SIZE - 1)] = (p404_la_event_t) {
+				.time = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL),
+				.line = line->index,
+				.level = level != 0,
+			};
+			qatomic_store_release(&p404_la.head, head + 1);
+		}
+		else
+		{
+			p404_la.dropped++;
+		}
+	}
+	qemu_set_irq(line->downstream, level);
+}
+
+// VCD identifier: base-94 printable characters.
+static void p404_la_vcd_id(uint32_t index, char id[8])
+{
+	int i = 0;
+	do {
+		id[i++] = '!' + (index % 94);
+		index /= 94;
+	} while (index && i < 7);
+	id[i] = '\0';
+}
+
+static void p404_la_drain(uint8_t *last_level, int64_t *last_time)
+{
+	uint32_t head = qatomic_load_acquire(&p404_la.head);
+	uint32_t tail = p404_la.tail;
+	char id[8];
+	for (; tail != head; tail++)
+	{
+		const p404_la_event_t *e = &p404_la.ring[tail & (P404_LA_RING_SIZE - 1)];
+		if (last_level[e->line] == e->level)
+		{
+			continue;
+		}
+		last_level[e->line] = e->level;
+		if (e->time != *last_time)
+		{
+			fprintf(p404_la.out, "#%" PRId64 "\n", e->time);
+			*last_time = e->time;
+		}
+		p404_la_vcd_id(e->line, id);
+		fprintf(p404_la.out, "%u%s\n", e->level, id);
+		p404_la.written++;
+	}
+	qatomic_store_release(&p404_la.tail, tail);
+}
+
+static void *p404_la_writer(void *opaque)
+{
+	uint8_t *last_level = g_malloc(p404_la.lines->len);
+	int64_t last_time = -1;
+	memset(last_level, 0xFF, p404_la.lines->len); // Unknown, so the first edge always goes out.
+	while (!qatomic_read(&p404_la.stop))
+	{
+		p404_la_drain(last_level, &last_time);
+		g_usleep(P404_LA_WRITER_SLEEP_US);
+	}
+	p404_la_drain(last_level, &last_time);
+	g_free(last_level);
+	return NULL;
+}
+
+extern bool p404_la_tap(const char *path, const char *name, int n, Error **errp)
+{
+	if (p404_la.capturing)
+	{
+		error_setg(errp, "cannot add lines while capturing");
+		return false;
+	}
+	Object *obj = object_resolve_path_type(path, TYPE_DEVICE, NULL);
+	if (obj == NULL)
+	{
+		error_setg(errp, "no device at '%s'", path);
+		return false;
+	}
+	DeviceState *dev = DEVICE(obj);
+	g_autofree char *propname = g_strdup_printf("%s[%d]", name ? name : "unnamed-gpio-out", n);
+	if (n < 0 || object_property_find(OBJECT(dev), propname) == NULL)
+	{
+		error_setg(errp, "'%s' has no GPIO output %s", path, propname);
+		return false;
+	}
+	if (p404_la.lines == NULL)
+	{
+		p404_la.lines = g_ptr_array_new();
+	}
+	p404_la_line_t *line = g_new0(p404_la_line_t, 1);
+	line->index = p404_la.lines->len;
+	line->label = g_strdup_printf("%s.%s", path, propname);
+	line->downstream = qdev_intercept_gpio_out(dev, qemu_allocate_irq(p404_la_irq, line, 0), name, n);
+	g_ptr_array_add(p404_la.lines, line);
+	return true;
+}
+
+extern bool p404_la_start(const char *filename, Error **errp)
+{
+	if (p404_la.capturing)
+	{
+		error_setg(errp, "already capturing to %s", p404_la.filename);
+		return false;
+	}
+	if (p404_la.lines == NULL || p404_la.lines->len == 0)
+	{
+		error_setg(errp, "no lines tapped");
+		return false;
+	}
+	p404_la.out = fopen(filename, "w");
+	if (p404_la.out == NULL)
+	{
+		error_setg_errno(errp, errno, "cannot open %s", filename);
+		return false;
+	}
+	char id[8];
+	fprintf(p404_la.out, "$timescale 1ns $end\n$scope module p404 $end\n");
+	for (guint i = 0; i < p404_la.lines->len; i++)
+	{
+		p404_la_line_t *line = g_ptr_array_index(p404_la.lines, i);
+		g_autofree char *label = g_strdelimit(g_strdup(line->label), " ", '_');
+		p404_la_vcd_id(i, id);
+		fprintf(p404_la.out, "$var wire 1 %s %s $end\n", id, label);
+	}
+	fprintf(p404_la.out, "$upscope $end\n$enddefinitions $end\n#%" PRId64 "\n$dumpvars\n",
+		qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+	for (guint i = 0; i < p404_la.lines->len; i++)
+	{
+		p404_la_vcd_id(i, id);
+		fprintf(p404_la.out, "x%s\n", id);
+	}
+	fprintf(p404_la.out, "$end\n");
+
+	g_free(p404_la.filename);
+	p404_la.filename = g_strdup(filename);
+	p404_la.head = p404_la.tail = 0;
+	p404_la.dropped = p404_la.written = 0;
+	p404_la.stop = false;
+	qemu_thread_create(&p404_la.writer, "p404-la", p404_la_writer, NULL, QEMU_THREAD_JOINABLE);
+	qatomic_set(&p404_la.capturing, true);
+	return true;
+}
+
+extern void p404_la_stop(void)
+{
+	if (!p404_la.capturing)
+	{
+		return;
+	}
+	qatomic_set(&p404_la.capturing, false);
+	qatomic_set(&p404_la.stop, true);
+	qemu_thread_join(&p404_la.writer);
+	fclose(p404_la.out);
+	p404_la.out = NULL;
+}
+
+static void p404_la_exit(Notifier *n, void *data)
+{
+	p404_la_stop();
+}
+
+static Notifier p404_la_exit_notifier = { .notify = p404_la_exit };
+
+static void p404_la_machine_done(Notifier *n, void *data)
+{
+	Error *err = NULL;
+	const char *lines = arghelper_is_arg("la-lines") ? arghelper_get_string("la-lines") : NULL;
+	g_auto(GStrv) specs = g_strsplit(lines ? lines : "", "+", -1);
+	for (int i = 0; specs[i] != NULL; i++)
+	{
+		// <path>:<n> or <path>:<gpio-name>:<n>
+		g_auto(GStrv) parts = g_strsplit(specs[i], ":", 3);
+		guint count = g_strv_length(parts);
+		if (count < 2)
+		{
+			printf("la: ignoring malformed line '%s'\n", specs[i]);
+			continue;
+		}
+		if (!p404_la_tap(parts[0], count == 3 ? parts[1] : NULL, atoi(parts[count - 1]), &err))
+		{
+			printf("la: %s\n", error_get_pretty(err));
+			error_free(err);
+			err = NULL;
+		}
+	}
+	if (arghelper_is_arg("la") && !p404_la_start(arghelper_get_string("la"), &err))
+	{
+		printf("la: %s\n", error_get_pretty(err));
+		error_free(err);
+	}
+}
+
+static Notifier p404_la_machine_done_notifier = { .notify = p404_la_machine_done };
+
+extern void p404_la_setup(void)
+{
+	if (arghelper_is_arg("la-lines") || arghelper_is_arg("la"))
+	{
+		qemu_add_machine_init_done_notifier(&p404_la_machine_done_notifier);
+	}
+}
+
+static void hmp_p404_la_tap(Monitor *mon, const QDict *qdict)
+{
+	Error *err = NULL;
+	p404_la_tap(qdict_get_str(qdict, "path"), qdict_get_try_str(qdict, "name"),
+		qdict_get_int(qdict, "n"), &err);
+	hmp_handle_error(mon, err);
+}
+
+static void hmp_p404_la_start(Monitor *mon, const QDict *qdict)
+{
+	Error *err = NULL;
+	p404_la_start(qdict_get_str(qdict, "file"), &err);
+	hmp_handle_error(mon, err);
+}
+
+static void hmp_p404_la_stop(Monitor *mon, const QDict *qdict)
+{
+	p404_la_stop();
+}
+
+static void hmp_info_p404_la(Monitor *mon, const QDict *qdict)
+{
+	if (p404_la.lines == NULL || p404_la.lines->len == 0)
+	{
+		monitor_printf(mon, "No lines tapped\n");
+		return;
+	}
+	for (guint i = 0; i < p404_la.lines->len; i++)
+	{
+		p404_la_line_t *line = g_ptr_array_index(p404_la.lines, i);
+		monitor_printf(mon, "%3u %s\n", i, line->label);
+	}
+	if (p404_la.capturing)
+	{
+		monitor_printf(mon, "Capturing to %s: %" PRIu64 " edges written, %" PRIu64 " dropped\n",
+			p404_la.filename, p404_la.written, p404_la.dropped);
+	}
+	else
+	{
+		monitor_printf(mon, "Not capturing\n");
+	}
+}
+
+static void p404_la_register(void)
+{
+	qemu_add_exit_notifier(&p404_la_exit_notifier);
+	monitor_register_hmp("p404-la-tap", false, hmp_p404_la_tap);
+	monitor_register_hmp("p404-la-start", false, hmp_p404_la_start);
+	monitor_register_hmp("p404-la-stop", false, hmp_p404_la_stop);
+	monitor_register_hmp("p404-la", true, hmp_info_p404_la);
+}
+
+type_init(p404_la_register)
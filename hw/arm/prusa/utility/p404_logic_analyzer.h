@@ -0,0 +1,39 @@
+/*
+    p404_logic_analyzer.h  - Captures edges on GPIO/IRQ lines to a VCD file.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_LOGIC_ANALYZER_H
+#define P404_LOGIC_ANALYZER_H
+
+#include "qemu/osdep.h"
+
+// Taps output n of the named GPIO (NULL for the unnamed ones) of the device at
+// QOM path. Must be done while not capturing. Returns false with *errp set on failure.
+extern bool p404_la_tap(const char *path, const char *name, int n, Error **errp);
+
+// Starts writing edges on the tapped lines to a VCD file / stops and flushes it.
+extern bool p404_la_start(const char *filename, Error **errp);
+extern void p404_la_stop(void);
+
+// Applies the "la=<file.vcd>" and "la-lines=<path>[:<gpio-name>]:<n>+..." -append
+// options once the board is wired up. Call from the board init.
+extern void p404_la_setup(void);
+
+#endif // P404_LOGIC_ANALYZER_H
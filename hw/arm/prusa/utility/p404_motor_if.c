@@ -37,6 +37,116 @@ extern const p404_motorif_status_t* p404_motor_if_get_status(P404MotorIF *src) {
     return s->get_current_status(src);
 }
 
+static p404_motor_watchlist_t* p404_motor_if_get_watchlist(P404MotorIF *src)
+{
+    P404MotorIFClass *s = P404_MOTOR_IF_GET_CLASS(src);
+    if (s->get_watchlist == NULL)
+    {
+        return NULL;
+    }
+    return s->get_watchlist(src);
+}
+
+static void p404_motor_watch_recalc(p404_motor_watchlist_t *l)
+{
+    for (int u=0; u<P404_MOTOR_WATCH_UNIT_COUNT; u++)
+    {
+        l->lo[u] = INT32_MIN;
+        l->hi[u] = INT32_MAX;
+    }
+    for (int i=0; i<l->count; i++)
+    {
+        p404_motor_watch_t *w = &l->watch[i];
+        l->lo[w->unit] = MAX(l->lo[w->unit], w->lo);
+        l->hi[w->unit] = MIN(l->hi[w->unit], w->hi);
+    }
+}
+
+static void p404_motor_watch_fire(p404_motor_watch_t *w, int32_t value)
+{
+    if (w->granularity > 0)
+    {
+        int32_t bucket = value / w->granularity;
+        if (value < 0 && (value % w->granularity))
+        {
+            bucket--;
+        }
+        w->lo = bucket * w->granularity;
+        w->hi = w->lo + (w->granularity - 1);
+    }
+    else
+    {
+        // Default to firing on the next change, the callback may widen it.
+        w->lo = w->hi = value;
+    }
+    w->cb(w->opaque, w->n, value);
+}
+
+extern void p404_motor_watch_init(p404_motor_watchlist_t *l)
+{
+    memset(l, 0, sizeof(*l));
+    p404_motor_watch_recalc(l);
+}
+
+extern void p404_motor_watch_dispatch(p404_motor_watchlist_t *l)
+{
+    for (int i=0; i<l->count; i++)
+    {
+        p404_motor_watch_t *w = &l->watch[i];
+        int32_t value = l->last[w->unit];
+        if (value < w->lo || value > w->hi)
+        {
+            p404_motor_watch_fire(w, value);
+        }
+    }
+    p404_motor_watch_recalc(l);
+}
+
+extern int p404_motor_if_add_watch(P404MotorIF *src, p404_motor_watch_unit_t unit, int32_t granularity,
+	p404_motor_watch_cb cb, void *opaque, int n)
+{
+    p404_motor_watchlist_t *l = p404_motor_if_get_watchlist(src);
+    if (l == NULL)
+    {
+        return -1;
+    }
+    if (l->count >= P404_MOTOR_MAX_WATCHES)
+    {
+        printf("%s: Too many position watches on motor!\n", __func__);
+        return -1;
+    }
+    int id = l->count++;
+    p404_motor_watch_t *w = &l->watch[id];
+    *w = (p404_motor_watch_t) {
+        .cb = cb,
+        .opaque = opaque,
+        .n = n,
+        .unit = unit,
+        .granularity = granularity,
+    };
+    p404_motor_watch_fire(w, l->last[unit]);
+    p404_motor_watch_recalc(l);
+    return id;
+}
+
+extern void p404_motor_if_set_watch_window(P404MotorIF *src, int id, int32_t lo, int32_t hi)
+{
+    p404_motor_watchlist_t *l = p404_motor_if_get_watchlist(src);
+    if (l == NULL || id < 0 || id >= l->count)
+    {
+        return;
+    }
+    l->watch[id].lo = lo;
+    l->watch[id].hi = hi;
+    p404_motor_watch_recalc(l);
+}
+
+extern void p404_motor_if_reset_watch(P404MotorIF *src, int id)
+{
+    // An empty window, anything is outside it.
+    p404_motor_if_set_watch_window(src, id, INT32_MAX, INT32_MIN);
+}
+
 static void p404_motor_if_register_types(void)
 {
     type_register_static(&p404_motor_if_type_info);
@@ -51,14 +51,76 @@ typedef struct
 	char label;
 } p404_motorif_status_t;
 
+// Position watches let a consumer be called only when the motor leaves a window
+// (or granularity bucket) it cares about, rather than on every step.
+typedef enum {
+	P404_MOTOR_WATCH_STEPS,
+	P404_MOTOR_WATCH_UM,
+	P404_MOTOR_WATCH_UNIT_COUNT
+} p404_motor_watch_unit_t;
+
+typedef void (*p404_motor_watch_cb)(void *opaque, int n, int32_t value);
+
+typedef struct
+{
+	p404_motor_watch_cb cb;
+	void *opaque;
+	int n; // Passed back to cb, like a GPIO line number.
+	p404_motor_watch_unit_t unit;
+	int32_t granularity; // If > 0 the window follows the position in buckets of this size.
+	int32_t lo, hi; // Quiet window, inclusive. cb fires when the position leaves it.
+} p404_motor_watch_t;
+
+#define P404_MOTOR_MAX_WATCHES 8
+
+typedef struct
+{
+	p404_motor_watch_t watch[P404_MOTOR_MAX_WATCHES];
+	uint8_t count;
+	int32_t lo[P404_MOTOR_WATCH_UNIT_COUNT], hi[P404_MOTOR_WATCH_UNIT_COUNT]; // Intersection of all windows.
+	int32_t last[P404_MOTOR_WATCH_UNIT_COUNT];
+} p404_motor_watchlist_t;
+
 struct P404MotorIFClass {
     InterfaceClass parent;
 
     // Called to request the current motor position in mm.
     const p404_motorif_status_t* (*get_current_status)(P404MotorIF *self);
 
+    // Optional, returns the position watch list of the motor.
+    p404_motor_watchlist_t* (*get_watchlist)(P404MotorIF *self);
+
 };
 
 extern const p404_motorif_status_t* p404_motor_if_get_status(P404MotorIF *src);
+
+// Registers a watch on the motor, returns the watch ID or -1 if the motor
+// does not support watches (in which case use its GPIO outputs instead).
+// cb is called once immediately with the current position.
+extern int p404_motor_if_add_watch(P404MotorIF *src, p404_motor_watch_unit_t unit, int32_t granularity,
+	p404_motor_watch_cb cb, void *opaque, int n);
+
+// Sets the quiet window of a watch, typically from inside its callback.
+extern void p404_motor_if_set_watch_window(P404MotorIF *src, int id, int32_t lo, int32_t hi);
+
+// Makes a watch fire on the next position update (e.g. after loadvm).
+extern void p404_motor_if_reset_watch(P404MotorIF *src, int id);
+
+// Motor-side API.
+extern void p404_motor_watch_init(p404_motor_watchlist_t *l);
+extern void p404_motor_watch_dispatch(p404_motor_watchlist_t *l);
+
+// Called by the motor on each position change. The common case is just the compare.
+static inline void p404_motor_watch_update(p404_motor_watchlist_t *l, int32_t steps, int32_t um)
+{
+	l->last[P404_MOTOR_WATCH_STEPS] = steps;
+	l->last[P404_MOTOR_WATCH_UM] = um;
+	if (likely(steps >= l->lo[P404_MOTOR_WATCH_STEPS] && steps <= l->hi[P404_MOTOR_WATCH_STEPS]
+		&& um >= l->lo[P404_MOTOR_WATCH_UM] && um <= l->hi[P404_MOTOR_WATCH_UM]))
+	{
+		return;
+	}
+	p404_motor_watch_dispatch(l);
+}
  
 #endif // P404_MOTOR_IF_H
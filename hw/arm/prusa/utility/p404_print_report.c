@@ -0,0 +1,373 @@
+/*
+    p404_print_report.c  - Virtual-time print duration and resource usage report.
+
+	Turns the emulator into a print-time estimator: run a gcode file as
+	fast as the host allows and read off what a real printer would have
+	taken, in virtual time. The data comes from the parts themselves, by
+	tapping their outputs:
+
+	 - motor um-out: motion start/end; E gives the filament retracted and
+	   the net extruded. Forward E moves only count once they have paid
+	   back the retractions before them, so un-retracts neither add to the
+	   filament nor start the print or a layer. The print is the span from
+	   the first to the last net extrusion. X, Y and Z steps go to
+	   p404_layer_detect.h, which starts a layer at the first extrusion
+	   after a net Z-only rise, so Z hops and mesh bed levelling don't
+	   split layers. A layer's Z is the lowest it extruded at.
+	 - heater and fan pwm-out: peak and time-averaged duty.
+	 - a 1 ms virtual clock sample of the CPU: idle if halted in WFI or
+	   running the FreeRTOS idle task (pxCurrentTCB == xIdleTaskHandle, or
+	   the PC inside prvIdleTask), busy otherwise, including ISRs.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "qemu/bswap.h"
+#include "qemu/notify.h"
+#include "qemu/timer.h"
+#include "hw/core/cpu.h"
+#include "hw/irq.h"
+#include "hw/qdev-core.h"
+#include "exec/cpu-common.h"
+#include "sysemu/sysemu.h"
+#include "target/arm/cpu.h"
+#include "ArgHelper.h"
+#include "p404_elf_syms.h"
+#include "p404_layer_detect.h"
+#include "p404_print_report.h"
+
+#define P404_PR_SAMPLE_NS (1 * SCALE_MS)
+#define P404_PR_IDLE_SYM "prvIdleTask"
+
+typedef struct {
+	char axis;
+	bool valid;
+	int32_t um;
+	qemu_irq downstream;
+} p404_pr_axis_t;
+
+typedef struct {
+	const char *type;
+	uint8_t label;
+	int level;
+	int peak;
+	int64_t since_ns;
+	double level_ns; // Integral of level over time.
+	qemu_irq downstream;
+} p404_pr_duty_t;
+
+typedef struct {
+	int32_t z_um;
+	int64_t start_ns;
+	int64_t end_ns;
+	int64_t e_um;
+} p404_pr_layer_t;
+
+static struct {
+	FILE *out;
+	int64_t start_ns;
+	int64_t motion_start_ns, motion_end_ns;
+	int64_t print_start_ns, print_end_ns;
+	int32_t z_um;
+	int64_t extruded_um, retracted_um;
+	int64_t retract_debt_um;
+	p404_layer_detect_t layer_detect;
+	GArray *layers;
+	GPtrArray *duties;
+	QEMUTimer *timer;
+	uint32_t px_current_tcb, idle_handle;
+	bool have_tcb;
+	uint32_t idle_start, idle_end;
+	uint64_t idle_samples, busy_samples;
+} p404_pr;
+
+static void p404_pr_extrude(int64_t now, int32_t delta)
+{
+	if (delta < 0)
+	{
+		p404_pr.retracted_um -= delta;
+		p404_pr.retract_debt_um -= delta;
+		return;
+	}
+	int64_t repaid = MIN(delta, p404_pr.retract_debt_um);
+	p404_pr.retract_debt_um -= repaid;
+	int64_t net = delta - repaid;
+	if (net == 0)
+	{
+		return;
+	}
+	p404_pr.extruded_um += net;
+	if (p404_pr.print_start_ns < 0)
+	{
+		p404_pr.print_start_ns = now;
+	}
+	p404_pr.print_end_ns = now;
+
+	p404_pr_layer_t *layer = p404_pr.layers->len ?
+		&g_array_index(p404_pr.layers, p404_pr_layer_t, p404_pr.layers->len - 1) : NULL;
+	if (p404_layer_detect_extrude(&p404_pr.layer_detect) || layer == NULL)
+	{
+		p404_pr_layer_t next = { .z_um = p404_pr.z_um, .start_ns = now };
+		g_array_append_val(p404_pr.layers, next);
+		layer = &g_array_index(p404_pr.layers, p404_pr_layer_t, p404_pr.layers->len - 1);
+	}
+	layer->z_um = MIN(layer->z_um, p404_pr.z_um);
+	layer->e_um += net;
+	layer->end_ns = now;
+}
+
+static void p404_pr_axis_irq(void *opaque, int n, int level)
+{
+	p404_pr_axis_t *a = opaque;
+	int32_t delta = a->valid ? level - a->um : 0;
+	if (a->valid && (a->axis == 'X' || a->axis == 'Y'))
+	{
+		p404_layer_detect_xy(&p404_pr.layer_detect);
+	}
+	else if (a->valid && a->axis == 'Z')
+	{
+		p404_layer_detect_z(&p404_pr.layer_detect, delta);
+	}
+	a->um = level;
+	a->valid = true;
+	if (delta)
+	{
+		int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+		if (p404_pr.motion_start_ns < 0)
+		{
+			p404_pr.motion_start_ns = now;
+		}
+		p404_pr.motion_end_ns = now;
+		if (a->axis == 'E')
+		{
+			p404_pr_extrude(now, delta);
+		}
+	}
+	if (a->axis == 'Z')
+	{
+		p404_pr.z_um = level;
+	}
+	qemu_set_irq(a->downstream, level);
+}
+
+static void p404_pr_duty_update(p404_pr_duty_t *d, int64_t now)
+{
+	d->level_ns += (double)d->level * (now - d->since_ns);
+	d->since_ns = now;
+}
+
+static void p404_pr_duty_irq(void *opaque, int n, int level)
+{
+	p404_pr_duty_t *d = opaque;
+	p404_pr_duty_update(d, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL));
+	d->level = MIN(MAX(level, 0), 255);
+	d->peak = MAX(d->peak, d->level);
+	qemu_set_irq(d->downstream, level);
+}
+
+static bool p404_pr_read32(CPUState *cpu, uint32_t addr, uint32_t *value)
+{
+	if (cpu_memory_rw_debug(cpu, addr, value, 4, false) != 0)
+	{
+		return false;
+	}
+	*value = le32_to_cpu(*value);
+	return true;
+}
+
+static void p404_pr_sample(CPUState *cpu, run_on_cpu_data data)
+{
+	CPUARMState *env = &ARM_CPU(cpu)->env;
+	bool idle = cpu->halted;
+	if (!idle && env->v7m.exception == 0)
+	{
+		uint32_t tcb, idle_tcb;
+		if (p404_pr.have_tcb && p404_pr_read32(cpu, p404_pr.px_current_tcb, &tcb) &&
+			p404_pr_read32(cpu, p404_pr.idle_handle, &idle_tcb) && idle_tcb != 0)
+		{
+			idle = tcb == idle_tcb;
+		}
+		else
+		{
+			uint32_t pc = env->regs[15];
+			idle = pc >= p404_pr.idle_start && pc < p404_pr.idle_end;
+		}
+	}
+	qatomic_inc(idle ? &p404_pr.idle_samples : &p404_pr.busy_samples);
+}
+
+static void p404_pr_tick(void *opaque)
+{
+	async_run_on_cpu(first_cpu, p404_pr_sample, RUN_ON_CPU_NULL);
+	timer_mod(p404_pr.timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + P404_PR_SAMPLE_NS);
+}
+
+static int p404_pr_find_parts(Object *obj, void *opaque)
+{
+	if ((object_dynamic_cast(obj, "tmc2130") || object_dynamic_cast(obj, "tmc2209")) &&
+		object_property_find(obj, "um-out[0]"))
+	{
+		p404_pr_axis_t *a = g_new0(p404_pr_axis_t, 1);
+		a->axis = object_property_get_uint(obj, "axis", NULL);
+		a->downstream = qdev_intercept_gpio_out(DEVICE(obj), qemu_allocate_irq(p404_pr_axis_irq, a, 0), "um-out", 0);
+		return 0;
+	}
+	static const char *duty_types[] = { "heater", "fan" };
+	for (int i = 0; i < ARRAY_SIZE(duty_types); i++)
+	{
+		if (object_dynamic_cast(obj, duty_types[i]) && object_property_find(obj, "pwm-out[0]"))
+		{
+			p404_pr_duty_t *d = g_new0(p404_pr_duty_t, 1);
+			d->type = duty_types[i];
+			d->label = object_property_get_uint(obj, "label", NULL);
+			d->since_ns = p404_pr.start_ns;
+			d->downstream = qdev_intercept_gpio_out(DEVICE(obj), qemu_allocate_irq(p404_pr_duty_irq, d, 0), "pwm-out", 0);
+			g_ptr_array_add(p404_pr.duties, d);
+		}
+	}
+	return 0;
+}
+
+static void p404_pr_machine_done(Notifier *n, void *data)
+{
+	p404_pr.start_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+	object_child_foreach_recursive(object_get_root(), p404_pr_find_parts, NULL);
+	p404_pr.timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, p404_pr_tick, NULL);
+	timer_mod(p404_pr.timer, p404_pr.start_ns + P404_PR_SAMPLE_NS);
+}
+
+static double p404_pr_s(int64_t ns)
+{
+	return (double)ns / NANOSECONDS_PER_SECOND;
+}
+
+static void p404_pr_span(const char *name, int64_t start, int64_t end)
+{
+	if (start < 0)
+	{
+		fprintf(p404_pr.out, "\"%s\":null,", name);
+		return;
+	}
+	fprintf(p404_pr.out, "\"%s\":{\"start_s\":%.3f,\"end_s\":%.3f,\"duration_s\":%.3f},", name,
+		p404_pr_s(start - p404_pr.start_ns), p404_pr_s(end - p404_pr.start_ns), p404_pr_s(end - start));
+}
+
+static void p404_pr_report(void)
+{
+	int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+	FILE *out = p404_pr.out;
+	fprintf(out, "{\"virtual_s\":%.3f,", p404_pr_s(now - p404_pr.start_ns));
+	p404_pr_span("print", p404_pr.print_start_ns, p404_pr.print_end_ns);
+	p404_pr_span("motion", p404_pr.motion_start_ns, p404_pr.motion_end_ns);
+	fprintf(out, "\"filament_mm\":{\"extruded\":%.3f,\"retracted\":%.3f},",
+		p404_pr.extruded_um / 1000.0, p404_pr.retracted_um / 1000.0);
+
+	fprintf(out, "\"layers\":[");
+	for (guint i = 0; i < p404_pr.layers->len; i++)
+	{
+		p404_pr_layer_t *l = &g_array_index(p404_pr.layers, p404_pr_layer_t, i);
+		// A layer lasts until the next one starts, the last one until its final extrusion.
+		int64_t end = i + 1 < p404_pr.layers->len ?
+			g_array_index(p404_pr.layers, p404_pr_layer_t, i + 1).start_ns : l->end_ns;
+		fprintf(out, "%s{\"z_mm\":%.3f,\"start_s\":%.3f,\"duration_s\":%.3f,\"filament_mm\":%.3f}",
+			i ? "," : "", l->z_um / 1000.0, p404_pr_s(l->start_ns - p404_pr.print_start_ns),
+			p404_pr_s(end - l->start_ns), l->e_um / 1000.0);
+	}
+	fprintf(out, "],");
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const char *type = pass ? "fan" : "heater";
+		fprintf(out, "\"%ss\":[", type);
+		bool first = true;
+		for (guint i = 0; i < p404_pr.duties->len; i++)
+		{
+			p404_pr_duty_t *d = g_ptr_array_index(p404_pr.duties, i);
+			if (strcmp(d->type, type) != 0)
+			{
+				continue;
+			}
+			p404_pr_duty_update(d, now);
+			double span = (double)(now - p404_pr.start_ns) * 255;
+			// Labels are a character, or a numeric index where the board has several.
+			g_autofree char *label = g_ascii_isgraph(d->label) ?
+				g_strdup_printf("%c", d->label) : g_strdup_printf("%d", d->label);
+			fprintf(out, "%s{\"label\":\"%s\",\"peak_duty\":%.3f,\"mean_duty\":%.3f}", first ? "" : ",",
+				label, d->peak / 255.0, span > 0 ? d->level_ns / span : 0);
+			first = false;
+		}
+		fprintf(out, "],");
+	}
+
+	uint64_t idle = qatomic_read(&p404_pr.idle_samples), busy = qatomic_read(&p404_pr.busy_samples);
+	fprintf(out, "\"rtos\":{\"idle_s\":%.3f,\"busy_s\":%.3f,\"idle_fraction\":%.3f}}\n",
+		p404_pr_s(idle * P404_PR_SAMPLE_NS), p404_pr_s(busy * P404_PR_SAMPLE_NS),
+		idle + busy ? (double)idle / (idle + busy) : 0);
+	fflush(out);
+}
+
+static void p404_pr_exit(Notifier *n, void *data)
+{
+	timer_del(p404_pr.timer);
+	p404_pr_report();
+	if (p404_pr.out != stdout)
+	{
+		fclose(p404_pr.out);
+	}
+}
+
+static Notifier p404_pr_machine_done_notifier = { .notify = p404_pr_machine_done };
+static Notifier p404_pr_exit_notifier = { .notify = p404_pr_exit };
+
+extern void p404_print_report_setup(void)
+{
+	if (!arghelper_is_arg("print-report"))
+	{
+		return;
+	}
+	const char *file = arghelper_get_string("print-report");
+	p404_pr.out = stdout;
+	if (strcmp(file, "true") != 0) // Bare "print-report" reports to stdout.
+	{
+		p404_pr.out = fopen(file, "w");
+		if (p404_pr.out == NULL)
+		{
+			printf("print-report: cannot open %s, reporting to stdout.\n", file);
+			p404_pr.out = stdout;
+		}
+	}
+	p404_pr.motion_start_ns = p404_pr.print_start_ns = -1;
+	p404_pr.layers = g_array_new(false, true, sizeof(p404_pr_layer_t));
+	p404_pr.duties = g_ptr_array_new();
+
+	p404_pr.have_tcb = p404_elf_lookup("pxCurrentTCB", &p404_pr.px_current_tcb, NULL) &&
+		p404_elf_lookup("xIdleTaskHandle", &p404_pr.idle_handle, NULL);
+	uint32_t size = 0;
+	if (p404_elf_lookup(P404_PR_IDLE_SYM, &p404_pr.idle_start, &size))
+	{
+		p404_pr.idle_end = p404_pr.idle_start + size;
+	}
+	if (!p404_pr.have_tcb && size == 0)
+	{
+		printf("print-report: no FreeRTOS symbols (no ELF?), only WFI will count as idle.\n");
+	}
+	qemu_add_machine_init_done_notifier(&p404_pr_machine_done_notifier);
+	qemu_add_exit_notifier(&p404_pr_exit_notifier);
+}
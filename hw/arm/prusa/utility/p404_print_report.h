@@ -0,0 +1,34 @@
+/*
+    p404_print_report.h  - Virtual-time print duration and resource usage report.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_PRINT_REPORT_H
+#define P404_PRINT_REPORT_H
+
+#include "qemu/osdep.h"
+
+// "print-report" (or "print-report=<file>") in -append: watches the motors,
+// heaters and fans once the board is wired up, and writes a JSON summary of
+// the print at exit: print time, per-layer times, filament used, heater and
+// fan duty, and FreeRTOS idle vs busy time.
+// Call from the board init, after p404_elf_load_symbols.
+extern void p404_print_report_setup(void);
+
+#endif // P404_PRINT_REPORT_H
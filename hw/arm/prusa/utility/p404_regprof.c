@@ -0,0 +1,231 @@
+/*
+    p404_regprof.c  - Register-level MMIO hotspot profiler.
+
+	Attributes every access to an STM32_MR_IO_INIT region to the device,
+	the register (the stm32_reginfo_t index, i.e. offset / 4, that the
+	peripherals' read/write handlers switch on), the direction and the guest
+	PC of the instruction that made it. On exit, a report of the busiest
+	registers and the code hitting them is written out - e.g. to spot the
+	firmware spinning on an SPI SR flag.
+
+	Off unless "regprof" is passed in -append; the only cost then is a flag
+	test per access.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/notify.h"
+#include "hw/core/cpu.h"
+#include "exec/exec-all.h"
+#include "sysemu/sysemu.h"
+#include "sysemu/tcg.h"
+#include "target/arm/cpu.h"
+#include "ArgHelper.h"
+#include "p404_elf_syms.h"
+#include "p404_stats.h"
+#include "p404_regprof.h"
+
+#define P404_REGPROF_DEFAULT_TOP 40
+#define P404_REGPROF_NO_PC UINT32_MAX // Not from the CPU (timers, DMA from the main loop...)
+
+typedef struct {
+	p404_stats_t *dev;
+	uint32_t pc;
+	uint16_t reg;
+	bool is_write;
+} p404_regprof_key_t;
+
+typedef struct {
+	p404_regprof_key_t key;
+	uint64_t count;
+} p404_regprof_entry_t;
+
+bool p404_regprof_enabled;
+
+static GHashTable *p404_regprof_hits; // key -> entry, key is embedded in the entry.
+static FILE *p404_regprof_out;
+static int p404_regprof_top = P404_REGPROF_DEFAULT_TOP;
+
+static guint p404_regprof_hash(gconstpointer k)
+{
+	const p404_regprof_key_t *key = k;
+	return g_direct_hash(key->dev) ^ (key->pc * 2654435761U) ^ (key->reg << 1) ^ key->is_write;
+}
+
+static gboolean p404_regprof_equal(gconstpointer a, gconstpointer b)
+{
+	const p404_regprof_key_t *ka = a, *kb = b;
+	return ka->dev == kb->dev && ka->pc == kb->pc && ka->reg == kb->reg && ka->is_write == kb->is_write;
+}
+
+// TCG only syncs R15 at TB boundaries, so recover the exact instruction from the host
+// return address of the access. The CPU state is put back afterwards so that
+// profiling never changes what the guest sees.
+static uint32_t p404_regprof_guest_pc(void)
+{
+	if (current_cpu == NULL || !tcg_enabled())
+	{
+		return P404_REGPROF_NO_PC;
+	}
+	CPUARMState *env = &ARM_CPU(current_cpu)->env;
+	uint32_t saved_pc = env->regs[15];
+	uint32_t saved_condexec = env->condexec_bits;
+	uint32_t saved_syndrome = env->exception.syndrome;
+	uint32_t pc = saved_pc;
+	if (cpu_restore_state(current_cpu, current_cpu->mem_io_pc, false))
+	{
+		pc = env->regs[15];
+		env->regs[15] = saved_pc;
+		env->condexec_bits = saved_condexec;
+		env->exception.syndrome = saved_syndrome;
+	}
+	return pc;
+}
+
+extern void p404_regprof_hit(p404_stats_t *stats, hwaddr addr, bool is_write)
+{
+	p404_regprof_key_t key = {
+		.dev = stats,
+		.pc = p404_regprof_guest_pc(),
+		.reg = addr >> 2,
+		.is_write = is_write,
+	};
+	p404_regprof_entry_t *e = g_hash_table_lookup(p404_regprof_hits, &key);
+	if (e == NULL)
+	{
+		e = g_new0(p404_regprof_entry_t, 1);
+		e->key = key;
+		g_hash_table_insert(p404_regprof_hits, &e->key, e);
+	}
+	e->count++;
+}
+
+static gint p404_regprof_by_count(gconstpointer a, gconstpointer b)
+{
+	const p404_regprof_entry_t *ea = *(p404_regprof_entry_t* const*)a;
+	const p404_regprof_entry_t *eb = *(p404_regprof_entry_t* const*)b;
+	return (ea->count < eb->count) - (ea->count > eb->count);
+}
+
+static void p404_regprof_print_reg(const p404_regprof_entry_t *e)
+{
+	g_autofree char *path = object_get_canonical_path(e->key.dev->owner);
+	fprintf(p404_regprof_out, "%14" PRIu64 "  %c  %-32s reg %3u (+0x%03x)",
+		e->count, e->key.is_write ? 'W' : 'R', path ? path : object_get_typename(e->key.dev->owner),
+		e->key.reg, e->key.reg << 2);
+}
+
+static void p404_regprof_report(void)
+{
+	uint64_t total = 0;
+	g_autoptr(GPtrArray) by_pc = g_ptr_array_new();
+	g_autoptr(GPtrArray) by_reg = g_ptr_array_new_with_free_func(g_free);
+	g_autoptr(GHashTable) regs = g_hash_table_new(p404_regprof_hash, p404_regprof_equal);
+	GHashTableIter iter;
+	p404_regprof_entry_t *e;
+
+	g_hash_table_iter_init(&iter, p404_regprof_hits);
+	while (g_hash_table_iter_next(&iter, NULL, (gpointer*)&e))
+	{
+		total += e->count;
+		g_ptr_array_add(by_pc, e);
+		p404_regprof_key_t key = e->key;
+		key.pc = 0;
+		p404_regprof_entry_t *r = g_hash_table_lookup(regs, &key);
+		if (r == NULL)
+		{
+			r = g_new0(p404_regprof_entry_t, 1);
+			r->key = key;
+			g_hash_table_insert(regs, &r->key, r);
+			g_ptr_array_add(by_reg, r);
+		}
+		r->count += e->count;
+	}
+	g_ptr_array_sort(by_reg, p404_regprof_by_count);
+	g_ptr_array_sort(by_pc, p404_regprof_by_count);
+
+	fprintf(p404_regprof_out, "MMIO register hotspots: %" PRIu64 " accesses, %u registers\n",
+		total, by_reg->len);
+	for (guint i = 0; i < by_reg->len && i < p404_regprof_top; i++)
+	{
+		p404_regprof_print_reg(g_ptr_array_index(by_reg, i));
+		fprintf(p404_regprof_out, "\n");
+	}
+
+	fprintf(p404_regprof_out, "\nBy guest PC:\n");
+	for (guint i = 0; i < by_pc->len && i < p404_regprof_top; i++)
+	{
+		e = g_ptr_array_index(by_pc, i);
+		p404_regprof_print_reg(e);
+		if (e->key.pc == P404_REGPROF_NO_PC)
+		{
+			fprintf(p404_regprof_out, "  (not from the CPU)\n");
+			continue;
+		}
+		uint32_t offset = 0;
+		const char *sym = p404_elf_symbolize(e->key.pc, &offset);
+		if (sym)
+		{
+			fprintf(p404_regprof_out, "  pc 0x%08x %s+0x%x\n", e->key.pc, sym, offset);
+		}
+		else
+		{
+			fprintf(p404_regprof_out, "  pc 0x%08x\n", e->key.pc);
+		}
+	}
+	fflush(p404_regprof_out);
+}
+
+static void p404_regprof_exit(Notifier *n, void *data)
+{
+	p404_regprof_enabled = false;
+	p404_regprof_report();
+	if (p404_regprof_out != stdout)
+	{
+		fclose(p404_regprof_out);
+	}
+}
+
+static Notifier p404_regprof_exit_notifier = { .notify = p404_regprof_exit };
+
+extern void p404_regprof_setup(void)
+{
+	if (!arghelper_is_arg("regprof"))
+	{
+		return;
+	}
+	const char *file = arghelper_get_string("regprof");
+	p404_regprof_out = stdout;
+	if (strcmp(file, "true") != 0) // Bare "regprof" reports to stdout.
+	{
+		p404_regprof_out = fopen(file, "w");
+		if (p404_regprof_out == NULL)
+		{
+			printf("regprof: cannot open %s, reporting to stdout.\n", file);
+			p404_regprof_out = stdout;
+		}
+	}
+	if (arghelper_is_arg("regprof-top"))
+	{
+		p404_regprof_top = MAX(atoi(arghelper_get_string("regprof-top")), 1);
+	}
+	p404_regprof_hits = g_hash_table_new_full(p404_regprof_hash, p404_regprof_equal, NULL, g_free);
+	qemu_add_exit_notifier(&p404_regprof_exit_notifier);
+	p404_regprof_enabled = true;
+}
@@ -0,0 +1,41 @@
+/*
+    p404_regprof.h  - Register-level MMIO hotspot profiler.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_REGPROF_H
+#define P404_REGPROF_H
+
+#include "qemu/osdep.h"
+#include "exec/hwaddr.h"
+
+struct p404_stats_t;
+
+// Checked by the STM32_MR_IO_INIT access wrapper before calling p404_regprof_hit.
+extern bool p404_regprof_enabled;
+
+// Records one access at offset addr of the device that owns stats, against the
+// guest PC that issued it.
+extern void p404_regprof_hit(struct p404_stats_t *stats, hwaddr addr, bool is_write);
+
+// Applies the "regprof[=<file>]" and "regprof-top=<n>" -append options. The report
+// is written to file (stdout if not given) on exit. Call from the board init.
+extern void p404_regprof_setup(void);
+
+#endif // P404_REGPROF_H
@@ -0,0 +1,306 @@
+/*
+    p404_rtos_trace.c  - FreeRTOS-aware task/ISR timeline tracer.
+
+	Writes a Chrome trace event (JSON) file, viewable in Perfetto or
+	chrome://tracing, on the virtual clock:
+
+	 - one track per FreeRTOS task, busy while the task is switched in.
+	   Switches are detected on PendSV/SVCall return, by pxCurrentTCB
+	   changing (needs the ELF symbols), and the track is named after the
+	   TCB's pcTaskName. Without symbols, a PendSV return onto a different
+	   PSP is logged as an anonymous switch instead.
+	 - an "ISRs" track with a slice per exception, named after the vector
+	   table entry's handler where possible;
+	 - instant events for writes to ITM stimulus ports 1-31 (port 0 stays
+	   the console), for markers placed by the firmware.
+
+	Events are produced on exception entry/return with the BQL held and
+	go straight into a large stdio buffer.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/notify.h"
+#include "qemu/timer.h"
+#include "exec/cpu-common.h"
+#include "hw/intc/armv7m_nvic.h"
+#include "sysemu/sysemu.h"
+#include "target/arm/cpu.h"
+#include "target/arm/internals.h"
+#include "ArgHelper.h"
+#include "p404_elf_syms.h"
+#include "p404_rtos_trace.h"
+
+#define P404_RTOS_TCB_NAME_OFFSET 52 // pcTaskName, no MPU wrappers.
+#define P404_RTOS_TASK_NAME_LEN 16
+#define P404_RTOS_OUT_BUFFER (1U << 20)
+
+enum {
+	TID_ISR = 1,
+	TID_MARKERS,
+	TID_SCHED, // Anonymous switches when pxCurrentTCB is unknown.
+	TID_TASK_BASE = 100,
+};
+
+static const char *p404_rtos_exc_names[NVIC_INTERNAL_VECTORS] = {
+	[ARMV7M_EXCP_NMI] = "NMI",
+	[ARMV7M_EXCP_HARD] = "HardFault",
+	[ARMV7M_EXCP_MEM] = "MemManage",
+	[ARMV7M_EXCP_BUS] = "BusFault",
+	[ARMV7M_EXCP_USAGE] = "UsageFault",
+	[ARMV7M_EXCP_SVC] = "SVCall",
+	[ARMV7M_EXCP_DEBUG] = "DebugMonitor",
+	[ARMV7M_EXCP_PENDSV] = "PendSV",
+	[ARMV7M_EXCP_SYSTICK] = "SysTick",
+};
+
+static struct {
+	FILE *out;
+	ARMCPU *cpu;
+	uint32_t tcb_name_offset;
+	bool have_tcb;
+	uint32_t px_current_tcb;
+	uint32_t current_tcb;
+	int current_tid;
+	uint32_t psp_at_entry;
+	GHashTable *tids; // TCB address -> track id
+	char *isr_names[NVIC_MAX_VECTORS];
+	uint32_t isr_vecbase;
+} p404_rtos;
+
+static void p404_rtos_ts(char buf[32])
+{
+	int64_t now = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+	snprintf(buf, 32, "%" PRId64 ".%03d", now / 1000, (int)(now % 1000));
+}
+
+static void p404_rtos_event(const char *name, char ph, int tid)
+{
+	char ts[32];
+	p404_rtos_ts(ts);
+	fprintf(p404_rtos.out, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%s,\"pid\":1,\"tid\":%d},\n",
+		name, ph, ts, tid);
+}
+
+static void p404_rtos_thread_name(int tid, const char *name)
+{
+	fprintf(p404_rtos.out,
+		"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n",
+		tid, name);
+}
+
+static bool p404_rtos_read(uint32_t addr, void *buf, int len)
+{
+	return cpu_memory_rw_debug(CPU(p404_rtos.cpu), addr, buf, len, false) == 0;
+}
+
+static uint32_t p404_rtos_psp(void)
+{
+	CPUARMState *env = &p404_rtos.cpu->env;
+	return v7m_using_psp(env) ? env->regs[13] : env->v7m.other_sp;
+}
+
+// Guest strings go into JSON, so keep only the harmless characters.
+static void p404_rtos_sanitize(char *s)
+{
+	for (; *s; s++)
+	{
+		if (!g_ascii_isprint(*s) || *s == '"' || *s == '\\')
+		{
+			*s = '_';
+		}
+	}
+}
+
+static const char *p404_rtos_isr_name(int irq)
+{
+	CPUARMState *env = &p404_rtos.cpu->env;
+	uint32_t vecbase = env->v7m.vecbase[env->v7m.secure];
+	if (vecbase != p404_rtos.isr_vecbase) // Vector table moved (e.g. bootloader -> app)
+	{
+		for (int i = 0; i < NVIC_MAX_VECTORS; i++)
+		{
+			g_free(p404_rtos.isr_names[i]);
+			p404_rtos.isr_names[i] = NULL;
+		}
+		p404_rtos.isr_vecbase = vecbase;
+	}
+	if (p404_rtos.isr_names[irq] == NULL)
+	{
+		uint32_t handler = 0, offset = 0;
+		const char *sym = NULL;
+		if (p404_rtos_read(vecbase + 4U * irq, &handler, 4))
+		{
+			sym = p404_elf_symbolize(le32_to_cpu(handler) & ~1U, &offset);
+		}
+		if (sym != NULL && offset == 0)
+		{
+			p404_rtos.isr_names[irq] = g_strdup(sym);
+		}
+		else if (irq < NVIC_INTERNAL_VECTORS && p404_rtos_exc_names[irq])
+		{
+			p404_rtos.isr_names[irq] = g_strdup(p404_rtos_exc_names[irq]);
+		}
+		else
+		{
+			p404_rtos.isr_names[irq] = g_strdup_printf("IRQ%d", irq - NVIC_INTERNAL_VECTORS);
+		}
+		p404_rtos_sanitize(p404_rtos.isr_names[irq]);
+	}
+	return p404_rtos.isr_names[irq];
+}
+
+static int p404_rtos_task_tid(uint32_t tcb)
+{
+	gpointer tid = g_hash_table_lookup(p404_rtos.tids, GUINT_TO_POINTER(tcb));
+	if (tid == NULL)
+	{
+		char name[P404_RTOS_TASK_NAME_LEN + 1] = "";
+		tid = GINT_TO_POINTER(TID_TASK_BASE + g_hash_table_size(p404_rtos.tids));
+		g_hash_table_insert(p404_rtos.tids, GUINT_TO_POINTER(tcb), tid);
+		if (!p404_rtos_read(tcb + p404_rtos.tcb_name_offset, name, P404_RTOS_TASK_NAME_LEN) || !name[0])
+		{
+			snprintf(name, sizeof(name), "tcb@%08x", tcb);
+		}
+		p404_rtos_sanitize(name);
+		p404_rtos_thread_name(GPOINTER_TO_INT(tid), name);
+	}
+	return GPOINTER_TO_INT(tid);
+}
+
+static void p404_rtos_check_switch(void)
+{
+	if (!p404_rtos.have_tcb)
+	{
+		if (p404_rtos_psp() != p404_rtos.psp_at_entry)
+		{
+			p404_rtos_event("switch", 'i', TID_SCHED);
+		}
+		return;
+	}
+	uint32_t tcb = 0;
+	if (!p404_rtos_read(p404_rtos.px_current_tcb, &tcb, 4))
+	{
+		return;
+	}
+	tcb = le32_to_cpu(tcb);
+	if (tcb == p404_rtos.current_tcb || tcb == 0)
+	{
+		return;
+	}
+	int tid = p404_rtos_task_tid(tcb);
+	if (p404_rtos.current_tid)
+	{
+		p404_rtos_event("running", 'E', p404_rtos.current_tid);
+	}
+	p404_rtos_event("running", 'B', tid);
+	p404_rtos.current_tcb = tcb;
+	p404_rtos.current_tid = tid;
+}
+
+static void p404_rtos_exc(void *opaque, int irq, bool entry)
+{
+	if (p404_rtos.out == NULL)
+	{
+		return;
+	}
+	bool sched = irq == ARMV7M_EXCP_PENDSV || irq == ARMV7M_EXCP_SVC;
+	if (entry && sched)
+	{
+		p404_rtos.psp_at_entry = p404_rtos_psp();
+	}
+	p404_rtos_event(p404_rtos_isr_name(irq), entry ? 'B' : 'E', TID_ISR);
+	if (!entry && sched)
+	{
+		p404_rtos_check_switch();
+	}
+}
+
+extern void p404_rtos_trace_itm(int port, uint32_t value)
+{
+	if (p404_rtos.out == NULL)
+	{
+		return;
+	}
+	char ts[32];
+	p404_rtos_ts(ts);
+	fprintf(p404_rtos.out,
+		"{\"name\":\"ITM%d\",\"ph\":\"i\",\"ts\":%s,\"pid\":1,\"tid\":%d,\"args\":{\"value\":%" PRIu32 "}},\n",
+		port, ts, TID_MARKERS, value);
+}
+
+static void p404_rtos_exit(Notifier *n, void *data)
+{
+	if (p404_rtos.out == NULL)
+	{
+		return;
+	}
+	if (p404_rtos.current_tid)
+	{
+		p404_rtos_event("running", 'E', p404_rtos.current_tid);
+	}
+	fprintf(p404_rtos.out,
+		"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"guest\"}}\n]}\n");
+	fclose(p404_rtos.out);
+	p404_rtos.out = NULL;
+}
+
+static Notifier p404_rtos_exit_notifier = { .notify = p404_rtos_exit };
+
+extern void p404_rtos_trace_setup(void)
+{
+	if (!arghelper_is_arg("rtos-trace"))
+	{
+		return;
+	}
+	const char *file = arghelper_get_string("rtos-trace");
+	p404_rtos.out = fopen(file, "w");
+	if (p404_rtos.out == NULL)
+	{
+		printf("rtos-trace: cannot open %s\n", file);
+		return;
+	}
+	setvbuf(p404_rtos.out, NULL, _IOFBF, P404_RTOS_OUT_BUFFER);
+	p404_rtos.cpu = ARM_CPU(first_cpu);
+	p404_rtos.tcb_name_offset = P404_RTOS_TCB_NAME_OFFSET;
+	if (arghelper_is_arg("rtos-tcb-name"))
+	{
+		p404_rtos.tcb_name_offset = strtoul(arghelper_get_string("rtos-tcb-name"), NULL, 0);
+	}
+	p404_rtos.have_tcb = p404_elf_lookup("pxCurrentTCB", &p404_rtos.px_current_tcb, NULL);
+	if (!p404_rtos.have_tcb)
+	{
+		printf("rtos-trace: pxCurrentTCB not found (no ELF symbols?), tasks will not be named.\n");
+	}
+	p404_rtos.tids = g_hash_table_new(NULL, NULL);
+	p404_rtos.isr_vecbase = UINT32_MAX;
+
+	fprintf(p404_rtos.out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	p404_rtos_thread_name(TID_ISR, "ISRs");
+	p404_rtos_thread_name(TID_MARKERS, "ITM markers");
+	if (!p404_rtos.have_tcb)
+	{
+		p404_rtos_thread_name(TID_SCHED, "Scheduler");
+	}
+
+	NVICState *nvic = p404_rtos.cpu->env.nvic;
+	nvic->exc_hook = p404_rtos_exc;
+	nvic->exc_hook_opaque = NULL;
+	qemu_add_exit_notifier(&p404_rtos_exit_notifier);
+}
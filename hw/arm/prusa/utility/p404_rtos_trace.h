@@ -0,0 +1,34 @@
+/*
+    p404_rtos_trace.h  - FreeRTOS-aware task/ISR timeline tracer.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_RTOS_TRACE_H
+#define P404_RTOS_TRACE_H
+
+#include "qemu/osdep.h"
+
+// Records a write of value to ITM stimulus port as a user marker.
+extern void p404_rtos_trace_itm(int port, uint32_t value);
+
+// Applies the "rtos-trace=<file.json>" and "rtos-tcb-name=<offset>" -append
+// options. Call from the board init, after p404_elf_load_symbols.
+extern void p404_rtos_trace_setup(void);
+
+#endif // P404_RTOS_TRACE_H
@@ -0,0 +1,284 @@
+/*
+    p404_sampler.c  - Sampling guest profiler with folded-stack output.
+
+	A virtual clock timer asks the vCPU to take a sample at its next TB
+	boundary, where the register file is exact. The stack is unwound
+	without relying on frame pointers (GCC omits them for Thumb code):
+
+	 - PC, then LR if it is a call site in another function (leaf frames);
+	 - a scan up the stack for words that are return addresses, i.e. land
+	   just after a BL/BLX inside a known function;
+	 - EXC_RETURN values switch to the stacked exception frame (on MSP or
+	   PSP, basic or FP-extended) and carry on from the interrupted PC, so
+	   ISRs show up on top of the task they interrupted.
+
+	This is a heuristic - a stale return address left on the stack can add
+	a bogus frame - but it needs nothing from the firmware build and is
+	more than good enough to find where the time goes.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/notify.h"
+#include "qemu/thread.h"
+#include "qemu/timer.h"
+#include "hw/core/cpu.h"
+#include "exec/cpu-common.h"
+#include "sysemu/sysemu.h"
+#include "target/arm/cpu.h"
+#include "ArgHelper.h"
+#include "p404_elf_syms.h"
+#include "p404_sampler.h"
+
+#define P404_SAMPLER_DEFAULT_US 100
+#define P404_SAMPLER_MAX_FRAMES 32
+#define P404_SAMPLER_MAX_SCAN 512 // Stack words to look through per sample.
+
+#define P404_SAMPLER_EXC_FRAME UINT32_MAX // Marks an exception entry in the frame list.
+
+#define EXC_RETURN_MIN 0xFFFFFFE0U
+#define EXC_RETURN_SPSEL BIT(2) // Frame is on the PSP
+#define EXC_RETURN_FTYPE BIT(4) // Clear: FP-extended frame
+
+static struct {
+	QEMUTimer *timer;
+	int64_t interval_ns;
+	char *filename;
+	QemuMutex lock;
+	GHashTable *stacks; // folded stack -> count
+	uint64_t samples;
+} p404_sampler;
+
+static bool p404_sampler_read(CPUState *cpu, uint32_t addr, void *buf, int len)
+{
+	return cpu_memory_rw_debug(cpu, addr, buf, len, false) == 0;
+}
+
+// Is ret (Thumb bit set) the return address of a BL or BLX in a known function?
+static bool p404_sampler_is_return(CPUState *cpu, uint32_t ret)
+{
+	uint32_t offset;
+	uint16_t insn[2];
+	if ((ret & 1U) == 0 || ret < 5)
+	{
+		return false;
+	}
+	ret &= ~1U;
+	if (p404_elf_symbolize(ret, &offset) == NULL || !p404_sampler_read(cpu, ret - 4, insn, sizeof(insn)))
+	{
+		return false;
+	}
+	insn[0] = le16_to_cpu(insn[0]);
+	insn[1] = le16_to_cpu(insn[1]);
+	return (insn[1] & 0xFF87U) == 0x4780U || // BLX Rm
+		((insn[0] & 0xF800U) == 0xF000U && (insn[1] & 0xD000U) == 0xD000U); // BL imm
+}
+
+static bool p404_sampler_same_function(uint32_t a, uint32_t b)
+{
+	uint32_t off_a, off_b;
+	const char *fa = p404_elf_symbolize(a & ~1U, &off_a);
+	return fa != NULL && fa == p404_elf_symbolize(b & ~1U, &off_b);
+}
+
+// Fills frames leaf-first, returns the count.
+static int p404_sampler_unwind(CPUState *cpu, uint32_t *frames)
+{
+	CPUARMState *env = &ARM_CPU(cpu)->env;
+	int n = 0;
+	int scanned = 0;
+	uint32_t pc = env->regs[15];
+	uint32_t lr = env->regs[14];
+	uint32_t sp = env->regs[13];
+	bool handler = env->v7m.exception != 0;
+	uint32_t word;
+
+	frames[n++] = pc;
+	while (n < P404_SAMPLER_MAX_FRAMES)
+	{
+		uint32_t exc_return = 0;
+		uint32_t exc_at = sp - 4; // Where EXC_RETURN was pushed, if it was.
+		if (handler && lr >= EXC_RETURN_MIN)
+		{
+			// Still in the handler proper (no calls made yet), which may have pushed
+			// a few registers along with LR.
+			exc_return = lr;
+			for (uint32_t at = sp; at < sp + 16*4; at += 4)
+			{
+				if (p404_sampler_read(cpu, at, &word, 4) && le32_to_cpu(word) == lr)
+				{
+					exc_at = at;
+					break;
+				}
+			}
+		}
+		else
+		{
+			uint32_t skip = 0; // The pushed copy of a live LR.
+			if (!p404_sampler_same_function(lr, pc) && p404_sampler_is_return(cpu, lr))
+			{
+				frames[n++] = lr & ~1U;
+				skip = lr;
+			}
+			for (uint32_t at = sp; n < P404_SAMPLER_MAX_FRAMES && scanned < P404_SAMPLER_MAX_SCAN; at += 4, scanned++)
+			{
+				if (!p404_sampler_read(cpu, at, &word, 4))
+				{
+					break;
+				}
+				word = le32_to_cpu(word);
+				if (handler && word >= EXC_RETURN_MIN)
+				{
+					exc_return = word;
+					exc_at = at;
+					break;
+				}
+				if (word == skip)
+				{
+					skip = 0;
+				}
+				else if (p404_sampler_is_return(cpu, word))
+				{
+					frames[n++] = word & ~1U;
+				}
+			}
+		}
+		if (exc_return == 0 || n >= P404_SAMPLER_MAX_FRAMES)
+		{
+			return n;
+		}
+
+		// Continue in the interrupted context.
+		uint32_t frame = (exc_return & EXC_RETURN_SPSEL) ? env->v7m.other_sp : exc_at + 4;
+		uint32_t stacked[8]; // r0-r3, r12, lr, pc, xpsr
+		if (!p404_sampler_read(cpu, frame, stacked, sizeof(stacked)))
+		{
+			return n;
+		}
+		frames[n++] = P404_SAMPLER_EXC_FRAME;
+		lr = le32_to_cpu(stacked[5]);
+		pc = le32_to_cpu(stacked[6]);
+		sp = frame + ((exc_return & EXC_RETURN_FTYPE) ? 0x20U : 0x68U);
+		if (le32_to_cpu(stacked[7]) & XPSR_SPREALIGN)
+		{
+			sp += 4;
+		}
+		// Only a nested exception returns to handler mode (EXC_RETURN 0xFFFFFFx1).
+		handler = (exc_return & 0xFU) == 0x1U;
+		if (n < P404_SAMPLER_MAX_FRAMES)
+		{
+			frames[n++] = pc;
+		}
+	}
+	return n;
+}
+
+static void p404_sampler_append(GString *s, uint32_t addr)
+{
+	uint32_t offset;
+	const char *name = addr == P404_SAMPLER_EXC_FRAME ? "[exception]" : p404_elf_symbolize(addr, &offset);
+	if (s->len)
+	{
+		g_string_append_c(s, ';');
+	}
+	if (name)
+	{
+		g_string_append(s, name);
+	}
+	else
+	{
+		g_string_append_printf(s, "0x%08x", addr);
+	}
+}
+
+static void p404_sampler_take(CPUState *cpu, run_on_cpu_data data)
+{
+	uint32_t frames[P404_SAMPLER_MAX_FRAMES];
+	int n = p404_sampler_unwind(cpu, frames);
+	GString *folded = g_string_sized_new(256);
+	for (int i = n - 1; i >= 0; i--)
+	{
+		p404_sampler_append(folded, frames[i]);
+	}
+	if (cpu->halted)
+	{
+		g_string_append(folded, ";[wfi]");
+	}
+	qemu_mutex_lock(&p404_sampler.lock);
+	gpointer count = g_hash_table_lookup(p404_sampler.stacks, folded->str);
+	g_hash_table_replace(p404_sampler.stacks, g_string_free(folded, false),
+		GSIZE_TO_POINTER(GPOINTER_TO_SIZE(count) + 1));
+	p404_sampler.samples++;
+	qemu_mutex_unlock(&p404_sampler.lock);
+}
+
+static void p404_sampler_tick(void *opaque)
+{
+	async_run_on_cpu(first_cpu, p404_sampler_take, RUN_ON_CPU_NULL);
+	timer_mod(p404_sampler.timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + p404_sampler.interval_ns);
+}
+
+static void p404_sampler_exit(Notifier *n, void *data)
+{
+	timer_del(p404_sampler.timer);
+	FILE *out = fopen(p404_sampler.filename, "w");
+	if (out == NULL)
+	{
+		printf("sample: cannot write %s\n", p404_sampler.filename);
+		return;
+	}
+	GHashTableIter iter;
+	gpointer stack, count;
+	qemu_mutex_lock(&p404_sampler.lock);
+	g_hash_table_iter_init(&iter, p404_sampler.stacks);
+	while (g_hash_table_iter_next(&iter, &stack, &count))
+	{
+		fprintf(out, "%s %zu\n", (const char*)stack, GPOINTER_TO_SIZE(count));
+	}
+	printf("sample: %" PRIu64 " samples, %u distinct stacks written to %s\n",
+		p404_sampler.samples, g_hash_table_size(p404_sampler.stacks), p404_sampler.filename);
+	qemu_mutex_unlock(&p404_sampler.lock);
+	fclose(out);
+}
+
+static Notifier p404_sampler_exit_notifier = { .notify = p404_sampler_exit };
+
+extern void p404_sampler_setup(void)
+{
+	if (!arghelper_is_arg("sample"))
+	{
+		return;
+	}
+	if (!p404_elf_have_symbols())
+	{
+		printf("sample: no ELF symbols loaded, stacks will be addresses only.\n");
+	}
+	int interval_us = P404_SAMPLER_DEFAULT_US;
+	if (arghelper_is_arg("sample-us"))
+	{
+		interval_us = MAX(atoi(arghelper_get_string("sample-us")), 1);
+	}
+	p404_sampler.filename = g_strdup(arghelper_get_string("sample"));
+	p404_sampler.interval_ns = interval_us * SCALE_US;
+	p404_sampler.stacks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	qemu_mutex_init(&p404_sampler.lock);
+	p404_sampler.timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, p404_sampler_tick, NULL);
+	timer_mod(p404_sampler.timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + p404_sampler.interval_ns);
+	qemu_add_exit_notifier(&p404_sampler_exit_notifier);
+}
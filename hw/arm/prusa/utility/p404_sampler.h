@@ -0,0 +1,33 @@
+/*
+    p404_sampler.h  - Sampling guest profiler with folded-stack output.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_SAMPLER_H
+#define P404_SAMPLER_H
+
+#include "qemu/osdep.h"
+
+// Applies the "sample=<file>" and "sample-us=<interval>" -append options: every
+// interval of virtual time the guest call stack is sampled, and on exit the
+// samples are written to file in folded-stack format (flamegraph.pl input).
+// Call from the board init, after p404_elf_load_symbols.
+extern void p404_sampler_setup(void);
+
+#endif // P404_SAMPLER_H
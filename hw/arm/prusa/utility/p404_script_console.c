@@ -27,6 +27,7 @@
 #include "chardev/char-fe.h"
 #include "../utility/macros.h"
 #include "../utility/ArgHelper.h"
+#include "../utility/p404_timer_stats.h"
 #include "hw/qdev-properties.h"
 #include "sysemu/sysemu.h"
 #include "hw/sysbus.h"
@@ -60,6 +61,7 @@ OBJECT_DECLARE_SIMPLE_TYPE(ScriptConsoleState, P404_SCRIPT_CONSOLE)
 
 extern int scripthost_run(int64_t iTime);
 extern bool scripthost_setup(const char* strScript, void *pConsole);
+extern bool scripthost_has_pending(void);
 
 
 static int scriptcon_can_read(void* opaque) {
@@ -83,10 +85,6 @@ static void scriptcon_execute(void *opaque, const char *cmdline,
     s->is_busy = true;
     s->show_status = true;
     scripthost_execute(cmdline);
-    if (timer_expired(s->scripting,qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)))
-    {
-        timer_mod(s->scripting, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+10);
-    }
 }
 
 static void scriptcon_auto_return(void *opaque, const char* cmd_completed)
@@ -141,6 +139,16 @@ extern void scriptcon_print_out(void* opaque, const char *str) {
     scriptcon_printf(opaque, "%s\n",str);
 }
 
+extern void scriptcon_wake(void* opaque);
+
+// Called by the ScriptHost whenever it queues a line (console or GL terminal).
+extern void scriptcon_wake(void* opaque) {
+    ScriptConsoleState *s = P404_SCRIPT_CONSOLE(opaque);
+    if (!timer_pending(s->scripting)) {
+        timer_mod(s->scripting, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+10);
+    }
+}
+
 static void scriptcon_flush(void *opaque)
 {
     // ScriptConsoleState *s = opaque;
@@ -174,7 +182,11 @@ static void scriptcon_timer_expire(void *opaque)
     ScriptConsoleState *s = opaque;
     const char* messages[] = {strOK, strFailed, strWait, strTimeout, strSyntax};
     int status = scripthost_run(qemu_clock_get_us(QEMU_CLOCK_VIRTUAL));
-    timer_mod(s->scripting, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+10);
+    // Only keep polling while there is something left to run, queueing a
+    // new line re-arms the timer through scriptcon_wake.
+    if (scripthost_has_pending()) {
+        timer_mod(s->scripting, qemu_clock_get_ms(QEMU_CLOCK_VIRTUAL)+10);
+    }
     bool should_restart = false;
     if (status !=3 && s->show_status) {
         should_restart = true;
@@ -236,7 +248,7 @@ static void scriptcon_finalize(Object *obj)
 static void scriptcon_init(Object *obj)
 {
     ScriptConsoleState *s = P404_SCRIPT_CONSOLE(obj);
-    s->scripting = timer_new_ms(QEMU_CLOCK_VIRTUAL,
+    s->scripting = p404_timer_new_ms(obj, QEMU_CLOCK_VIRTUAL, "scripting",
     (QEMUTimerCB *)scriptcon_timer_expire, s);
 
 
@@ -0,0 +1,302 @@
+/*
+    p404_stats.c  - Per-device event counters, reported by the
+	query-p404-stats QMP command.
+
+	Counting is a plain load/store on a cache line private to the calling
+	thread, so it is cheap enough to leave on. Readers sum the slots.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/memalign.h"
+#include "qemu/notify.h"
+#include "qemu/timer.h"
+#include "hw/irq.h"
+#include "hw/qdev-core.h"
+#include "qapi/qapi-commands-misc-target.h"
+#include "qapi/util.h"
+#include "qom/object.h"
+#include "sysemu/sysemu.h"
+#include "p404_stats.h"
+#include "p404_regprof.h"
+
+static const char *p404_stat_names[P404_STAT_COUNT] = {
+	[P404_STAT_MMIO_READ] = "mmio-reads",
+	[P404_STAT_MMIO_WRITE] = "mmio-writes",
+	[P404_STAT_TIMER] = "timer-callbacks",
+	[P404_STAT_IRQ] = "irq-raises",
+	[P404_STAT_DMA] = "dma-beats",
+	[P404_STAT_CHR_BYTES] = "chardev-bytes",
+};
+
+__thread int p404_stats_thread_slot;
+
+static int p404_stats_next_slot;
+static GHashTable *p404_stats_by_owner; // Object* -> p404_stats_t*
+static GPtrArray *p404_stats_all; // Registration order, for the report.
+static int64_t p404_stats_start_host_ns;
+
+extern int p404_stats_assign_slot(void)
+{
+	int slot = qatomic_fetch_inc(&p404_stats_next_slot);
+	p404_stats_thread_slot = MIN(slot, P404_STATS_THREADS - 1) + 1;
+	return p404_stats_thread_slot;
+}
+
+// Properties are released when the owner is finalized, so this drops its
+// counters (e.g. for an instance that only existed to list its properties).
+static void p404_stats_release(Object *obj, const char *name, void *opaque)
+{
+	p404_stats_t *s = opaque;
+	g_hash_table_remove(p404_stats_by_owner, obj);
+	g_ptr_array_remove(p404_stats_all, s);
+	qemu_vfree(s);
+}
+
+extern p404_stats_t *p404_stats_get(Object *owner)
+{
+	if (p404_stats_by_owner == NULL)
+	{
+		p404_stats_by_owner = g_hash_table_new(NULL, NULL);
+		p404_stats_all = g_ptr_array_new();
+		p404_stats_start_host_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME);
+	}
+	p404_stats_t *s = g_hash_table_lookup(p404_stats_by_owner, owner);
+	if (s == NULL)
+	{
+		s = qemu_memalign(__alignof__(p404_stats_t), sizeof(p404_stats_t));
+		memset(s, 0, sizeof(*s));
+		s->owner = owner;
+		g_hash_table_insert(p404_stats_by_owner, owner, s);
+		g_ptr_array_add(p404_stats_all, s);
+		object_property_add(owner, "p404-stats", "p404-stats", NULL, NULL, p404_stats_release, s);
+	}
+	return s;
+}
+
+typedef struct {
+	p404_stats_t *stats;
+	qemu_irq downstream;
+} p404_stats_gpio_t;
+
+static GPtrArray *p404_stats_gpio_pending; // Devices to tap at machine init done.
+static bool p404_stats_gpio_tapped;
+
+static void p404_stats_gpio_irq(void *opaque, int n, int level)
+{
+	p404_stats_gpio_t *g = opaque;
+	p404_stats_inc(g->stats, P404_STAT_IRQ);
+	qemu_set_irq(g->downstream, level);
+}
+
+static void p404_stats_tap_gpio_out(DeviceState *dev)
+{
+	p404_stats_t *stats = p404_stats_get(OBJECT(dev));
+	NamedGPIOList *ngl;
+	QLIST_FOREACH(ngl, &dev->gpios, node)
+	{
+		for (int i = 0; i < ngl->num_out; i++)
+		{
+			g_autofree char *prop = g_strdup_printf("%s[%d]",
+				ngl->name ? ngl->name : "unnamed-gpio-out", i);
+			if (object_property_get_link(OBJECT(dev), prop, NULL) == NULL)
+			{
+				continue; // Not connected, nothing to count.
+			}
+			p404_stats_gpio_t *g = g_new0(p404_stats_gpio_t, 1);
+			g->stats = stats;
+			g->downstream = qdev_intercept_gpio_out(dev,
+				qemu_allocate_irq(p404_stats_gpio_irq, g, 0), ngl->name, i);
+		}
+	}
+}
+
+static void p404_stats_machine_done(Notifier *n, void *data)
+{
+	for (guint i = 0; i < p404_stats_gpio_pending->len; i++)
+	{
+		DeviceState *dev = DEVICE(g_ptr_array_index(p404_stats_gpio_pending, i));
+		if (dev->realized)
+		{
+			p404_stats_tap_gpio_out(dev);
+		}
+	}
+	g_ptr_array_set_size(p404_stats_gpio_pending, 0);
+	p404_stats_gpio_tapped = true;
+}
+
+static Notifier p404_stats_machine_done_notifier = { .notify = p404_stats_machine_done };
+
+// Drops a device that goes away before the board is done, e.g. one that was
+// only instantiated to list its properties.
+static void p404_stats_gpio_release(Object *obj, const char *name, void *opaque)
+{
+	if (p404_stats_gpio_pending != NULL)
+	{
+		g_ptr_array_remove(p404_stats_gpio_pending, obj);
+	}
+}
+
+extern void p404_stats_count_gpio_out(Object *owner)
+{
+	if (p404_stats_gpio_tapped)
+	{
+		return; // Created after the board was wired up, not tracked.
+	}
+	if (p404_stats_gpio_pending == NULL)
+	{
+		p404_stats_gpio_pending = g_ptr_array_new();
+		qemu_add_machine_init_done_notifier(&p404_stats_machine_done_notifier);
+	}
+	g_ptr_array_add(p404_stats_gpio_pending, owner);
+	object_property_add(owner, "p404-stats-gpio", "p404-stats", NULL, NULL,
+		p404_stats_gpio_release, NULL);
+}
+
+typedef struct {
+	MemoryRegionOps ops;
+	const MemoryRegionOps *orig;
+	void *opaque;
+	p404_stats_t *stats;
+} p404_stats_mmio_t;
+
+static uint64_t p404_stats_mmio_read(void *opaque, hwaddr addr, unsigned size)
+{
+	p404_stats_mmio_t *m = opaque;
+	p404_stats_inc(m->stats, P404_STAT_MMIO_READ);
+	if (unlikely(p404_regprof_enabled))
+	{
+		p404_regprof_hit(m->stats, addr, false);
+	}
+	return m->orig->read(m->opaque, addr, size);
+}
+
+static void p404_stats_mmio_write(void *opaque, hwaddr addr, uint64_t data, unsigned size)
+{
+	p404_stats_mmio_t *m = opaque;
+	p404_stats_inc(m->stats, P404_STAT_MMIO_WRITE);
+	if (unlikely(p404_regprof_enabled))
+	{
+		p404_regprof_hit(m->stats, addr, true);
+	}
+	m->orig->write(m->opaque, addr, data, size);
+}
+
+static MemTxResult p404_stats_mmio_read_attrs(void *opaque, hwaddr addr, uint64_t *data,
+	unsigned size, MemTxAttrs attrs)
+{
+	p404_stats_mmio_t *m = opaque;
+	p404_stats_inc(m->stats, P404_STAT_MMIO_READ);
+	if (unlikely(p404_regprof_enabled))
+	{
+		p404_regprof_hit(m->stats, addr, false);
+	}
+	return m->orig->read_with_attrs(m->opaque, addr, data, size, attrs);
+}
+
+static MemTxResult p404_stats_mmio_write_attrs(void *opaque, hwaddr addr, uint64_t data,
+	unsigned size, MemTxAttrs attrs)
+{
+	p404_stats_mmio_t *m = opaque;
+	p404_stats_inc(m->stats, P404_STAT_MMIO_WRITE);
+	if (unlikely(p404_regprof_enabled))
+	{
+		p404_regprof_hit(m->stats, addr, true);
+	}
+	return m->orig->write_with_attrs(m->opaque, addr, data, size, attrs);
+}
+
+extern void p404_stats_init_io(MemoryRegion *mr, Object *owner, const MemoryRegionOps *ops,
+	void *opaque, const char *name, uint64_t size)
+{
+	if (ops->valid.accepts != NULL) // Would be handed our opaque, leave these alone.
+	{
+		memory_region_init_io(mr, owner, ops, opaque, name, size);
+		return;
+	}
+	p404_stats_mmio_t *m = g_new0(p404_stats_mmio_t, 1);
+	m->ops = *ops;
+	m->orig = ops;
+	m->opaque = opaque;
+	m->stats = p404_stats_get(owner);
+	if (ops->read)
+	{
+		m->ops.read = p404_stats_mmio_read;
+	}
+	if (ops->write)
+	{
+		m->ops.write = p404_stats_mmio_write;
+	}
+	if (ops->read_with_attrs)
+	{
+		m->ops.read_with_attrs = p404_stats_mmio_read_attrs;
+	}
+	if (ops->write_with_attrs)
+	{
+		m->ops.write_with_attrs = p404_stats_mmio_write_attrs;
+	}
+	memory_region_init_io(mr, owner, &m->ops, m, name, size);
+}
+
+P404Stats *qmp_query_p404_stats(Error **errp)
+{
+	P404Stats *info = g_new0(P404Stats, 1);
+	P404StatsDeviceList **dev_tail = &info->devices;
+	info->virtual_ns = qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL);
+	info->host_ns = qemu_clock_get_ns(QEMU_CLOCK_REALTIME) - p404_stats_start_host_ns;
+	double virtual_s = MAX(info->virtual_ns, 1) / (double)NANOSECONDS_PER_SECOND;
+	double host_s = MAX(info->host_ns, 1) / (double)NANOSECONDS_PER_SECOND;
+
+	for (guint i = 0; p404_stats_all != NULL && i < p404_stats_all->len; i++)
+	{
+		p404_stats_t *s = g_ptr_array_index(p404_stats_all, i);
+		P404StatsDevice *dev = NULL;
+		P404StatsCounterList **tail = NULL;
+		for (int stat = 0; stat < P404_STAT_COUNT; stat++)
+		{
+			uint64_t count = 0;
+			for (int t = 0; t < P404_STATS_THREADS; t++)
+			{
+				count += qatomic_read_u64(&s->slot[t].count[stat]);
+			}
+			if (count == 0)
+			{
+				continue;
+			}
+			if (dev == NULL)
+			{
+				g_autofree char *path = object_get_canonical_path(s->owner);
+				dev = g_new0(P404StatsDevice, 1);
+				dev->path = g_strdup(path ? path : object_get_typename(s->owner));
+				tail = &dev->counters;
+			}
+			P404StatsCounter *c = g_new0(P404StatsCounter, 1);
+			c->name = g_strdup(p404_stat_names[stat]);
+			c->count = count;
+			c->virtual_rate = count / virtual_s;
+			c->host_rate = count / host_s;
+			QAPI_LIST_APPEND(tail, c);
+		}
+		if (dev != NULL)
+		{
+			QAPI_LIST_APPEND(dev_tail, dev);
+		}
+	}
+	return info;
+}
@@ -0,0 +1,91 @@
+/*
+    p404_stats.h  - Per-device event counters, reported by the
+	query-p404-stats QMP command.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_STATS_H
+#define P404_STATS_H
+
+#include "qemu/osdep.h"
+#include "qemu/atomic.h"
+#include "exec/memory.h"
+
+typedef enum {
+	P404_STAT_MMIO_READ,
+	P404_STAT_MMIO_WRITE,
+	P404_STAT_TIMER,		// Timer callbacks
+	P404_STAT_IRQ,			// IRQ raises, or GPIO output updates for the parts
+	P404_STAT_DMA,			// DMA beats (single transfers)
+	P404_STAT_CHR_BYTES,	// Chardev bytes, both directions
+	P404_STAT_COUNT
+} p404_stat_t;
+
+// Threads get their own cache line of counters so they never contend; any
+// threads beyond this share the last slot, which is updated atomically.
+#define P404_STATS_THREADS 8
+
+typedef struct {
+	uint64_t count[P404_STAT_COUNT];
+} QEMU_ALIGNED(64) p404_stats_slot_t;
+
+typedef struct p404_stats_t {
+	p404_stats_slot_t slot[P404_STATS_THREADS];
+	Object *owner;
+} p404_stats_t;
+
+extern __thread int p404_stats_thread_slot; // 1-based, 0 until the thread's first count.
+extern int p404_stats_assign_slot(void);
+
+// Returns the counters for owner, creating them on first use.
+extern p404_stats_t *p404_stats_get(Object *owner);
+
+static inline void p404_stats_add(p404_stats_t *s, p404_stat_t stat, uint64_t n)
+{
+	int slot = p404_stats_thread_slot;
+	if (unlikely(slot == 0))
+	{
+		slot = p404_stats_assign_slot();
+	}
+	uint64_t *count = &s->slot[slot - 1].count[stat];
+	if (unlikely(slot == P404_STATS_THREADS))
+	{
+		qatomic_add(count, n);
+	}
+	else
+	{
+		qatomic_set_u64(count, qatomic_read_u64(count) + n);
+	}
+}
+
+static inline void p404_stats_inc(p404_stats_t *s, p404_stat_t stat)
+{
+	p404_stats_add(s, stat, 1);
+}
+
+// Counts every update of owner's connected GPIO outputs (including sysbus IRQs)
+// as an IRQ raise. Can be called from instance_init: the outputs are tapped
+// once the board is wired up, if the device has been realized by then.
+extern void p404_stats_count_gpio_out(Object *owner);
+
+// memory_region_init_io() that also counts reads and writes against owner.
+extern void p404_stats_init_io(MemoryRegion *mr, Object *owner, const MemoryRegionOps *ops,
+	void *opaque, const char *name, uint64_t size);
+
+#endif // P404_STATS_H
@@ -0,0 +1,279 @@
+/*
+    p404_telemetry.c  - Binary telemetry stream of printer state over a chardev.
+
+	Parts publish integer channels (positions, temperatures, PWM, RPM,
+	force...), either by calling p404_telemetry_publish() or by having one
+	of their GPIO outputs tapped. Each channel is announced with a DESCRIBE
+	record (again whenever a client connects), then SAMPLE records follow,
+	on change beyond the channel's deadband or as periodic snapshots on the
+	virtual clock. See p404_telemetry.h for the record layout.
+
+	Nothing is set up unless the chardev exists, so there is no cost when
+	it is not used.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bswap.h"
+#include "qemu/notify.h"
+#include "qemu/timer.h"
+#include "qapi/error.h"
+#include "chardev/char-fe.h"
+#include "hw/irq.h"
+#include "hw/qdev-core.h"
+#include "sysemu/sysemu.h"
+#include "ArgHelper.h"
+#include "p404_telemetry.h"
+
+typedef struct {
+	char *label;
+	uint8_t kind;
+	uint16_t index;
+	int32_t deadband;
+	int32_t value;
+	int32_t sent;
+	bool valid, sent_valid;
+	qemu_irq downstream; // For tapped GPIOs.
+} p404_telemetry_chan_t;
+
+static struct {
+	bool enabled;
+	bool connected;
+	CharBackend chr;
+	GPtrArray *chans;
+	QEMUTimer *timer;
+	int64_t period_ns; // 0: send on change.
+} p404_tele;
+
+// Parts that are published automatically, with the property used to label them.
+static const struct {
+	const char *type;
+	const char *gpio;
+	const char *label_prop;
+	p404_telemetry_kind_t kind;
+	int32_t deadband;
+} p404_telemetry_known[] = {
+	{ "tmc2130", "um-out", "axis", P404_TELEMETRY_POSITION_UM, 10 },
+	{ "tmc2209", "um-out", "axis", P404_TELEMETRY_POSITION_UM, 10 },
+	{ "heater", "temp_out", "label", P404_TELEMETRY_TEMP_X256, 64 },
+	{ "heater", "pwm-out", "label", P404_TELEMETRY_PWM, 0 },
+	{ "thermistor", "temp_out_256x", "index", P404_TELEMETRY_TEMP_X256, 64 },
+	{ "fan", "rpm-out", "label", P404_TELEMETRY_RPM, 50 },
+	{ "fan", "pwm-out", "label", P404_TELEMETRY_PWM, 0 },
+	{ "loadcell", NULL, NULL, P404_TELEMETRY_FORCE, 0 },
+};
+
+static void p404_telemetry_send(const p404_telemetry_chan_t *c, uint8_t type, int32_t value, const char *payload)
+{
+	size_t len = payload ? strlen(payload) : 0;
+	p404_telemetry_rec_t rec = {
+		.magic = cpu_to_le16(P404_TELEMETRY_MAGIC),
+		.type = type,
+		.kind = c->kind,
+		.channel = cpu_to_le16(c->index),
+		.length = cpu_to_le16(len),
+		.time_ns = cpu_to_le64(qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL)),
+		.value = cpu_to_le32(value),
+	};
+	qemu_chr_fe_write_all(&p404_tele.chr, (const uint8_t*)&rec, sizeof(rec));
+	if (len)
+	{
+		qemu_chr_fe_write_all(&p404_tele.chr, (const uint8_t*)payload, len);
+	}
+}
+
+static void p404_telemetry_sample(p404_telemetry_chan_t *c)
+{
+	p404_telemetry_send(c, P404_TELEMETRY_REC_SAMPLE, c->value, NULL);
+	c->sent = c->value;
+	c->sent_valid = true;
+}
+
+static void p404_telemetry_describe_all(void)
+{
+	for (guint i = 0; i < p404_tele.chans->len; i++)
+	{
+		p404_telemetry_chan_t *c = g_ptr_array_index(p404_tele.chans, i);
+		p404_telemetry_send(c, P404_TELEMETRY_REC_DESCRIBE, c->deadband, c->label);
+		c->sent_valid = false; // New client, so resend the current values.
+		if (c->valid && p404_tele.period_ns == 0)
+		{
+			p404_telemetry_sample(c);
+		}
+	}
+}
+
+static void p404_telemetry_event(void *opaque, QEMUChrEvent event)
+{
+	p404_tele.connected = event == CHR_EVENT_OPENED ? true :
+		event == CHR_EVENT_CLOSED ? false : p404_tele.connected;
+	if (event == CHR_EVENT_OPENED)
+	{
+		p404_telemetry_describe_all();
+	}
+}
+
+extern int p404_telemetry_add_channel(const char *label, p404_telemetry_kind_t kind, int32_t deadband)
+{
+	if (!p404_tele.enabled)
+	{
+		return -1;
+	}
+	p404_telemetry_chan_t *c = g_new0(p404_telemetry_chan_t, 1);
+	c->label = g_strdup(label);
+	c->kind = kind;
+	c->deadband = MAX(deadband, 0);
+	c->index = p404_tele.chans->len;
+	g_ptr_array_add(p404_tele.chans, c);
+	if (p404_tele.connected)
+	{
+		p404_telemetry_send(c, P404_TELEMETRY_REC_DESCRIBE, c->deadband, c->label);
+	}
+	return c->index;
+}
+
+extern void p404_telemetry_publish(int channel, int32_t value)
+{
+	if (!p404_tele.enabled || channel < 0 || channel >= p404_tele.chans->len)
+	{
+		return;
+	}
+	p404_telemetry_chan_t *c = g_ptr_array_index(p404_tele.chans, channel);
+	c->value = value;
+	c->valid = true;
+	if (p404_tele.connected && p404_tele.period_ns == 0 &&
+		(!c->sent_valid || ABS((int64_t)value - c->sent) > c->deadband))
+	{
+		p404_telemetry_sample(c);
+	}
+}
+
+static void p404_telemetry_tap_irq(void *opaque, int n, int level)
+{
+	p404_telemetry_chan_t *c = opaque;
+	p404_telemetry_publish(c->index, level);
+	qemu_set_irq(c->downstream, level);
+}
+
+extern int p404_telemetry_tap(DeviceState *dev, const char *name, int n, const char *label,
+	p404_telemetry_kind_t kind, int32_t deadband)
+{
+	int index = p404_telemetry_add_channel(label, kind, deadband);
+	if (index >= 0)
+	{
+		p404_telemetry_chan_t *c = g_ptr_array_index(p404_tele.chans, index);
+		c->downstream = qdev_intercept_gpio_out(dev, qemu_allocate_irq(p404_telemetry_tap_irq, c, 0), name, n);
+	}
+	return index;
+}
+
+static void p404_telemetry_tick(void *opaque)
+{
+	if (p404_tele.connected)
+	{
+		for (guint i = 0; i < p404_tele.chans->len; i++)
+		{
+			p404_telemetry_chan_t *c = g_ptr_array_index(p404_tele.chans, i);
+			if (c->valid)
+			{
+				p404_telemetry_sample(c);
+			}
+		}
+	}
+	timer_mod(p404_tele.timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + p404_tele.period_ns);
+}
+
+static int p404_telemetry_find_parts(Object *obj, void *opaque)
+{
+	int *counts = opaque;
+	for (int i = 0; i < ARRAY_SIZE(p404_telemetry_known); i++)
+	{
+		if (object_dynamic_cast(obj, p404_telemetry_known[i].type) == NULL)
+		{
+			continue;
+		}
+		g_autofree char *prop = g_strdup_printf("%s[0]",
+			p404_telemetry_known[i].gpio ? p404_telemetry_known[i].gpio : "unnamed-gpio-out");
+		if (object_property_find(obj, prop) == NULL)
+		{
+			continue;
+		}
+		const char *what = p404_telemetry_known[i].gpio ? p404_telemetry_known[i].gpio : "out";
+		g_autofree char *label = NULL;
+		uint64_t id = ' '; // Unset label properties default to a space.
+		if (p404_telemetry_known[i].label_prop)
+		{
+			id = object_property_get_uint(obj, p404_telemetry_known[i].label_prop, NULL);
+		}
+		if (id > ' ' && id < 0x7F)
+		{
+			label = g_strdup_printf("%s %c %s", p404_telemetry_known[i].type, (char)id, what);
+		}
+		else if (id != ' ') // Numeric index
+		{
+			label = g_strdup_printf("%s %" PRIu64 " %s", p404_telemetry_known[i].type, id, what);
+		}
+		else
+		{
+			label = g_strdup_printf("%s #%d %s", p404_telemetry_known[i].type, counts[i]++, what);
+		}
+		p404_telemetry_tap(DEVICE(obj), p404_telemetry_known[i].gpio, 0, label,
+			p404_telemetry_known[i].kind, p404_telemetry_known[i].deadband);
+	}
+	return 0;
+}
+
+static void p404_telemetry_machine_done(Notifier *n, void *data)
+{
+	int counts[ARRAY_SIZE(p404_telemetry_known)] = { 0 };
+	object_child_foreach_recursive(object_get_root(), p404_telemetry_find_parts, counts);
+	if (p404_tele.period_ns)
+	{
+		p404_tele.timer = timer_new_ns(QEMU_CLOCK_VIRTUAL, p404_telemetry_tick, NULL);
+		timer_mod(p404_tele.timer, qemu_clock_get_ns(QEMU_CLOCK_VIRTUAL) + p404_tele.period_ns);
+	}
+	printf("telemetry: publishing %u channels on chardev %s\n", p404_tele.chans->len, P404_TELEMETRY_CHARDEV);
+}
+
+static Notifier p404_telemetry_machine_done_notifier = { .notify = p404_telemetry_machine_done };
+
+extern void p404_telemetry_setup(void)
+{
+	Chardev *chr = qemu_chr_find(P404_TELEMETRY_CHARDEV);
+	if (chr == NULL)
+	{
+		return;
+	}
+	Error *err = NULL;
+	if (!qemu_chr_fe_init(&p404_tele.chr, chr, &err))
+	{
+		warn_report_err(err);
+		return;
+	}
+	if (arghelper_is_arg("telemetry-hz"))
+	{
+		int hz = atoi(arghelper_get_string("telemetry-hz"));
+		p404_tele.period_ns = hz > 0 ? NANOSECONDS_PER_SECOND / hz : 0;
+	}
+	p404_tele.chans = g_ptr_array_new();
+	p404_tele.enabled = true;
+	// Backends that are already open (file, pty...) send OPENED right away, sockets on connect.
+	qemu_chr_fe_set_handlers(&p404_tele.chr, NULL, NULL, p404_telemetry_event, NULL, NULL, NULL, true);
+	qemu_add_machine_init_done_notifier(&p404_telemetry_machine_done_notifier);
+}
@@ -0,0 +1,78 @@
+/*
+    p404_telemetry.h  - Binary telemetry stream of printer state over a chardev.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_TELEMETRY_H
+#define P404_TELEMETRY_H
+
+#include "qemu/osdep.h"
+#include "hw/qdev-core.h"
+
+// Chardev the stream goes to, e.g. -chardev socket,id=p404-telemetry,server=on,...
+#define P404_TELEMETRY_CHARDEV "p404-telemetry"
+
+#define P404_TELEMETRY_MAGIC 0x5440U // "@T" on the wire
+
+typedef enum {
+	P404_TELEMETRY_GENERIC,
+	P404_TELEMETRY_POSITION_UM,	// Motor position, um
+	P404_TELEMETRY_TEMP_X256,	// Temperature, degC * 256
+	P404_TELEMETRY_PWM,			// Heater/fan drive, 0-255
+	P404_TELEMETRY_RPM,			// Fan speed
+	P404_TELEMETRY_FORCE,		// Loadcell output, raw
+	P404_TELEMETRY_KIND_COUNT
+} p404_telemetry_kind_t;
+
+typedef enum {
+	P404_TELEMETRY_REC_SAMPLE,	// value is the channel value
+	P404_TELEMETRY_REC_DESCRIBE,// value is the deadband; followed by length bytes of label (no NUL)
+} p404_telemetry_rec_type_t;
+
+// Every record starts with this, all fields little-endian.
+typedef struct QEMU_PACKED {
+	uint16_t magic;
+	uint8_t type;		// p404_telemetry_rec_type_t
+	uint8_t kind;		// p404_telemetry_kind_t
+	uint16_t channel;
+	uint16_t length;	// Bytes following this header
+	int64_t time_ns;	// QEMU_CLOCK_VIRTUAL
+	int32_t value;
+} p404_telemetry_rec_t;
+
+QEMU_BUILD_BUG_MSG(sizeof(p404_telemetry_rec_t) != 20, "telemetry record layout changed");
+
+// Adds a channel that the caller feeds with p404_telemetry_publish(). A change
+// smaller than or equal to deadband is not sent in on-change mode. Returns the channel
+// number, or -1 if telemetry is not enabled.
+extern int p404_telemetry_add_channel(const char *label, p404_telemetry_kind_t kind, int32_t deadband);
+extern void p404_telemetry_publish(int channel, int32_t value);
+
+// Publishes output n of the named GPIO (NULL for unnamed) of dev as a channel,
+// without otherwise changing where it goes.
+extern int p404_telemetry_tap(DeviceState *dev, const char *name, int n, const char *label,
+	p404_telemetry_kind_t kind, int32_t deadband);
+
+// If the P404_TELEMETRY_CHARDEV chardev exists, publishes the known parts (motors,
+// heaters, thermistors, fans, loadcell) once the board is wired up. "telemetry-hz=<n>"
+// in -append sends a snapshot of every channel n times per virtual second instead
+// of sending changes. Call from the board init.
+extern void p404_telemetry_setup(void);
+
+#endif // P404_TELEMETRY_H
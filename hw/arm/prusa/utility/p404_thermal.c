@@ -0,0 +1,212 @@
+/*
+    p404_thermal.c  - Closed-form first-order thermal model for one or
+	more coupled zones, evaluated lazily between input changes.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include <math.h>
+#include "p404_thermal.h"
+
+// Cyclic Jacobi rotations on the symmetric matrix a (destroyed), leaving the
+// eigenvalues on its diagonal and the eigenvectors in the columns of v.
+static void p404_thermal_eigen(int n, double a[P404_THERMAL_MAX_ZONES][P404_THERMAL_MAX_ZONES],
+	double v[P404_THERMAL_MAX_ZONES][P404_THERMAL_MAX_ZONES])
+{
+	for (int i=0; i<n; i++)
+	{
+		for (int j=0; j<n; j++)
+		{
+			v[i][j] = (i==j) ? 1.0 : 0.0;
+		}
+	}
+	for (int sweep=0; sweep<50; sweep++)
+	{
+		double off = 0;
+		for (int p=0; p<n; p++)
+		{
+			for (int q=p+1; q<n; q++)
+			{
+				off += a[p][q]*a[p][q];
+			}
+		}
+		if (off < 1e-24)
+		{
+			break;
+		}
+		for (int p=0; p<n; p++)
+		{
+			for (int q=p+1; q<n; q++)
+			{
+				if (fabs(a[p][q]) < 1e-300)
+				{
+					continue;
+				}
+				double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+				double t = (theta >= 0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta*theta + 1.0));
+				double c = 1.0 / sqrt(t*t + 1.0);
+				double s = t * c;
+				for (int k=0; k<n; k++)
+				{
+					double akp = a[k][p], akq = a[k][q];
+					a[k][p] = c*akp - s*akq;
+					a[k][q] = s*akp + c*akq;
+				}
+				for (int k=0; k<n; k++)
+				{
+					double apk = a[p][k], aqk = a[q][k];
+					a[p][k] = c*apk - s*aqk;
+					a[q][k] = s*apk + c*aqk;
+				}
+				for (int k=0; k<n; k++)
+				{
+					double vkp = v[k][p], vkq = v[k][q];
+					v[k][p] = c*vkp - s*vkq;
+					v[k][q] = s*vkp + c*vkq;
+				}
+			}
+		}
+	}
+}
+
+// Projects a per-zone vector onto the eigenvectors.
+static void p404_thermal_to_modes(const p404_thermal_t *t, const double *x, double *c)
+{
+	for (int k=0; k<t->n; k++)
+	{
+		double sum = 0;
+		for (int i=0; i<t->n; i++)
+		{
+			sum += t->evec[i][k] * x[i];
+		}
+		c[k] = sum;
+	}
+}
+
+// Only run when a zone starts or stops heating, n is small.
+static void p404_thermal_decompose(p404_thermal_t *t)
+{
+	double a[P404_THERMAL_MAX_ZONES][P404_THERMAL_MAX_ZONES];
+	int n = t->n;
+	for (int i=0; i<n; i++)
+	{
+		a[i][i] = (t->heating & (1U << i)) ? 0.0 : -1.0 / t->tau[i];
+		for (int j=0; j<n; j++)
+		{
+			if (i != j)
+			{
+				a[i][j] = t->neighbours[i*n + j] ? t->k : 0.0;
+				a[i][i] -= a[i][j];
+			}
+		}
+	}
+	p404_thermal_eigen(n, a, t->evec);
+	for (int i=0; i<n; i++)
+	{
+		t->eval[i] = a[i][i];
+	}
+}
+
+extern void p404_thermal_init(p404_thermal_t *t, int n, const uint8_t *neighbours,
+	double k, const double *tau, double ambient, int64_t now_ns)
+{
+	assert(n > 0 && n <= P404_THERMAL_MAX_ZONES);
+	memset(t, 0, sizeof(*t));
+	t->n = n;
+	t->ambient = ambient;
+	t->k = k;
+	t->last_ns = now_ns;
+	for (int i=0; i<n; i++)
+	{
+		t->temp[i] = ambient;
+		t->tau[i] = tau[i];
+		for (int j=0; j<n; j++)
+		{
+			t->neighbours[i*n + j] = neighbours ? neighbours[i*n + j] : 0;
+		}
+	}
+	p404_thermal_decompose(t);
+}
+
+extern void p404_thermal_advance(p404_thermal_t *t, int64_t now_ns)
+{
+	if (now_ns <= t->last_ns)
+	{
+		return;
+	}
+	double dt = (double)(now_ns - t->last_ns) / NANOSECONDS_PER_SECOND;
+	double delta[P404_THERMAL_MAX_ZONES], x[P404_THERMAL_MAX_ZONES], b[P404_THERMAL_MAX_ZONES];
+	for (int i=0; i<t->n; i++)
+	{
+		delta[i] = t->temp[i] - t->ambient;
+	}
+	p404_thermal_to_modes(t, delta, x);
+	p404_thermal_to_modes(t, t->rate, b);
+	for (int k=0; k<t->n; k++)
+	{
+		// A mode with no loss (e.g. a heated zone on its own) just integrates its input.
+		double decay = exp(t->eval[k] * dt);
+		double gain = (fabs(t->eval[k]) < 1e-12) ? dt : (decay - 1.0) / t->eval[k];
+		x[k] = (x[k] * decay) + (b[k] * gain);
+	}
+	for (int i=0; i<t->n; i++)
+	{
+		double sum = 0;
+		for (int k=0; k<t->n; k++)
+		{
+			sum += t->evec[i][k] * x[k];
+		}
+		t->temp[i] = t->ambient + sum;
+	}
+	t->last_ns = now_ns;
+}
+
+extern void p404_thermal_rebase(p404_thermal_t *t, int64_t now_ns)
+{
+	t->last_ns = now_ns;
+}
+
+extern void p404_thermal_set_rate(p404_thermal_t *t, int zone, double rate, int64_t now_ns)
+{
+	if (t->rate[zone] == rate)
+	{
+		return;
+	}
+	p404_thermal_advance(t, now_ns);
+	t->rate[zone] = rate;
+	uint32_t heating = (rate != 0) ? (t->heating | (1U << zone)) : (t->heating & ~(1U << zone));
+	if (heating != t->heating)
+	{
+		t->heating = heating;
+		p404_thermal_decompose(t);
+	}
+}
+
+extern void p404_thermal_set_temp(p404_thermal_t *t, int zone, double temp, int64_t now_ns)
+{
+	p404_thermal_advance(t, now_ns);
+	t->temp[zone] = temp;
+}
+
+extern double p404_thermal_get_temp(p404_thermal_t *t, int zone, int64_t now_ns)
+{
+	p404_thermal_advance(t, now_ns);
+	return t->temp[zone];
+}
@@ -0,0 +1,71 @@
+/*
+    p404_thermal.h  - Closed-form first-order thermal model for one or
+	more coupled zones, evaluated lazily between input changes.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_THERMAL_H
+#define P404_THERMAL_H
+
+#include "qemu/osdep.h"
+
+#define P404_THERMAL_MAX_ZONES 16
+
+// Each zone i follows dT_i/dt = rate_i - (T_i - ambient)/tau_i + sum_j k*(T_j - T_i)
+// over its neighbours j. Like the original 250 ms heater tick, a zone only loses heat
+// to ambient while it is not being heated. That's linear with constant inputs between
+// calls, so it is solved exactly through the eigenvectors of the (symmetric) system
+// matrix, which is rebuilt whenever a zone starts or stops heating.
+typedef struct {
+	int n;
+	double ambient;
+	double k;
+	double tau[P404_THERMAL_MAX_ZONES];
+	uint8_t neighbours[P404_THERMAL_MAX_ZONES * P404_THERMAL_MAX_ZONES];
+	uint32_t heating; // Bitmask of zones with a nonzero rate.
+	double eval[P404_THERMAL_MAX_ZONES];
+	double evec[P404_THERMAL_MAX_ZONES][P404_THERMAL_MAX_ZONES]; // Column k is eigenvector k.
+	double temp[P404_THERMAL_MAX_ZONES];
+	double rate[P404_THERMAL_MAX_ZONES]; // Heating input, deg/s.
+	int64_t last_ns;
+} p404_thermal_t;
+
+// Sets up n zones at ambient. neighbours is an n*n adjacency matrix (nonzero = coupled),
+// or NULL for independent zones. k is the conduction between neighbours, 1/s, and
+// tau holds the cooldown time constant of each zone, s.
+extern void p404_thermal_init(p404_thermal_t *t, int n, const uint8_t *neighbours,
+	double k, const double *tau, double ambient, int64_t now_ns);
+
+// Brings all zones up to now_ns.
+extern void p404_thermal_advance(p404_thermal_t *t, int64_t now_ns);
+
+// Makes the current temperatures the state as of now_ns without advancing,
+// e.g. after loading a snapshot taken at another point in virtual time.
+extern void p404_thermal_rebase(p404_thermal_t *t, int64_t now_ns);
+
+// Changes the heating input of a zone from now_ns onwards.
+extern void p404_thermal_set_rate(p404_thermal_t *t, int zone, double rate, int64_t now_ns);
+
+// Overrides the temperature of a zone as of now_ns.
+extern void p404_thermal_set_temp(p404_thermal_t *t, int zone, double temp, int64_t now_ns);
+
+// Temperature of a zone as of now_ns.
+extern double p404_thermal_get_temp(p404_thermal_t *t, int zone, int64_t now_ns);
+
+#endif // P404_THERMAL_H
@@ -0,0 +1,153 @@
+/*
+    p404_timer_stats.c  - Registry of named device timers so the
+	monitor can show which ones are armed and how often they fire.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/module.h"
+#include "monitor/monitor.h"
+#include "p404_timer_stats.h"
+#include "p404_stats.h"
+
+typedef struct p404_timer_entry_t {
+	Object *owner;
+	ObjectProperty *prop;
+	p404_stats_t *stats;
+	char *name;
+	QEMUTimer *timer;
+	QEMUClockType type;
+	QEMUTimerCB *cb;
+	void *opaque;
+	uint64_t fires;
+	int64_t first_fire_ns;
+	int64_t last_fire_ns;
+} p404_timer_entry_t;
+
+static GPtrArray *p404_timers = NULL;
+
+static void p404_timer_trampoline(void *opaque)
+{
+	p404_timer_entry_t *e = opaque;
+	int64_t now = qemu_clock_get_ns(e->type);
+	if (e->fires++ == 0) {
+		e->first_fire_ns = now;
+	}
+	e->last_fire_ns = now;
+	if (e->stats) {
+		p404_stats_inc(e->stats, P404_STAT_TIMER);
+	}
+	e->cb(e->opaque);
+}
+
+static void p404_timer_unregister(p404_timer_entry_t *e)
+{
+	g_ptr_array_remove(p404_timers, e);
+	g_free(e->name);
+	g_free(e);
+}
+
+// Properties are released at the start of finalize, so this drops the entry
+// while the timer is still valid. An owner that forgets to free its timer
+// must not have it fire into a finalized object, so it is also cancelled.
+static void p404_timer_owner_release(Object *obj, const char *name, void *opaque)
+{
+	p404_timer_entry_t *e = opaque;
+	timer_del(e->timer);
+	p404_timer_unregister(e);
+}
+
+extern QEMUTimer* p404_timer_new(Object *owner, QEMUClockType type, int scale,
+	const char *name, QEMUTimerCB *cb, void *opaque)
+{
+	if (p404_timers == NULL) {
+		p404_timers = g_ptr_array_new();
+	}
+	p404_timer_entry_t *e = g_new0(p404_timer_entry_t, 1);
+	e->owner = owner;
+	e->stats = owner ? p404_stats_get(owner) : NULL;
+	e->name = g_strdup(name);
+	e->type = type;
+	e->cb = cb;
+	e->opaque = opaque;
+	e->timer = timer_new(type, scale, p404_timer_trampoline, e);
+	g_ptr_array_add(p404_timers, e);
+	if (owner) {
+		// Ties the registry entry to the owner's lifetime.
+		e->prop = object_property_add(owner, "p404-timer[*]", "p404-timer",
+			NULL, NULL, p404_timer_owner_release, e);
+	}
+	return e->timer;
+}
+
+extern void p404_timer_free(QEMUTimer *timer)
+{
+	if (timer == NULL) {
+		return;
+	}
+	for (guint i = 0; p404_timers && i < p404_timers->len; i++) {
+		p404_timer_entry_t *e = g_ptr_array_index(p404_timers, i);
+		if (e->timer != timer) {
+			continue;
+		}
+		if (e->prop) {
+			object_property_del(e->owner, e->prop->name); // Unregisters via the release hook
+		} else {
+			p404_timer_unregister(e);
+		}
+		break;
+	}
+	timer_free(timer);
+}
+
+static void hmp_info_p404_timers(Monitor *mon, const QDict *qdict)
+{
+	if (p404_timers == NULL || p404_timers->len == 0) {
+		monitor_printf(mon, "No device timers registered\n");
+		return;
+	}
+	unsigned armed = 0;
+	for (guint i = 0; i < p404_timers->len; i++) {
+		p404_timer_entry_t *e = g_ptr_array_index(p404_timers, i);
+		int64_t now = qemu_clock_get_ns(e->type);
+		g_autofree char *path = e->owner ? object_get_canonical_path(e->owner) : NULL;
+		monitor_printf(mon, "%-40s %-16s ", path ? path : "?", e->name);
+		if (timer_pending(e->timer)) {
+			armed++;
+			monitor_printf(mon, "armed, due in %8.3f ms",
+				((int64_t)timer_expire_time_ns(e->timer) - now) / (double)SCALE_MS);
+		} else {
+			monitor_printf(mon, "idle                    ");
+		}
+		monitor_printf(mon, " fired %8" PRIu64, e->fires);
+		if (e->fires > 1) {
+			monitor_printf(mon, ", avg period %8.3f ms",
+				(e->last_fire_ns - e->first_fire_ns) / (double)(e->fires - 1) / SCALE_MS);
+		}
+		monitor_printf(mon, "\n");
+	}
+	monitor_printf(mon, "%u of %u device timers armed\n", armed, p404_timers->len);
+}
+
+static void p404_timer_stats_register(void)
+{
+	monitor_register_hmp("p404-timers", true, hmp_info_p404_timers);
+}
+
+type_init(p404_timer_stats_register)
@@ -0,0 +1,48 @@
+/*
+    p404_timer_stats.h  - Registry of named device timers so the
+	monitor can show which ones are armed and how often they fire.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_TIMER_STATS_H
+#define P404_TIMER_STATS_H
+
+#include "qemu/osdep.h"
+#include "qemu/timer.h"
+#include "qom/object.h"
+
+// Drop-in replacement for timer_new_full(...) that also tracks the timer under
+// "name" for "info p404-timers". Owner labels the output; the entry is dropped
+// (and the timer cancelled) when the owner is finalized.
+extern QEMUTimer* p404_timer_new(Object *owner, QEMUClockType type, int scale,
+	const char *name, QEMUTimerCB *cb, void *opaque);
+
+// timer_free() for timers made by p404_timer_new; also removes the entry.
+extern void p404_timer_free(QEMUTimer *timer);
+
+#define p404_timer_new_ms(owner, type, name, cb, opaque) \
+	p404_timer_new(owner, type, SCALE_MS, name, cb, opaque)
+
+#define p404_timer_new_us(owner, type, name, cb, opaque) \
+	p404_timer_new(owner, type, SCALE_US, name, cb, opaque)
+
+#define p404_timer_new_ns(owner, type, name, cb, opaque) \
+	p404_timer_new(owner, type, SCALE_NS, name, cb, opaque)
+
+#endif // P404_TIMER_STATS_H
@@ -0,0 +1,127 @@
+/*
+    p404_turbo_idle.c  - Fast-forwards virtual time while the firmware idles.
+
+	When enabled, an idle CPU (WFI with nothing pending in the NVIC, or
+	reaching the configured idle loop halt point) immediately advances
+	QEMU_CLOCK_VIRTUAL to the next armed timer deadline instead of waiting
+	for it in real time. This requires -icount; without it the idle loop
+	still halts, which saves host CPU but does not speed things up.
+
+	The halt point is a single instruction, by default the back-edge
+	branch of the FreeRTOS idle task loop, so each wake still runs the
+	loop body once (idle hook, deleted task cleanup, taskYIELD).
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "qemu/osdep.h"
+#include "qemu/bitops.h"
+#include "qemu/bswap.h"
+#include "qemu/cutils.h"
+#include "sysemu/cpu-timers.h"
+#include "hw/arm/armv7m.h"
+#include "hw/loader.h"
+#include "ArgHelper.h"
+#include "p404_elf_syms.h"
+#include "p404_turbo_idle.h"
+
+// FreeRTOS idle task, used if nothing else was given and the ELF has it.
+#define P404_DEFAULT_IDLE_SYM "prvIdleTask"
+
+// Finds the last backward unconditional branch (B or B.W) in the function at
+// [start, start + size), i.e. the back-edge of its main loop. The code is read
+// from the ROM blob, as guest memory is not filled in until reset.
+static bool p404_find_back_edge(uint32_t start, uint32_t size, uint32_t *pc)
+{
+	const uint8_t *code = rom_ptr(start, size);
+	bool found = false;
+	if (code == NULL) {
+		return false;
+	}
+	for (uint32_t off = 0; off + 2 <= size;) {
+		uint32_t at = start + off;
+		uint16_t hw1 = lduw_le_p(code + off);
+		int32_t disp;
+		if ((hw1 >> 11) < 0x1D) { // 16-bit
+			off += 2;
+			if ((hw1 & 0xF800) != 0xE000) {
+				continue;
+			}
+			disp = sextract32(hw1, 0, 11) << 1;
+		} else {
+			if (off + 4 > size) {
+				break;
+			}
+			uint16_t hw2 = lduw_le_p(code + off + 2);
+			off += 4;
+			if ((hw1 & 0xF800) != 0xF000 || (hw2 & 0xD000) != 0x9000) {
+				continue;
+			}
+			uint32_t s = extract32(hw1, 10, 1);
+			uint32_t i1 = !(extract32(hw2, 13, 1) ^ s);
+			uint32_t i2 = !(extract32(hw2, 11, 1) ^ s);
+			disp = sextract32(s << 24 | i1 << 23 | i2 << 22 |
+				extract32(hw1, 0, 10) << 12 | extract32(hw2, 0, 11) << 1, 0, 25);
+		}
+		uint32_t target = at + 4 + disp;
+		if (disp < 0 && target >= start) {
+			*pc = at;
+			found = true;
+		}
+	}
+	return found;
+}
+
+extern void p404_turbo_idle_setup(void)
+{
+	if (!arghelper_is_arg("turbo-idle")) {
+		return;
+	}
+	if (icount_enabled()) {
+		icount_set_turbo_idle(true);
+	} else {
+		printf("turbo-idle: -icount is not enabled, idle time will not be skipped.\n");
+	}
+
+	uint64_t pc = 0;
+	uint32_t start = 0, size = 0;
+	const char *at = arghelper_get_string("idle-pc");
+	const char *sym = arghelper_get_string("idle-sym");
+	if (at) {
+		if (qemu_strtou64(at, NULL, 0, &pc) || pc == 0 || pc > UINT32_MAX || (pc & 1)) {
+			printf("turbo-idle: invalid idle-pc '%s', expected the address of a Thumb instruction\n", at);
+			return;
+		}
+	} else if (p404_elf_lookup(sym ? sym : P404_DEFAULT_IDLE_SYM, &start, &size) && size) {
+		uint32_t edge;
+		if (!p404_find_back_edge(start, size, &edge)) {
+			printf("turbo-idle: no loop back-edge found in '%s', only WFI will be fast-forwarded\n",
+				sym ? sym : P404_DEFAULT_IDLE_SYM);
+			return;
+		}
+		pc = edge;
+	} else {
+		if (sym) {
+			printf("turbo-idle: symbol '%s' not found, only WFI will be fast-forwarded\n", sym);
+		}
+		return;
+	}
+	ARMCPU *cpu = ARM_CPU(first_cpu);
+	cpu->idle_pc = pc;
+	printf("turbo-idle: halting the idle loop at 0x%08x\n", cpu->idle_pc);
+}
@@ -0,0 +1,33 @@
+/*
+    p404_turbo_idle.h  - Fast-forwards virtual time while the firmware idles.
+
+	Copyright 2023 VintagePC <https://github.com/vintagepc/>
+
+ 	This file is part of Mini404.
+
+	Mini404 is free software: you can redistribute it and/or modify
+	it under the terms of the GNU General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	Mini404 is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with Mini404.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef P404_TURBO_IDLE_H
+#define P404_TURBO_IDLE_H
+
+#include "qemu/osdep.h"
+
+// Applies the turbo-idle, idle-pc=<addr> and idle-sym=<name> -append options
+// to the first CPU. idle-pc is the instruction to halt at; idle-sym names a
+// function whose loop back-edge is used instead. Call after the firmware (and
+// its symbols) are loaded.
+extern void p404_turbo_idle_setup(void);
+
+#endif // P404_TURBO_IDLE_H
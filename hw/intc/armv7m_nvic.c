@@ -801,6 +801,12 @@ void armv7m_nvic_acknowledge_irq(void *opaque)
 
     write_v7m_exception(env, s->vectpending);
 
+#ifdef CONFIG_PRUSA_STM32_HACKS
+    if (s->exc_hook) {
+        s->exc_hook(s->exc_hook_opaque, pending, true);
+    }
+#endif
+
     nvic_irq_update(s);
 }
 
@@ -841,6 +847,12 @@ int armv7m_nvic_complete_irq(void *opaque, int irq, bool secure)
 
     trace_nvic_complete_irq(irq, secure);
 
+#ifdef CONFIG_PRUSA_STM32_HACKS
+    if (s->exc_hook) {
+        s->exc_hook(s->exc_hook_opaque, irq, false);
+    }
+#endif
+
     if (secure && exc_is_banked(irq)) {
         vec = &s->sec_vectors[irq];
     } else {
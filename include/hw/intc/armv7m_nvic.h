@@ -84,6 +84,15 @@ struct NVICState {
     uint32_t num_irq;
     qemu_irq excpout;
     qemu_irq sysresetreq;
+
+#ifdef CONFIG_PRUSA_STM32_HACKS
+    /*
+     * Optional observer for exception entry (once the exception is active)
+     * and return (before it is deactivated), for guest tracing tools.
+     */
+    void (*exc_hook)(void *opaque, int irq, bool entry);
+    void *exc_hook_opaque;
+#endif
 };
 
 #endif
@@ -59,6 +59,11 @@ int64_t icount_round(int64_t count);
 /* if the CPUs are idle, start accounting real time to virtual clock. */
 void icount_start_warp_timer(void);
 void icount_account_warp_timer(void);
+/*
+ * if enabled, idle CPUs immediately advance QEMU_CLOCK_VIRTUAL to the
+ * next timer deadline, as with sleep=off, regardless of the sleep option.
+ */
+void icount_set_turbo_idle(bool enable);
 
 /*
  * CPU Ticks and Clock
@@ -48,6 +48,8 @@
  * is TCG-specific, and does not need to be built for other accels.
  */
 static bool icount_sleep = true;
+/* Warp straight to the next deadline when idle, even with sleep=on.  */
+static bool icount_turbo_idle;
 /* Arbitrarily pick 1MIPS as the minimum allowable speed.  */
 #define MAX_ICOUNT_SHIFT 10
 
@@ -351,7 +353,7 @@ void icount_start_warp_timer(void)
          * the vCPU isn't running any insns and thus doesn't advance the
          * QEMU_CLOCK_VIRTUAL.
          */
-        if (!icount_sleep) {
+        if (!icount_sleep || icount_turbo_idle) {
             /*
              * We never let VCPUs sleep in no sleep icount mode.
              * If there is a pending QEMU_CLOCK_VIRTUAL timer we just advance
@@ -391,6 +393,11 @@ void icount_start_warp_timer(void)
     }
 }
 
+void icount_set_turbo_idle(bool enable)
+{
+    icount_turbo_idle = enable;
+}
+
 void icount_account_warp_timer(void)
 {
     if (!icount_sleep) {
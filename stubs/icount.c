@@ -43,3 +43,6 @@ void icount_account_warp_timer(void)
 {
     abort();
 }
+void icount_set_turbo_idle(bool enable)
+{
+}
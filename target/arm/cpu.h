@@ -1008,6 +1008,44 @@ struct ArchCPU {
     /* Used to synchronize KVM and QEMU in-kernel device levels */
     uint8_t device_irq_level;
 
+    /*
+     * Guest idle loop halt point, e.g. its back-edge branch. M profile
+     * translation treats reaching this instruction like a WFI; after the
+     * wake it runs once (idle_resume) so the loop body gets a pass before
+     * the next halt. 0 = disabled.
+     */
+    uint32_t idle_pc;
+    bool idle_resume;
+
+    /*
+     * High-level emulation of guest functions. M profile translation of a
+     * TB starting at a nonzero hle_pc[i] first calls hle_fn(env, i); if
+     * that returns true it has done the whole call (including setting
+     * the PC to the return address) and the TB exits without executing
+     * the guest code.
+     */
+#define ARM_HLE_MAX_ENTRIES 20
+    uint32_t hle_pc[ARM_HLE_MAX_ENTRIES];
+    bool (*hle_fn)(CPUARMState *env, int index);
+
+    /*
+     * Approximate M profile cycle model. When enabled each TB charges an
+     * estimated per-instruction-class cost plus flash wait states (less
+     * ART accelerator hits) to cycle_count and, with icount, to the
+     * instruction counter. See helper_cycle_tb.
+     */
+#define ARM_ART_LINES 64
+    bool cycle_model;
+    uint64_t cycle_count;
+    uint64_t insn_count;            /* Instructions only, no extra cycles */
+    uint32_t cycle_debt;            /* Not yet charged to icount */
+    uint32_t flash_base;
+    uint32_t flash_size;
+    uint8_t flash_ws;               /* FLASH_ACR.LATENCY */
+    bool art_icache;                /* FLASH_ACR.ICEN */
+    bool art_prefetch;              /* FLASH_ACR.PRFTEN */
+    uint32_t art_tags[ARM_ART_LINES]; /* 16-byte flash line + 1, 0 = empty */
+
     /* Used to set the maximum vector length the cpu will support.  */
     uint32_t sve_max_vq;
 
@@ -50,6 +50,11 @@ DEF_HELPER_2(exception_bkpt_insn, void, env, i32)
 DEF_HELPER_2(exception_pc_alignment, noreturn, env, tl)
 DEF_HELPER_1(setend, void, env)
 DEF_HELPER_2(wfi, void, env, i32)
+#ifdef CONFIG_PRUSA_STM32_HACKS
+DEF_HELPER_2(hle_call, i32, env, i32)
+DEF_HELPER_1(idle_wfi, void, env)
+DEF_HELPER_FLAGS_4(cycle_tb, TCG_CALL_NO_RWG, void, env, i32, i32, i32)
+#endif
 DEF_HELPER_1(wfe, void, env)
 DEF_HELPER_1(yield, void, env)
 DEF_HELPER_1(pre_hvc, void, env)
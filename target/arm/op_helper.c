@@ -23,6 +23,7 @@
 #include "internals.h"
 #include "exec/exec-all.h"
 #include "exec/cpu_ldst.h"
+#include "sysemu/cpu-timers.h"
 
 #define SIGNBIT (uint32_t)0x80000000
 #define SIGNBIT64 ((uint64_t)1 << 63)
@@ -297,6 +298,85 @@ static inline int check_wfx_trap(CPUARMState *env, bool is_wfe)
 }
 #endif
 
+#ifdef CONFIG_PRUSA_STM32_HACKS
+uint32_t HELPER(hle_call)(CPUARMState *env, uint32_t index)
+{
+    ARMCPU *cpu = env_archcpu(env);
+
+    return cpu->hle_fn && cpu->hle_fn(env, index);
+}
+
+/*
+ * Reached the configured idle loop halt point: sleep like a WFI. The PC
+ * and the icount budget are restored to this instruction, which then
+ * runs normally on the next pass, the same as the instruction after a
+ * real WFI; the one after that halts again.
+ */
+void HELPER(idle_wfi)(CPUARMState *env)
+{
+    ARMCPU *cpu = env_archcpu(env);
+    CPUState *cs = env_cpu(env);
+
+    if (cpu->idle_resume) {
+        cpu->idle_resume = false;
+        return;
+    }
+    if (cpu_has_work(cs)) {
+        return;
+    }
+    cpu->idle_resume = true;
+    cs->exception_index = EXCP_HLT;
+    cs->halted = 1;
+    cpu_loop_exit_restore(cs, GETPC());
+}
+
+/*
+ * Charge one TB to the cycle model: insns_len is the instruction count
+ * (low 16 bits) and code size in bytes (high 16), extra the cycles the
+ * instructions cost above one each. Code fetched from flash pays the
+ * FLASH_ACR wait states for each 16-byte line that misses the ART cache,
+ * except sequential lines that the prefetcher already has.
+ */
+void HELPER(cycle_tb)(CPUARMState *env, uint32_t pc, uint32_t insns_len,
+                      uint32_t extra)
+{
+    ARMCPU *cpu = env_archcpu(env);
+    uint32_t len = insns_len >> 16;
+
+    if (cpu->flash_ws && len && pc - cpu->flash_base < cpu->flash_size) {
+        uint32_t first = pc >> 4, last = (pc + len - 1) >> 4;
+        for (uint32_t line = first; line <= last; line++) {
+            uint32_t *tag = &cpu->art_tags[line % ARM_ART_LINES];
+            if (cpu->art_icache && *tag == line + 1) {
+                continue;
+            }
+            if (line == first || !cpu->art_prefetch) {
+                extra += cpu->flash_ws;
+            }
+            if (cpu->art_icache) {
+                *tag = line + 1;
+            }
+        }
+    }
+    cpu->cycle_count += (insns_len & 0xFFFF) + extra;
+    cpu->insn_count += insns_len & 0xFFFF;
+
+    if (icount_enabled()) {
+        /*
+         * The TB's instructions are already off the budget. Never take
+         * the decrementer below zero; anything over is carried to the
+         * next TB, after the budget has been refilled.
+         */
+        CPUState *cs = env_cpu(env);
+        uint32_t charge;
+        extra += cpu->cycle_debt;
+        charge = MIN(extra, cpu_neg(cs)->icount_decr.u16.low);
+        cpu_neg(cs)->icount_decr.u16.low -= charge;
+        cpu->cycle_debt = extra - charge;
+    }
+}
+#endif
+
 void HELPER(wfi)(CPUARMState *env, uint32_t insn_len)
 {
 #ifdef CONFIG_USER_ONLY
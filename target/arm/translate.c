@@ -9481,6 +9481,49 @@ static void arm_tr_tb_start(DisasContextBase *dcbase, CPUState *cpu)
     if (dc->condexec_mask || dc->condexec_cond) {
         store_cpu_field_constant(0, condexec_bits);
     }
+
+#ifdef CONFIG_PRUSA_STM32_HACKS
+    /*
+     * Entry point of a function with a high-level emulation. If the
+     * helper handles the call it has already set the PC to the return
+     * address, so just leave the TB; otherwise translate it as normal.
+     */
+    if (arm_dc_feature(dc, ARM_FEATURE_M) && !dc->condexec_mask && !dc->eci) {
+        ARMCPU *acpu = ARM_CPU(cpu);
+        for (int i = 0; i < ARM_HLE_MAX_ENTRIES; i++) {
+            if (acpu->hle_pc[i] && acpu->hle_pc[i] == dc->base.pc_first) {
+                TCGLabel *emulate = gen_new_label();
+                TCGv_i32 handled = tcg_temp_new_i32();
+                gen_helper_hle_call(handled, cpu_env, tcg_constant_i32(i));
+                tcg_gen_brcondi_i32(TCG_COND_EQ, handled, 0, emulate);
+                tcg_temp_free_i32(handled);
+                tcg_gen_exit_tb(NULL, 0);
+                gen_set_label(emulate);
+                break;
+            }
+        }
+    }
+
+    /*
+     * Cycle model: the cost is only known once the whole TB has been
+     * translated, so emit the charge with placeholder arguments that
+     * arm_tr_tb_stop() patches, the same way gen_tb_start() does for icount.
+     */
+    dc->cycles = 0;
+    dc->cycle_insn_op = dc->cycle_extra_op = NULL;
+    if (arm_dc_feature(dc, ARM_FEATURE_M) && ARM_CPU(cpu)->cycle_model) {
+        TCGv_i32 insns_len = tcg_temp_new_i32();
+        TCGv_i32 extra = tcg_temp_new_i32();
+        tcg_gen_movi_i32(insns_len, 0);
+        dc->cycle_insn_op = tcg_last_op();
+        tcg_gen_movi_i32(extra, 0);
+        dc->cycle_extra_op = tcg_last_op();
+        gen_helper_cycle_tb(cpu_env, tcg_constant_i32(dc->base.pc_first),
+                            insns_len, extra);
+        tcg_temp_free_i32(insns_len);
+        tcg_temp_free_i32(extra);
+    }
+#endif
 }
 
 static void arm_tr_insn_start(DisasContextBase *dcbase, CPUState *cpu)
@@ -9638,6 +9681,79 @@ static bool thumb_insn_is_unconditional(DisasContext *s, uint32_t insn)
     return false;
 }
 
+#ifdef CONFIG_PRUSA_STM32_HACKS
+/*
+ * Approximate Cortex-M4 cycles for one Thumb instruction, from the TRM
+ * timing table with P (pipeline refill) taken as 2 and taken-ness of
+ * conditional branches unknown (counted as +1). Everything not listed
+ * is a single cycle.
+ */
+static int m_insn_cycles(uint32_t insn, bool is_16bit)
+{
+    if (is_16bit) {
+        switch (insn >> 11) {
+        case 0x09:                          /* LDR (literal) */
+        case 0x0a ... 0x13:                 /* LDR/STR(B/H) reg/imm, SP rel */
+            return 2;
+        case 0x18: case 0x19:               /* STM, LDM */
+            return 1 + ctpop32(insn & 0xff);
+        case 0x1a: case 0x1b:               /* B<cond>, SVC, UDF */
+            return 2;
+        case 0x1c:                          /* B */
+            return 3;
+        case 0x16: case 0x17:
+            if ((insn & 0x0600) == 0x0400) { /* PUSH, POP */
+                return 1 + ctpop32(insn & 0x1ff) +
+                    ((insn & 0x0900) == 0x0900 ? 2 : 0); /* POP {pc} */
+            }
+            return 1;
+        case 0x08:
+            if ((insn & 0xff00) == 0x4700) {    /* BX, BLX */
+                return 3;
+            }
+            return 1;
+        default:
+            return 1;
+        }
+    }
+
+    uint32_t hw1 = insn >> 16, hw2 = insn & 0xffff;
+    if ((hw1 & 0xfe40) == 0xe800) {             /* LDM/STM (incl. PUSH/POP) */
+        return 1 + ctpop32(hw2 & 0xdfff) + ((hw1 & 0x0010) && (hw2 & 0x8000) ? 2 : 0);
+    }
+    if ((hw1 & 0xfe40) == 0xe840) {             /* LDRD/STRD, TBB/TBH, excl */
+        if ((hw1 & 0xfff0) == 0xe8d0 && (hw2 & 0x00e0) == 0) {
+            return 4;                           /* TBB/TBH */
+        }
+        return 3;
+    }
+    if ((hw1 & 0xfe00) == 0xf800) {             /* LDR/STR single */
+        return 2;
+    }
+    if ((hw1 & 0xf800) == 0xf000 && (hw2 & 0x8000)) { /* Branches, misc */
+        return (hw2 & 0x5000) ? 3 : 2;          /* B/BL : B<cond> */
+    }
+    if ((hw1 & 0xffd0) == 0xfb90 && (hw2 & 0x00f0) == 0x00f0) {
+        return 7;                               /* SDIV/UDIV, 2-12 */
+    }
+    if ((hw1 & 0xee00) == 0xec00 && (hw1 & 0x01a0) &&
+        (hw2 & 0x0e00) == 0x0a00) {
+        /* VFP load/store, VPUSH/VPOP (not the 64-bit VMOVs) */
+        if ((hw1 & 0x0120) == 0x0100) {
+            return 2;                           /* VLDR/VSTR */
+        }
+        return 1 + (hw2 & 0xff);                /* 1 + words */
+    }
+    if ((hw1 & 0xffb0) == 0xee80 && (hw2 & 0x0e50) == 0x0a00) {
+        return 14;                              /* VDIV */
+    }
+    if ((hw1 & 0xefbf) == 0xeeb1 && (hw2 & 0x0ed0) == 0x0ac0) {
+        return 14;                              /* VSQRT */
+    }
+    return 1;
+}
+#endif
+
 static void thumb_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
 {
     DisasContext *dc = container_of(dcbase, DisasContext, base);
@@ -9654,6 +9770,17 @@ static void thumb_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
         return;
     }
 
+#ifdef CONFIG_PRUSA_STM32_HACKS
+    /*
+     * Configured idle loop halt point: behave as if a WFI preceded this
+     * instruction. The helper restores the PC to here if it halts.
+     */
+    if (arm_dc_feature(dc, ARM_FEATURE_M) && pc == ARM_CPU(cpu)->idle_pc &&
+        !dc->condexec_mask && !dc->eci) {
+        gen_helper_idle_wfi(cpu_env);
+    }
+#endif
+
     dc->pc_curr = pc;
     insn = arm_lduw_code(env, &dc->base, pc, dc->sctlr_b);
     is_16bit = thumb_insn_is_16bit(dc, dc->base.pc_next, insn);
@@ -9728,6 +9855,12 @@ static void thumb_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
         disas_thumb2_insn(dc, insn);
     }
 
+#ifdef CONFIG_PRUSA_STM32_HACKS
+    if (dc->cycle_insn_op) {
+        dc->cycles += m_insn_cycles(insn, is_16bit);
+    }
+#endif
+
     /* Advance the Thumb condexec condition.  */
     if (dc->condexec_mask) {
         dc->condexec_cond = ((dc->condexec_cond & 0xe) |
@@ -9776,6 +9909,16 @@ static void arm_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
 {
     DisasContext *dc = container_of(dcbase, DisasContext, base);
 
+#ifdef CONFIG_PRUSA_STM32_HACKS
+    if (dc->cycle_insn_op) {
+        uint32_t len = dc->base.pc_next - dc->base.pc_first;
+        tcg_set_insn_param(dc->cycle_insn_op, 1, tcgv_i32_arg(
+            tcg_constant_i32((len << 16) | dc->base.num_insns)));
+        tcg_set_insn_param(dc->cycle_extra_op, 1, tcgv_i32_arg(
+            tcg_constant_i32(MAX(dc->cycles - dc->base.num_insns, 0))));
+    }
+#endif
+
     /* At this stage dc->condjmp will only be set when the skipped
        instruction was a conditional branch or trap, and the PC has
        already been written.  */
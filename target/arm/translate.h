@@ -30,6 +30,12 @@ typedef struct DisasContext {
     bool eci_handled;
     /* TCG op to rewind to if this turns out to be an invalid ECI state */
     TCGOp *insn_eci_rewind;
+#ifdef CONFIG_PRUSA_STM32_HACKS
+    /* Cycle model: estimated cost so far and the ops to patch at the end */
+    int cycles;
+    TCGOp *cycle_insn_op;
+    TCGOp *cycle_extra_op;
+#endif
     int thumb;
     int sctlr_b;
     MemOp be_data;